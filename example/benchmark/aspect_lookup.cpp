@@ -0,0 +1,217 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark compares the lookup of aspects on the aspect_map (dense
+// aspect id, flat table) with the lookup on the old aspect_map layout
+// (recursive_mutex + unordered_map keyed by type_index), with 5, 50 and 500
+// registered aspects, using one thread and using all cores of machine.
+// The find_ref column is the borrowed access (read_guard + find_ref), that
+// don't touch the shared_ptr refcount. The last two columns are the same
+// aspects kept in the static slots of a static_context, looked up by find
+// (a copy of shared_ptr) and by find_ref on a slot_guard (a plain load).
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/lockable_adapter.hpp>
+
+using namespace boost;
+
+// aspects used by benchmark
+template <int N>
+struct bench_aspect
+{
+   bench_aspect() : value(N) {}
+   int value;
+};
+
+// the layout used by aspect_map before dense aspect ids
+class type_index_aspect_map
+   : public basic_lockable_adapter<recursive_mutex>
+{
+   typedef application::csbl::type_index key_type;
+   typedef shared_ptr<void> value_type;
+   typedef application::csbl::unordered_map<key_type, value_type> map_type;
+
+   map_type aspects_;
+
+public:
+
+   template <class T>
+   shared_ptr<T> find() {
+      strict_lock<type_index_aspect_map> guard(*this);
+      map_type::const_iterator it =
+         aspects_.find(application::csbl::get_type_id<T>());
+
+      if (aspects_.cend() == it)
+         return shared_ptr<T>();
+
+      return static_pointer_cast<T>(it->second);
+   }
+
+   template <class T>
+   void insert(shared_ptr<T> asp) {
+      strict_lock<type_index_aspect_map> guard(*this);
+      aspects_.insert(std::make_pair(application::csbl::get_type_id<T>(), asp));
+   }
+};
+
+// register bench_aspect<0> .. bench_aspect<N-1>
+template <int N>
+struct register_aspects
+{
+   template <class Map>
+   static void on(Map& m) {
+      register_aspects<N-1>::on(m);
+      m.template insert< bench_aspect<N-1> >(make_shared< bench_aspect<N-1> >());
+   }
+};
+
+template <>
+struct register_aspects<0>
+{
+   template <class Map>
+   static void on(Map&) {}
+};
+
+template <int N, class Map>
+void lookup(Map& m, int loops)
+{
+   long sum = 0;
+   for(int i = 0; i < loops; ++i)
+   {
+      // first, middle and last registered aspect
+      sum += m.template find< bench_aspect<0> >()->value;
+      sum += m.template find< bench_aspect<N/2> >()->value;
+      sum += m.template find< bench_aspect<N-1> >()->value;
+   }
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+template <int N>
+void lookup_ref(application::aspect_map& m, int loops)
+{
+   long sum = 0;
+   for(int i = 0; i < loops; ++i)
+   {
+      application::aspect_map::read_guard guard(m);
+
+      sum += m.find_ref< bench_aspect<0> >(guard)->value;
+      sum += m.find_ref< bench_aspect<N/2> >(guard)->value;
+      sum += m.find_ref< bench_aspect<N-1> >(guard)->value;
+   }
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+template <int N>
+struct static_context_of
+{
+   typedef application::static_context<
+      bench_aspect<0>, bench_aspect<N/2>, bench_aspect<N-1> > type;
+};
+
+template <int N>
+void lookup_static_ref(typename static_context_of<N>::type& m, int loops)
+{
+   typedef typename static_context_of<N>::type context_type;
+
+   long sum = 0;
+   for(int i = 0; i < loops; ++i)
+   {
+      typename context_type::slot_guard guard(m);
+
+      sum += m.template find_ref< bench_aspect<0> >(guard)->value;
+      sum += m.template find_ref< bench_aspect<N/2> >(guard)->value;
+      sum += m.template find_ref< bench_aspect<N-1> >(guard)->value;
+   }
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+// average time of one lookup, in ns, seen by each thread
+template <class Map>
+double lookup_ns(void (*f)(Map&, int), Map& m, int loops, int threads)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   thread_group group;
+   for(int t = 0; t < threads; ++t)
+      group.create_thread(boost::bind(f, boost::ref(m), loops));
+
+   group.join_all();
+
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   return double(elapsed.count()) / (3.0 * loops);
+}
+
+template <int N>
+void run(int loops, int threads)
+{
+   type_index_aspect_map old_map;
+   application::aspect_map new_map;
+   typename static_context_of<N>::type static_map;
+
+   register_aspects<N>::on(old_map);
+   register_aspects<N>::on(new_map);
+   register_aspects<N>::on(static_map);
+
+   double old_ns = lookup_ns(&lookup<N, type_index_aspect_map>, old_map, loops, threads);
+   double new_ns = lookup_ns(&lookup<N, application::aspect_map>, new_map, loops, threads);
+   double ref_ns = lookup_ns(&lookup_ref<N>, new_map, loops, threads);
+   double static_ns = lookup_ns(
+      &lookup<N, typename static_context_of<N>::type>, static_map, loops, threads);
+   double static_ref_ns = lookup_ns(
+      &lookup_static_ref<N>, static_map, loops, threads);
+
+   std::cout
+      << std::setw(8) << N
+      << std::setw(8) << threads
+      << std::setw(20) << std::fixed << std::setprecision(2) << old_ns
+      << std::setw(20) << new_ns
+      << std::setw(20) << ref_ns
+      << std::setw(20) << static_ns
+      << std::setw(20) << static_ref_ns
+      << std::endl;
+}
+
+int main()
+{
+   int loops = 1000000;
+   int cores = thread::hardware_concurrency();
+
+   std::cout
+      << std::setw(8) << "aspects"
+      << std::setw(8) << "threads"
+      << std::setw(20) << "type_index (ns)"
+      << std::setw(20) << "dense id (ns)"
+      << std::setw(20) << "find_ref (ns)"
+      << std::setw(20) << "static find (ns)"
+      << std::setw(20) << "static ref (ns)"
+      << std::endl;
+
+   run<5>(loops, 1);
+   run<50>(loops, 1);
+   run<500>(loops, 1);
+
+   if(cores > 1)
+   {
+      run<5>(loops / cores, cores);
+      run<50>(loops / cores, cores);
+      run<500>(loops / cores, cores);
+   }
+
+   return 0;
+}
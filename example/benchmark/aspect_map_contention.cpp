@@ -0,0 +1,172 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark runs 64 threads that mix find and exchange on 16 aspects,
+// with 1%, 10% and 50% of exchanges, and reports the operations per second.
+// It compares the aspect_map (striped locks, lock-free find) with a map
+// that locks one recursive_mutex on each operation (the locking of
+// aspect_map before the stripes).
+//
+// Build it with BOOST_APPLICATION_ASPECT_MAP_STRIPES=1 (see Jamfile) to
+// compare with a single stripe, where all writers are serialized.
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/lockable_adapter.hpp>
+
+using namespace boost;
+
+// aspects used by benchmark
+template <int N>
+struct bench_aspect
+{
+   bench_aspect() : value(N) {}
+   int value;
+};
+
+// one recursive_mutex for all operations
+class locked_aspect_map
+   : public basic_lockable_adapter<recursive_mutex>
+{
+   std::vector< shared_ptr<void> > slots_;
+
+public:
+
+   template <class T>
+   shared_ptr<T> find() {
+      strict_lock<locked_aspect_map> guard(*this);
+      std::size_t id = application::detail::aspect_id<T>();
+
+      if(slots_.size() <= id)
+         return shared_ptr<T>();
+
+      return static_pointer_cast<T>(slots_[id]);
+   }
+
+   template <class T>
+   shared_ptr<T> exchange(shared_ptr<T> asp) {
+      strict_lock<locked_aspect_map> guard(*this);
+      std::size_t id = application::detail::aspect_id<T>();
+
+      if(slots_.size() <= id)
+         slots_.resize(id + 1);
+
+      slots_[id] = asp;
+      return shared_ptr<T>();
+   }
+};
+
+const int aspects = 16;
+
+// the operation on aspect n, find or exchange
+template <int N>
+struct operation
+{
+   template <class Map>
+   static long on(Map& m, int n, bool write) {
+      if(n != N)
+         return operation<N + 1>::on(m, n, write);
+
+      if(write) {
+         m.exchange(make_shared< bench_aspect<N> >());
+         return 0;
+      }
+
+      return m.template find< bench_aspect<N> >()->value;
+   }
+};
+
+template <>
+struct operation<aspects>
+{
+   template <class Map>
+   static long on(Map&, int, bool) { return 0; }
+};
+
+template <class Map>
+void mix(Map& m, int loops, int write_percent, unsigned seed)
+{
+   long sum = 0;
+
+   for(int i = 0; i < loops; ++i)
+   {
+      // xorshift
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+
+      sum += operation<0>::on(m, seed % aspects, (seed >> 8) % 100 < (unsigned)write_percent);
+   }
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+// operations per second of all threads
+template <class Map>
+double ops(Map& m, int loops, int threads, int write_percent)
+{
+   // all aspects are present
+   for(int n = 0; n < aspects; ++n)
+      operation<0>::on(m, n, true);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   thread_group group;
+   for(int t = 0; t < threads; ++t)
+      group.create_thread(boost::bind(&mix<Map>, boost::ref(m), loops,
+         write_percent, (unsigned)t * 2654435761u + 1));
+
+   group.join_all();
+
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   return double(loops) * threads / elapsed.count();
+}
+
+void run(int loops, int threads, int write_percent)
+{
+   locked_aspect_map locked_map;
+   application::aspect_map striped_map;
+
+   double locked_ops = ops(locked_map, loops, threads, write_percent);
+   double striped_ops = ops(striped_map, loops, threads, write_percent);
+
+   std::cout
+      << std::setw(8) << threads
+      << std::setw(10) << write_percent
+      << std::setw(22) << std::fixed << std::setprecision(0) << locked_ops
+      << std::setw(22) << striped_ops
+      << std::endl;
+}
+
+int main()
+{
+   int threads = 64;
+   int loops = 100000;
+
+   std::cout << "stripes: " << BOOST_APPLICATION_ASPECT_MAP_STRIPES
+             << ", cores: " << thread::hardware_concurrency() << std::endl;
+
+   std::cout
+      << std::setw(8) << "threads"
+      << std::setw(10) << "write %"
+      << std::setw(22) << "recursive_mutex op/s"
+      << std::setw(22) << "aspect_map op/s"
+      << std::endl;
+
+   run(loops, threads, 1);
+   run(loops, threads, 10);
+   run(loops, threads, 50);
+
+   return 0;
+}
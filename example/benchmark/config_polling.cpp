@@ -0,0 +1,118 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark runs workers that use a config aspect on each iteration,
+// while it is exchanged from time to time, and reports the time of one
+// iteration when the workers:
+//
+// - poll the config with find<T>() on each iteration
+// - check the version counter of config, and only find it when it changes
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+
+using namespace boost;
+
+struct config
+{
+   config(int v) : value(v) {}
+   int value;
+};
+
+void polling(application::context& cxt, int loops)
+{
+   long sum = 0;
+
+   for(int i = 0; i < loops; ++i)
+      sum += cxt.find<config>()->value;
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+void versioned(application::context& cxt, int loops)
+{
+   const atomic<application::aspect_map::version_type>& version =
+      cxt.version_counter<config>();
+
+   application::aspect_map::version_type seen = version.load();
+   shared_ptr<config> cfg = cxt.find<config>();
+
+   long sum = 0;
+
+   for(int i = 0; i < loops; ++i)
+   {
+      if(version.load(memory_order_acquire) != seen)
+      {
+         seen = version.load(memory_order_acquire);
+         cfg = cxt.find<config>();
+      }
+
+      sum += cfg->value;
+   }
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+// average time of one iteration, in ns, seen by each worker
+double iteration_ns(void (*worker)(application::context&, int),
+                    application::context& cxt, int loops, int threads)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   thread_group group;
+   for(int t = 0; t < threads; ++t)
+      group.create_thread(boost::bind(worker, boost::ref(cxt), loops));
+
+   // a new config each millisecond, for the first 50 ms
+   for(int i = 0; chrono::steady_clock::now() - start < chrono::milliseconds(50); ++i)
+   {
+      cxt.exchange<config>(make_shared<config>(i));
+      this_thread::sleep_for(chrono::milliseconds(1));
+   }
+
+   group.join_all();
+
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   return double(elapsed.count()) / loops;
+}
+
+int main()
+{
+   int loops = 10000000;
+   int threads = thread::hardware_concurrency();
+
+   application::context cxt;
+   cxt.insert<config>(make_shared<config>(0));
+
+   std::cout << "threads: " << threads << std::endl;
+
+   std::cout
+      << std::setw(24) << "worker"
+      << std::setw(16) << "ns/iteration"
+      << std::endl;
+
+   std::cout
+      << std::setw(24) << "find on each iteration"
+      << std::setw(16) << std::fixed << std::setprecision(2)
+      << iteration_ns(&polling, cxt, loops, threads)
+      << std::endl;
+
+   std::cout
+      << std::setw(24) << "version counter"
+      << std::setw(16) << std::fixed << std::setprecision(2)
+      << iteration_ns(&versioned, cxt, loops, threads)
+      << std::endl;
+
+   return 0;
+}
@@ -0,0 +1,144 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark creates a context per request, as the apache2 handler
+// (handle_request) does, adds 5 aspects and tears it down. It reports the
+// heap allocations and the time per request of:
+//
+// - a context, with aspects created by make_shared and insert
+// - a context on an aspect_arena, with aspects built by emplace, and one
+//   reset of the arena per request
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+
+using namespace boost;
+
+// counts the heap allocations
+
+long allocations = 0;
+
+void* operator new(std::size_t size)
+{
+   ++allocations;
+
+   if(void* p = std::malloc(size ? size : 1))
+      return p;
+
+   throw std::bad_alloc();
+}
+
+BOOST_NOINLINE void operator delete(void* p) BOOST_NOEXCEPT
+{
+   std::free(p);
+}
+
+BOOST_NOINLINE void operator delete(void* p, std::size_t) BOOST_NOEXCEPT
+{
+   std::free(p);
+}
+
+// aspects of a request
+template <int N>
+struct request_aspect
+{
+   request_aspect(int v) : value(v) {}
+   int value;
+};
+
+long use(application::context& cxt)
+{
+   return cxt.find< request_aspect<0> >()->value
+        + cxt.find< request_aspect<4> >()->value;
+}
+
+long heap_request()
+{
+   application::context cxt;
+
+   cxt.insert< application::status >(
+      make_shared<application::status>(application::status::running));
+   cxt.insert< request_aspect<0> >(make_shared< request_aspect<0> >(0));
+   cxt.insert< request_aspect<1> >(make_shared< request_aspect<1> >(1));
+   cxt.insert< request_aspect<3> >(make_shared< request_aspect<3> >(3));
+   cxt.insert< request_aspect<4> >(make_shared< request_aspect<4> >(4));
+
+   return use(cxt);
+}
+
+application::aspect_arena arena;
+
+long arena_request()
+{
+   long r;
+
+   {
+      application::context cxt(arena);
+
+      cxt.emplace< application::status >(application::status::running);
+      cxt.emplace< request_aspect<0> >(0);
+      cxt.emplace< request_aspect<1> >(1);
+      cxt.emplace< request_aspect<3> >(3);
+      cxt.emplace< request_aspect<4> >(4);
+
+      r = use(cxt);
+   }
+
+   arena.reset();
+   return r;
+}
+
+void run(const char* name, long (*request)(), int requests)
+{
+   long sum = 0;
+
+   // warm up
+   for(int i = 0; i < 100; ++i)
+      sum += request();
+
+   long before = allocations;
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for(int i = 0; i < requests; ++i)
+      sum += request();
+
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   long count = allocations - before;
+
+   std::cout
+      << std::setw(24) << name
+      << std::setw(20) << std::fixed << std::setprecision(2)
+      << double(count) / requests
+      << std::setw(16) << double(elapsed.count()) / requests
+      << std::endl;
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+int main()
+{
+   int requests = 200000;
+
+   std::cout
+      << std::setw(24) << "context"
+      << std::setw(20) << "allocations/request"
+      << std::setw(16) << "ns/request"
+      << std::endl;
+
+   run("heap (make_shared)", &heap_request, requests);
+   run("arena (emplace)", &arena_request, requests);
+
+   return 0;
+}
@@ -0,0 +1,113 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark measures the time that daemonize (USE_DAEMONIZE_VER_1)
+// spends closing the inherited descriptors, with a high RLIMIT_NOFILE
+// (1M if the process can set it, else the hard limit) and 64 open
+// descriptors, one of them kept (allow-list).
+//
+// loop:        close() up to RLIMIT_NOFILE, as daemonize did before
+// proc:        close() of descriptors listed on /proc/self/fd
+// close_range: close_range(2), the one used when available
+//
+// Each way runs on a forked child (as daemonize), the child reports the
+// time on the kept descriptor.
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <boost/application.hpp>
+#include <boost/application/detail/posix/close_fds_impl.hpp>
+#include <boost/chrono.hpp>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace boost;
+
+typedef chrono::steady_clock clock_type;
+typedef bool (*close_fds_type)(int, const std::vector<int>&);
+
+// time in us, or -1 if the way is not available
+double run_child(close_fds_type close_fds)
+{
+   int fds[2];
+   if(pipe(fds) != 0)
+      return -1;
+
+   pid_t pid = fork();
+
+   if(pid == 0) {
+      std::vector<int> keep(1, fds[1]);
+
+      clock_type::time_point start = clock_type::now();
+      bool done = close_fds(3, keep);
+      double us = chrono::duration<double, micro>(clock_type::now() - start).count();
+
+      if(!done)
+         us = -1;
+
+      ssize_t r = write(fds[1], &us, sizeof(us));
+      _exit(r == sizeof(us) ? 0 : 1);
+   }
+
+   close(fds[1]);
+
+   double us = -1;
+   if(read(fds[0], &us, sizeof(us)) != sizeof(us))
+      us = -1;
+
+   close(fds[0]);
+   waitpid(pid, 0, 0);
+
+   return us;
+}
+
+int main()
+{
+   struct rlimit rl;
+   getrlimit(RLIMIT_NOFILE, &rl);
+
+   rl.rlim_cur = rl.rlim_max = 1024 * 1024;
+   if(setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+      getrlimit(RLIMIT_NOFILE, &rl);
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+   }
+
+   std::vector<int> open_fds;
+   for(int i = 0; i < 64; ++i)
+      open_fds.push_back(dup(0));
+
+   std::cout << "RLIMIT_NOFILE: " << rl.rlim_max
+             << ", open descriptors: " << open_fds.size() + 3 << std::endl;
+
+   const char* names[] = { "loop", "proc", "close_range" };
+   close_fds_type ways[] = {
+      &application::detail::close_fds_loop,
+      &application::detail::close_fds_proc,
+      &application::detail::close_fds_range
+   };
+
+   std::cout << std::setw(12) << "way" << std::setw(14) << "time (us)" << std::endl;
+
+   for(int i = 0; i < 3; ++i) {
+      double us = run_child(ways[i]);
+
+      std::cout << std::setw(12) << names[i];
+
+      if(us < 0)
+         std::cout << std::setw(14) << "n/a" << std::endl;
+      else
+         std::cout << std::setw(14) << std::fixed << std::setprecision(1) << us << std::endl;
+   }
+
+   return 0;
+}
@@ -0,0 +1,171 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark gets the 5 aspects that a handler needs at the setup of a
+// request (status, run_mode, args, config and logger), on all threads of
+// machine, and reports the time of one setup:
+//
+// - 5 find<T>() calls, against 1 find_all<...>()
+// - 5 find<T>(guard) calls on a strict_lock, against 1 find_all<...>(guard)
+// - 1 find_all<...>(read_guard), borrowed access without refcount
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+
+using namespace boost;
+
+// aspects used by benchmark
+template <int N>
+struct bench_aspect
+{
+   bench_aspect() : value(N) {}
+   int value;
+};
+
+typedef bench_aspect<0> status_aspect;
+typedef bench_aspect<1> run_mode_aspect;
+typedef bench_aspect<2> args_aspect;
+typedef bench_aspect<3> config_aspect;
+typedef bench_aspect<4> logger_aspect;
+
+long finds(application::context& cxt)
+{
+   return cxt.find<status_aspect>()->value
+        + cxt.find<run_mode_aspect>()->value
+        + cxt.find<args_aspect>()->value
+        + cxt.find<config_aspect>()->value
+        + cxt.find<logger_aspect>()->value;
+}
+
+long find_all(application::context& cxt)
+{
+   shared_ptr<status_aspect> st;
+   shared_ptr<run_mode_aspect> mode;
+   shared_ptr<args_aspect> args;
+   shared_ptr<config_aspect> config;
+   shared_ptr<logger_aspect> logger;
+
+   std::tie(st, mode, args, config, logger) = cxt.find_all<
+      status_aspect, run_mode_aspect, args_aspect, config_aspect, logger_aspect>();
+
+   return st->value + mode->value + args->value + config->value + logger->value;
+}
+
+long guarded_finds(application::context& cxt)
+{
+   strict_lock<application::aspect_map> guard(cxt);
+
+   return cxt.find<status_aspect>(guard)->value
+        + cxt.find<run_mode_aspect>(guard)->value
+        + cxt.find<args_aspect>(guard)->value
+        + cxt.find<config_aspect>(guard)->value
+        + cxt.find<logger_aspect>(guard)->value;
+}
+
+long guarded_find_all(application::context& cxt)
+{
+   strict_lock<application::aspect_map> guard(cxt);
+
+   shared_ptr<status_aspect> st;
+   shared_ptr<run_mode_aspect> mode;
+   shared_ptr<args_aspect> args;
+   shared_ptr<config_aspect> config;
+   shared_ptr<logger_aspect> logger;
+
+   std::tie(st, mode, args, config, logger) = cxt.find_all<
+      status_aspect, run_mode_aspect, args_aspect, config_aspect, logger_aspect>(guard);
+
+   return st->value + mode->value + args->value + config->value + logger->value;
+}
+
+long borrowed_find_all(application::context& cxt)
+{
+   application::aspect_map::read_guard guard(cxt);
+
+   status_aspect* st;
+   run_mode_aspect* mode;
+   args_aspect* args;
+   config_aspect* config;
+   logger_aspect* logger;
+
+   std::tie(st, mode, args, config, logger) = cxt.find_all<
+      status_aspect, run_mode_aspect, args_aspect, config_aspect, logger_aspect>(guard);
+
+   return st->value + mode->value + args->value + config->value + logger->value;
+}
+
+void setups(long (*setup)(application::context&), application::context& cxt,
+            int loops)
+{
+   long sum = 0;
+
+   for(int i = 0; i < loops; ++i)
+      sum += setup(cxt);
+
+   if(sum < 0) // keep sum alive
+      std::cout << sum;
+}
+
+// average time of one setup, in ns, seen by each thread
+double setup_ns(long (*setup)(application::context&), application::context& cxt,
+                int loops, int threads)
+{
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   thread_group group;
+   for(int t = 0; t < threads; ++t)
+      group.create_thread(boost::bind(&setups, setup, boost::ref(cxt), loops));
+
+   group.join_all();
+
+   chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+   return double(elapsed.count()) / loops;
+}
+
+void run(const char* name, long (*setup)(application::context&),
+         application::context& cxt, int loops, int threads)
+{
+   std::cout
+      << std::setw(28) << name
+      << std::setw(16) << std::fixed << std::setprecision(2)
+      << setup_ns(setup, cxt, loops, threads)
+      << std::endl;
+}
+
+int main()
+{
+   int loops = 1000000;
+   int threads = thread::hardware_concurrency();
+
+   application::context cxt;
+
+   cxt.insert<status_aspect>(make_shared<status_aspect>());
+   cxt.insert<run_mode_aspect>(make_shared<run_mode_aspect>());
+   cxt.insert<args_aspect>(make_shared<args_aspect>());
+   cxt.insert<config_aspect>(make_shared<config_aspect>());
+   cxt.insert<logger_aspect>(make_shared<logger_aspect>());
+
+   std::cout << "threads: " << threads << std::endl;
+
+   std::cout
+      << std::setw(28) << "5 aspects"
+      << std::setw(16) << "ns/setup"
+      << std::endl;
+
+   run("5 x find", &finds, cxt, loops, threads);
+   run("find_all", &find_all, cxt, loops, threads);
+   run("strict_lock, 5 x find", &guarded_finds, cxt, loops, threads);
+   run("strict_lock, find_all", &guarded_find_all, cxt, loops, threads);
+   run("read_guard, find_all", &borrowed_find_all, cxt, loops, threads);
+
+   return 0;
+}
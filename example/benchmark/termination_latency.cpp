@@ -0,0 +1,163 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark measures the latency from a SIGTERM to the return of
+// wait_for_termination_request::wait(), using the pre-resolved shutdown
+// path of signal_manager, and using the lookup of aspects on each
+// termination (the behaviour before the shutdown path).
+//
+// The wait_for_termination_request_impl variant is selected at compile
+// time, see Jamfile.v2:
+//
+// USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED
+// USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_SIGUSR1_BASED
+// (none) selfpipe based, the default
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+
+using namespace boost;
+
+#if defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED )
+const char* variant = "futex";
+#elif defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_SIGUSR1_BASED )
+const char* variant = "sigusr1";
+#else
+const char* variant = "selfpipe";
+#endif
+
+typedef chrono::steady_clock clock_type;
+
+bool terminate()
+{
+   return true;
+}
+
+class bench_signal_manager : public application::signal_manager
+{
+public:
+   bench_signal_manager(application::context &context)
+      : application::signal_manager(context) {}
+
+   void start()
+   {
+      signal_manager::start();
+   }
+};
+
+// the lookup of each aspect on termination
+class lookup_signal_manager : public bench_signal_manager
+{
+public:
+   lookup_signal_manager(application::context &context)
+      : bench_signal_manager(context) {}
+
+protected:
+   bool termination_signal_handler()
+   {
+      context_.find<application::status>()->state(application::status::stopped);
+
+      shared_ptr<application::limit_single_instance> si
+         = context_.find<application::limit_single_instance>();
+
+      if(si)
+         si->release(true);
+
+      context_.find<application::wait_for_termination_request>()->proceed();
+      return false;
+   }
+};
+
+void send_sigterm(clock_type::time_point& sent)
+{
+   // let main thread block on wait()
+   this_thread::sleep_for(chrono::milliseconds(1));
+
+   sent = clock_type::now();
+   kill(getpid(), SIGTERM);
+}
+
+// latency of one termination, in us
+template <class SignalManager>
+double termination_us()
+{
+   application::context app_context;
+
+   app_context.insert<application::termination_handler>(
+      make_shared<application::termination_handler_default_behaviour>(
+         application::handler<>::callback(&terminate)));
+
+   SignalManager sm(app_context);
+   sm.start();
+
+   clock_type::time_point sent;
+   thread sender(boost::bind(&send_sigterm, boost::ref(sent)));
+
+   app_context.find<application::wait_for_termination_request>()->wait();
+   clock_type::time_point woken = clock_type::now();
+
+   sender.join();
+
+   return double(chrono::duration_cast<chrono::nanoseconds>(
+      woken - sent).count()) / 1000.0;
+}
+
+template <class SignalManager>
+void run(const char* path, int loops)
+{
+   std::vector<double> samples;
+
+   for(int i = 0; i < loops; ++i)
+      samples.push_back(termination_us<SignalManager>());
+
+   std::sort(samples.begin(), samples.end());
+
+   double sum = 0;
+   for(std::size_t i = 0; i < samples.size(); ++i)
+      sum += samples[i];
+
+   std::cout
+      << std::setw(10) << variant
+      << std::setw(14) << path
+      << std::setw(12) << std::fixed << std::setprecision(2) << sum / loops
+      << std::setw(12) << samples[loops / 2]
+      << std::setw(12) << samples[loops * 99 / 100]
+      << std::endl;
+}
+
+int main()
+{
+#if defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_SIGUSR1_BASED )
+   // all threads need block SIGUSR1
+   sigset_t sset;
+   sigemptyset(&sset);
+   sigaddset(&sset, SIGUSR1);
+   sigprocmask(SIG_BLOCK, &sset, NULL);
+#endif
+
+   int loops = 500;
+
+   std::cout
+      << std::setw(10) << "variant"
+      << std::setw(14) << "path"
+      << std::setw(12) << "mean (us)"
+      << std::setw(12) << "p50 (us)"
+      << std::setw(12) << "p99 (us)"
+      << std::endl;
+
+   run<lookup_signal_manager>("lookup", loops);
+   run<bench_signal_manager>("pre-resolved", loops);
+
+   return 0;
+}
@@ -0,0 +1,206 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// -----------------------------------------------------------------------------
+// This benchmark compares the work_queue aspect (work stealing, one deque
+// for each worker) with the work_queue of example/work_queue (one
+// io_service shared by all threads), using the gaussian_blur workload of
+// that example: many small tasks that produce a gaussian kernel.
+//
+// The tasks are added one by one from the main thread, and as one bulk
+// (add_tasks). The last column is the case of tasks that fan out in
+// subtasks from the workers, that only the work_queue aspect can wait.
+// -----------------------------------------------------------------------------
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+
+using namespace boost;
+
+// the work_queue of example/work_queue, before the work_queue aspect
+class asio_work_queue
+{
+public:
+
+   explicit asio_work_queue(int workers)
+      : work_ctrl_(new asio::io_service::work(io_service_))
+   {
+      for (int i = 0; i < workers; ++i)
+      {
+         threads_.create_thread(boost::bind(&asio::io_service::run, &io_service_));
+      }
+   }
+
+   ~asio_work_queue()
+   {
+      delete work_ctrl_;
+      threads_.join_all();
+   }
+
+   template <typename TTask>
+   void add_task(TTask task)
+   {
+      io_service_.dispatch(task);
+   }
+
+private:
+
+   asio::io_service io_service_;
+   thread_group threads_;
+
+   asio::io_service::work *work_ctrl_;
+};
+
+// the gaussian_blur of example/work_queue, without the output
+double gaussian(double x, double mu, double sigma)
+{
+   return exp( -(((x-mu)/(sigma))*((x-mu)/(sigma)))/2.0 );
+}
+
+atomic<long> checksum(0);
+
+void gaussian_blur(int radius, application::task_latch* done)
+{
+   std::vector< std::vector<double> > kernel2d(2*radius+1, std::vector<double>(2*radius+1));
+
+   double sigma = radius/2.;
+   double sum = 0;
+
+   for (std::size_t row = 0; row < kernel2d.size(); row++)
+   {
+      for (std::size_t col = 0; col < kernel2d[row].size(); col++)
+      {
+         kernel2d[row][col] = gaussian(row, radius, sigma) * gaussian(col, radius, sigma);
+         sum += kernel2d[row][col];
+      }
+   }
+
+   for (std::size_t row = 0; row < kernel2d.size(); row++)
+      for (std::size_t col = 0; col < kernel2d[row].size(); col++)
+         kernel2d[row][col] /= sum;
+
+   checksum.fetch_add(long(kernel2d[radius][radius] * 1000), memory_order_relaxed);
+
+   if(done)
+      done->count_down();
+}
+
+// radius 3, 6 and 9 as on example
+int radius_of(int i)
+{
+   return 3 * (1 + i % 3);
+}
+
+double tasks_per_second(int tasks, chrono::steady_clock::time_point start)
+{
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   return tasks / elapsed.count();
+}
+
+double run_asio(int workers, int tasks)
+{
+   asio_work_queue queue(workers);
+   application::task_latch done(tasks);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for(int i = 0; i < tasks; ++i)
+      queue.add_task(boost::bind(&gaussian_blur, radius_of(i), &done));
+
+   done.wait();
+   return tasks_per_second(tasks, start);
+}
+
+double run_work_stealing(int workers, int tasks)
+{
+   application::work_queue queue(workers);
+   application::task_latch done;
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for(int i = 0; i < tasks; ++i)
+      queue.add_task(boost::bind(&gaussian_blur, radius_of(i), (application::task_latch*)0), done);
+
+   queue.wait(done);
+   return tasks_per_second(tasks, start);
+}
+
+double run_work_stealing_bulk(int workers, int tasks)
+{
+   application::work_queue queue(workers);
+   application::task_latch done;
+
+   std::vector<application::work_queue::task_type> bulk;
+   bulk.reserve(tasks);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for(int i = 0; i < tasks; ++i)
+      bulk.push_back(boost::bind(&gaussian_blur, radius_of(i), (application::task_latch*)0));
+
+   queue.add_tasks(bulk.begin(), bulk.end(), done);
+
+   queue.wait(done);
+   return tasks_per_second(tasks, start);
+}
+
+// one task for each 1000 blur, that adds them from a worker
+void fan_out(application::work_queue& queue, int first, int count)
+{
+   application::task_latch done;
+
+   for(int i = first; i < first + count; ++i)
+      queue.add_task(boost::bind(&gaussian_blur, radius_of(i), (application::task_latch*)0), done);
+
+   queue.wait(done);
+}
+
+double run_work_stealing_nested(int workers, int tasks)
+{
+   application::work_queue queue(workers);
+   application::task_latch done;
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   for(int i = 0; i < tasks; i += 1000)
+      queue.add_task(boost::bind(&fan_out, boost::ref(queue), i, 1000), done);
+
+   queue.wait(done);
+   return tasks_per_second(tasks, start);
+}
+
+int main()
+{
+   int tasks = 200000;
+   int cores = thread::hardware_concurrency();
+
+   std::cout
+      << std::setw(8) << "threads"
+      << std::setw(16) << "asio (task/s)"
+      << std::setw(16) << "steal (task/s)"
+      << std::setw(16) << "bulk (task/s)"
+      << std::setw(16) << "nested (task/s)"
+      << std::endl;
+
+   for(int workers = 1; workers <= 4 * cores; workers *= 2)
+   {
+      std::cout
+         << std::setw(8) << workers
+         << std::setw(16) << std::fixed << std::setprecision(0) << run_asio(workers, tasks)
+         << std::setw(16) << run_work_stealing(workers, tasks)
+         << std::setw(16) << run_work_stealing_bulk(workers, tasks)
+         << std::setw(16) << run_work_stealing_nested(workers, tasks)
+         << std::endl;
+   }
+
+   return 0;
+}
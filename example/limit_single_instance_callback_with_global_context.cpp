@@ -26,8 +26,8 @@ using namespace boost::application;
 
 // singleton access
 
-inline global_context_ptr this_application() {
-   return global_context::get();
+inline global_context* this_application() {
+   return global_context::instance();
 }
 
 // my functor application
@@ -21,8 +21,8 @@ using namespace boost;
 
 // singleton access
 
-inline application::global_context_ptr this_application() {
-   return application::global_context::get();
+inline application::global_context* this_application() {
+   return application::global_context::instance();
 }
 
 // my functor application
@@ -60,8 +60,8 @@ using namespace boost;
 
 // my application code
 
-inline application::global_context_ptr this_application() {
-   return application::global_context::get();
+inline application::global_context* this_application() {
+   return application::global_context::instance();
 }
 
 class myapp
@@ -4,8 +4,8 @@
 // or copy at http://www.boost.org/LICENSE_1_0.txt)
 
 // -----------------------------------------------------------------------------
-// This example shows how implement a work quee (thread pool) to work with
-// Boost.Application using Boost.Asio.
+// This example shows how use the work_queue aspect (a work stealing thread
+// pool) with Boost.Application.
 //
 // The result will be printed on CTRL-C (Stop) signal
 // -----------------------------------------------------------------------------
@@ -19,8 +19,6 @@
 #include <iostream>
 #include <math.h>
 
-#include "work_queue.hpp"
-
 using namespace std;
 using namespace boost;
 
@@ -95,7 +93,7 @@ private:
 };
 
 // application class
-class myapp : work_queue<0> 
+class myapp
 {
 public: 
 
@@ -123,10 +121,13 @@ public:
       // your application logic here!
       task_count_ = 0;
 
+      application::csbl::shared_ptr<application::work_queue> queue = 
+         context_.find<application::work_queue>();
+
       //our tasks
-      add_task(gaussian_blur<3>( boost::bind( &myapp::add_result, this, _1 ))); 
-      add_task(gaussian_blur<6>( boost::bind( &myapp::add_result, this, _1 ))); 
-      add_task(gaussian_blur<9>( boost::bind( &myapp::add_result, this, _1 ))); 
+      queue->add_task(gaussian_blur<3>( boost::bind( &myapp::add_result, this, _1 ))); 
+      queue->add_task(gaussian_blur<6>( boost::bind( &myapp::add_result, this, _1 ))); 
+      queue->add_task(gaussian_blur<9>( boost::bind( &myapp::add_result, this, _1 ))); 
      
       context_.find<application::wait_for_termination_request>()->wait();
 
@@ -173,6 +174,10 @@ int main(int argc, char *argv[])
 
    application::context app_context;
    myapp app(app_context);
+
+   // use available cores of machine
+   app_context.insert<application::work_queue>(
+      make_shared<application::work_queue>());
    
    application::handler<>::callback cb 
       = boost::bind(&myapp::stop, &app);
@@ -16,6 +16,7 @@
 // application
 #include <boost/application/version.hpp>
 #include <boost/application/context.hpp>
+#include <boost/application/static_context.hpp>
 #include <boost/application/launch.hpp>
 #include <boost/application/auto_handler.hpp>
 // #include <boost/application/auto_app.hpp>
@@ -25,7 +26,12 @@
 #include <boost/application/aspects/wait_for_termination_request.hpp>
 #include <boost/application/aspects/path.hpp>
 #include <boost/application/aspects/termination_handler.hpp>
+#include <boost/application/aspects/pause_handler.hpp>
+#include <boost/application/aspects/resume_handler.hpp>
 #include <boost/application/aspects/process_id.hpp>
+#include <boost/application/aspects/io_service_pool.hpp>
+#include <boost/application/aspects/work_queue.hpp>
+#include <boost/application/aspects/drain_controller.hpp>
 
 #ifdef BOOST_HAS_PRAGMA_ONCE
 # pragma once
@@ -0,0 +1,392 @@
+// Copyright 2014 Renato Tegon Forti.
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_APPLICATION_ASPECT_ARENA_HPP
+#define BOOST_APPLICATION_ASPECT_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <limits>
+#include <utility>
+
+#include <boost/config.hpp>
+#include <boost/application/config.hpp>
+
+#include <boost/core/noncopyable.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+
+/// \file boost/application/aspect_arena.hpp
+/// \brief Contains the boost::application::aspect_arena, a monotonic
+/// memory resource that can back the storage of an aspect_map (context),
+/// and the boost::application::arena_allocator that allocates on it.
+
+namespace boost { namespace application {
+
+   namespace detail {
+
+      // the most aligned fundamental types
+      union max_align {
+         long double ld;
+         long long ll;
+         double d;
+         void* p;
+         void (*f)();
+      };
+
+      static const std::size_t max_alignment =
+         boost::alignment_of<max_align>::value;
+
+      inline char* align_up(char* p, std::size_t alignment) {
+         std::size_t a = reinterpret_cast<std::size_t>(p);
+         return reinterpret_cast<char*>((a + alignment - 1) & ~(alignment - 1));
+      }
+
+   } // detail
+
+   /*!
+    * \brief A monotonic memory resource for short lived contexts.
+    *
+    * The memory is handed out by bumping a pointer on the current block,
+    * deallocation does nothing, and all memory is released at once by
+    * reset(). When a block is exhausted a new one, twice as big, is taken
+    * from the heap.
+    *
+    * It is intended for a context per request (e.g. an apache handler),
+    * all aspects of the context are built inside of the arena
+    * (see aspect_map::emplace) and the teardown of the request is the
+    * destruction of the context followed by one reset() of the arena.
+    *
+    * reset() keeps one block as big as all memory used since the last
+    * reset, so a steady workload stops allocating from the heap after
+    * the first requests.
+    *
+    * The arena must outlive the contexts (and any aspect shared_ptr)
+    * that use it, and reset() can only be called when they are gone.
+    *
+    * <STRONG> Thread Safe: </STRONG> Yes <BR>
+    * <STRONG> Exception Safe: </STRONG>  Yes
+    *
+    * \b Examples:
+    * \code
+    * application::aspect_arena arena;
+    *
+    * for(;;) {
+    *    {
+    *       application::context cxt(arena);
+    *       cxt.emplace<status>(status::running);
+    *       // ...
+    *    }
+    *
+    *    arena.reset();
+    * }
+    * \endcode
+    */
+   class aspect_arena : noncopyable {
+   public:
+
+      /*!
+       * Constructs an arena that takes its blocks from the heap.
+       *
+       * \param block_size The size of first block.
+       */
+      explicit aspect_arena(std::size_t block_size = 4096)
+         : base_(0)
+         , base_size_(0)
+         , base_owned_(false) {
+         init(block_size);
+      }
+
+      /*!
+       * Constructs an arena that first uses buffer (e.g. on the stack),
+       * and then takes blocks from the heap. The buffer is not owned.
+       *
+       * \param buffer The initial memory.
+       * \param size The size of buffer.
+       * \param block_size The size of first block taken from the heap.
+       */
+      aspect_arena(void* buffer, std::size_t size, std::size_t block_size = 4096)
+         : base_(static_cast<char*>(buffer))
+         , base_size_(size)
+         , base_owned_(false) {
+         init(block_size);
+      }
+
+      ~aspect_arena() {
+         release();
+
+         if(base_owned_)
+            ::operator delete(base_);
+      }
+
+      /*!
+       * Allocates size bytes aligned on alignment (a power of 2).
+       *
+       * \throw std::bad_alloc if a new block can't be allocated.
+       */
+      void* allocate(std::size_t size,
+                     std::size_t alignment = detail::max_alignment) {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         if(!size)
+            size = 1;
+
+         char* p = detail::align_up(current_, alignment);
+
+         if(!current_ || p + size > end_) {
+            grow(size + alignment);
+            p = detail::align_up(current_, alignment);
+         }
+
+         current_ = p + size;
+         allocated_ += size;
+
+         return p;
+      }
+
+      /*!
+       * Does nothing, the memory is released by reset().
+       */
+      void deallocate(void*, std::size_t) {
+      }
+
+      /*!
+       * Releases all memory allocated from the arena.
+       *
+       * If the arena needed more blocks since the last reset, they are
+       * replaced by one block of the size of all of them.
+       *
+       * \throw std::bad_alloc if the block can't be allocated.
+       */
+      void reset() {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         if(head_) {
+            std::size_t total = base_size_ + overflow_;
+
+            release();
+
+            if(base_owned_) {
+               ::operator delete(base_);
+               base_ = 0;
+               base_size_ = 0;
+               base_owned_ = false;
+            }
+
+            base_ = static_cast<char*>(::operator new(total));
+            base_size_ = total;
+            base_owned_ = true;
+         }
+
+         current_ = base_;
+         end_ = base_ + base_size_;
+         allocated_ = 0;
+      }
+
+      /*!
+       * The number of bytes allocated since the last reset.
+       */
+      std::size_t allocated() const {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         return allocated_;
+      }
+
+      /*!
+       * The number of blocks that the arena holds from the heap.
+       */
+      std::size_t blocks() const {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         return count_ + (base_owned_ ? 1 : 0);
+      }
+
+   private:
+
+      // a block taken from the heap, the memory follows the header
+      struct block {
+         block* next;
+         std::size_t size;
+      };
+
+      static std::size_t header() {
+         return (sizeof(block) + detail::max_alignment - 1)
+            & ~(detail::max_alignment - 1);
+      }
+
+      void init(std::size_t block_size) {
+         current_ = base_;
+         end_ = base_ + base_size_;
+         next_size_ = block_size ? block_size : 1;
+         head_ = 0;
+         count_ = 0;
+         overflow_ = 0;
+         allocated_ = 0;
+      }
+
+      void grow(std::size_t min) {
+         std::size_t size = next_size_;
+
+         while(size < min)
+            size *= 2;
+
+         block* b = static_cast<block*>(::operator new(header() + size));
+         b->next = head_;
+         b->size = size;
+
+         head_ = b;
+         ++count_;
+         overflow_ += size;
+         next_size_ = size * 2;
+
+         current_ = reinterpret_cast<char*>(b) + header();
+         end_ = current_ + size;
+      }
+
+      // frees the blocks taken since last reset
+      void release() {
+         while(head_) {
+            block* next = head_->next;
+            ::operator delete(head_);
+            head_ = next;
+         }
+
+         count_ = 0;
+         overflow_ = 0;
+      }
+
+      mutable boost::mutex mutex_;
+
+      // the memory that is reused on reset
+      char* base_;
+      std::size_t base_size_;
+      bool base_owned_;
+
+      // the free space of current block
+      char* current_;
+      char* end_;
+
+      // blocks taken since last reset
+      block* head_;
+      std::size_t count_;
+      std::size_t overflow_;
+      std::size_t next_size_;
+
+      std::size_t allocated_;
+   };
+
+   /*!
+    * \brief An allocator that allocates on an aspect_arena.
+    *
+    * Deallocation does nothing, the memory is released by the reset of
+    * arena. A default constructed arena_allocator (no arena) allocates
+    * on the heap, with ::operator new.
+    *
+    * Used with allocate_shared to put an aspect and its shared_ptr
+    * control block inside of the arena.
+    */
+   template <class T>
+   class arena_allocator {
+   public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef std::size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+
+      template <class U>
+      struct rebind {
+         typedef arena_allocator<U> other;
+      };
+
+      arena_allocator() BOOST_NOEXCEPT
+         : arena_(0) {}
+
+      explicit arena_allocator(aspect_arena* arena) BOOST_NOEXCEPT
+         : arena_(arena) {}
+
+      template <class U>
+      arena_allocator(const arena_allocator<U>& other) BOOST_NOEXCEPT
+         : arena_(other.arena()) {}
+
+      pointer allocate(size_type n, const void* = 0) {
+         if(n > max_size())
+            throw std::bad_alloc();
+
+         if(arena_)
+            return static_cast<pointer>(arena_->allocate(
+               n * sizeof(T), boost::alignment_of<T>::value));
+
+         return static_cast<pointer>(::operator new(n * sizeof(T)));
+      }
+
+      void deallocate(pointer p, size_type n) {
+         if(arena_)
+            arena_->deallocate(p, n * sizeof(T));
+         else
+            ::operator delete(p);
+      }
+
+      size_type max_size() const BOOST_NOEXCEPT {
+         return (std::numeric_limits<size_type>::max)() / sizeof(T);
+      }
+
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_RVALUE_REFERENCES)
+      template <class U, class... Args>
+      void construct(U* p, Args&&... args) {
+         ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+      }
+
+      template <class U>
+      void destroy(U* p) {
+         p->~U();
+      }
+#else
+      void construct(pointer p, const T& value) {
+         ::new(static_cast<void*>(p)) T(value);
+      }
+
+      void destroy(pointer p) {
+         p->~T();
+      }
+#endif
+
+      pointer address(reference r) const {
+         return &r;
+      }
+
+      const_pointer address(const_reference r) const {
+         return &r;
+      }
+
+      aspect_arena* arena() const BOOST_NOEXCEPT {
+         return arena_;
+      }
+
+   private:
+      aspect_arena* arena_;
+   };
+
+   template <class T, class U>
+   inline bool operator==(const arena_allocator<T>& a,
+                          const arena_allocator<U>& b) BOOST_NOEXCEPT {
+      return a.arena() == b.arena();
+   }
+
+   template <class T, class U>
+   inline bool operator!=(const arena_allocator<T>& a,
+                          const arena_allocator<U>& b) BOOST_NOEXCEPT {
+      return a.arena() != b.arena();
+   }
+
+}}  // boost::application
+
+#endif // BOOST_APPLICATION_ASPECT_ARENA_HPP
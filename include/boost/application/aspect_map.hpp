@@ -9,26 +9,126 @@
 #define BOOST_APPLICATION_ASPECT_MAP_HPP
 
 #include <utility>
+#include <vector>
 
 #include <boost/config.hpp>
 #include <boost/application/config.hpp>
 #include <boost/application/detail/csbl.hpp>
+#include <boost/application/detail/epoch.hpp>
+#include <boost/application/aspect_arena.hpp>
 
+#include <boost/atomic.hpp>
+#include <boost/move/unique_ptr.hpp>
+#include <boost/type_traits/remove_cv.hpp>
+#include <boost/core/noncopyable.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/strict_lock.hpp>
-#include <boost/thread/lockable_adapter.hpp>
+#include <boost/static_assert.hpp>
+
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_HDR_TUPLE)
+#include <tuple>
+#endif
 
 #ifdef BOOST_HAS_PRAGMA_ONCE
 # pragma once
 #endif
 
+/// The number of stripes of aspect_map, each one with its own lock and
+/// snapshot. The aspect of id n is on stripe n % stripes.
+#ifndef BOOST_APPLICATION_ASPECT_MAP_STRIPES
+#define BOOST_APPLICATION_ASPECT_MAP_STRIPES 16
+#endif
+
+/// The number of aspect_map levels (the map and its parents) pinned
+/// inside of a read_guard, a deeper chain allocates the rest.
+#ifndef BOOST_APPLICATION_READ_GUARD_DEPTH
+#define BOOST_APPLICATION_READ_GUARD_DEPTH 4
+#endif
+
 /// \file boost/application/aspect_map.hpp
 /// \brief Contains only the boost::application::aspect_map container class that is capable of
 /// store any application aspects in thread safe way. 
 /// Internal locking and external locking support.
+/// Lookups (internal locking version) never block, they read an immutable
+/// snapshot of the aspects that is replaced on each modification
+/// (copy-on-write).
+/// Hot paths can borrow aspects, without refcount, through a read_guard.
+/// Each aspect type has a dense integer id, and the aspects are kept on
+/// flat tables indexed by that id, striped by id, so writers of different
+/// aspects don't block each other.
+/// The tables and the aspects (see emplace) can be kept on an
+/// aspect_arena, for contexts that live only for a request.
+/// A aspect_map can overlay a parent, lookups fall through to it.
+/// find_all gets several aspects at once, entering the snapshot (or
+/// checking the lock) only once.
+/// Changes of an aspect can be watched, through a version counter or a
+/// callback.
 
 namespace boost { namespace application {
 
+   namespace detail {
+
+      /*!
+       * Generates a new dense aspect identifier, in the same way
+       * new_run_mode does for application modes.
+       *
+       */
+      inline std::size_t new_aspect_id() {
+         static boost::atomic<std::size_t> id(0);
+         return id++;
+      }
+
+      template <class T>
+      inline std::size_t aspect_id_() {
+         static const std::size_t id = new_aspect_id();
+         return id;
+      }
+
+      /*!
+       * Retrieves the dense aspect identifier of T, that is generated on
+       * first use. It is used as index on the aspect_map table.
+       *
+       */
+      template <class T>
+      inline std::size_t aspect_id() {
+         return aspect_id_<typename boost::remove_cv<T>::type>();
+      }
+
+      /*!
+       * \brief Receives a notification each time a aspect is added, replaced
+       *        or removed from a aspect_map.
+       *
+       * The notification is done with the stripe of the aspect locked, by
+       * the thread that is changing the aspect_map, so the notifications of
+       * a given aspect are serialized, but the notifications of aspects on
+       * different stripes can be concurrent. On removal the value is a
+       * disengaged shared_ptr.
+       *
+       * Used by containers that keep its own view of some aspects,
+       * e.g.: static_context.
+       */
+      class aspect_map_observer {
+      public:
+         virtual ~aspect_map_observer() {}
+
+         virtual void changed(std::size_t id,
+            const csbl::shared_ptr<void>& value) = 0;
+      };
+
+      // calls f with the aspect casted to T
+      template <class T, class F>
+      struct watch_caller {
+         explicit watch_caller(F f) : f_(f) {}
+
+         void operator()(const csbl::shared_ptr<void>& value) const {
+            f_(csbl::static_pointer_cast<T>(value));
+         }
+
+         mutable F f_;
+      };
+
+   } // detail
+
    /*!
     * \brief The aspect_map class implementation.
     *
@@ -42,33 +142,538 @@ namespace boost { namespace application {
     * Internal and External locking Version that can be used as part of an
     * atomic transaction are available.
     *
+    * The aspects are striped by its dense aspect id, that is generated
+    * once for each aspect type. Each stripe has its own mutex, and keeps
+    * its aspects in an immutable snapshot (a flat table indexed by the
+    * aspect id) that is published through an atomic pointer.
+    *
+    * Modifications (insert, exchange, erase and reduce) lock only the
+    * stripe of the aspect, copy its snapshot, change the copy and publish
+    * it, so writers of aspects on different stripes run in parallel.
+    * The internal locking version of find and count never take a mutex,
+    * they just load the current snapshot, so readers are never blocked by
+    * a writer or by a thread that holds a strict_lock on the aspect_map.
+    *
+    * A strict_lock on the aspect_map (external locking) locks all stripes,
+    * in order, so a transaction is atomic against other writers and
+    * against find_all(strict_lock&), not against the lock-free readers:
+    * each change done inside of a transaction is published at once, and
+    * is visible to find, count and new read_guards before the
+    * transaction ends.
+    * The mutexes are not recursive: inside of a transaction, use the
+    * external locking versions (that take the guard).
+    *
+    * Old snapshots are deleted when no reader is using them (epoch based
+    * reclamation).
+    *
+    * An aspect_map constructed with an aspect_arena allocates its tables
+    * on the arena, and emplace builds the aspects (and its shared_ptr
+    * control blocks) there too, so a short lived aspect_map (e.g. a
+    * context per request) is torn down by its destruction and one reset
+    * of the arena.
+    *
+    * An aspect_map can be constructed as a child of a parent aspect_map
+    * (e.g. a context per request over the global_context). The lookups
+    * (find, find_ref, count and with) that don't find the aspect on the
+    * child fall through to the parent, without copy anything, while
+    * writes (insert, emplace, exchange, erase, reduce and clear) only
+    * change the child, so a child aspect shadows the one of parent, and
+    * erase on child only removes the aspect of child.
+    * size only counts the aspects of the child. The creation of a child
+    * does not allocate.
+    *
+    * Each aspect type has a version counter, that is bumped each time the
+    * aspect is changed (insert, emplace, exchange, reduce, erase or
+    * clear), after the change is visible to find. A hot loop can keep a
+    * reference to the counter and only find the aspect again when the
+    * version changes. Callbacks can be registered too (watch), they are
+    * called on each change, by the thread that made it.
+    *
     * <STRONG> Thread Safe: </STRONG> Yes <BR>
     * <STRONG> Exception Safe: </STRONG>  Yes
     *
     */
-   class aspect_map
-      : public basic_lockable_adapter<recursive_mutex> {
+   class aspect_map {
       typedef size_t size_type;
 
-      typedef csbl::type_index key_type;
+      typedef std::size_t key_type;
       typedef csbl::shared_ptr<void> value_type;
-      typedef csbl::unordered_map<key_type, value_type> map_type;
 
-      map_type aspects_;
+      // aspects indexed by its dense aspect id, allocated on the arena of
+      // aspect_map, if any. The arena is kept before the table, so the
+      // epoch domain can delete the tables of any aspect_map.
+      struct table_type {
+         typedef arena_allocator<value_type> allocator_type;
+
+         explicit table_type(aspect_arena* arena)
+            : slots(allocator_type(arena)), size(0) {}
+
+         std::vector<value_type, allocator_type> slots;
+         size_type size;
+
+         static void* operator new(std::size_t bytes, aspect_arena* arena) {
+            void* p = arena
+               ? arena->allocate(header() + bytes)
+               : ::operator new(header() + bytes);
+
+            *static_cast<aspect_arena**>(p) = arena;
+            return static_cast<char*>(p) + header();
+         }
+
+         static void operator delete(void* p, aspect_arena*) {
+            release(p);
+         }
+
+         static void operator delete(void* p) {
+            release(p);
+         }
+
+      private:
+         static std::size_t header() {
+            return detail::max_alignment;
+         }
+
+         static void release(void* p) {
+            if(!p)
+               return;
+
+            void* block = static_cast<char*>(p) - header();
+
+            if(!*static_cast<aspect_arena**>(block))
+               ::operator delete(block);
+         }
+      };
+
+      typedef csbl::function<void (const value_type&)> watch_handler;
+
+      struct watcher_type {
+         key_type id;
+         std::size_t handle;
+         watch_handler handler;
+      };
+
+      enum { version_block_size = 16 };
+
+      // version counters of slots, never moved or deleted while the
+      // aspect_map is alive
+      struct version_block {
+         version_block() : next(0) {
+            for(std::size_t i = 0; i < version_block_size; ++i)
+               counters[i].store(0, boost::memory_order_relaxed);
+         }
+
+         boost::atomic<std::size_t> counters[version_block_size];
+         version_block* next;
+      };
+
+      typedef table_type* snapshot_type;
+      typedef boost::movelib::unique_ptr<table_type> table_ptr;
+      typedef detail::epoch_domain<table_type> epoch_type;
+
+      static const std::size_t stripes = BOOST_APPLICATION_ASPECT_MAP_STRIPES;
+
+      // the aspects of ids s, s + stripes, s + 2 * stripes ..., the slot of
+      // id is id / stripes. table is the current published snapshot, an
+      // null pointer means no aspects. table is only changed with the
+      // mutex held, read inside of a epoch.
+      // The version counters (in blocks of slots) and the watchers of the
+      // stripe are created on demand, and only accessed with the mutex
+      // held.
+      // Each stripe is aligned to its own cache line(s), so the mutex and
+      // table of neighbouring stripes never share a line.
+      struct BOOST_ALIGNMENT(64) stripe_type {
+         stripe_type() : table(0), versions(0), watchers(0) {}
+
+         boost::mutex mutex;
+         boost::atomic<snapshot_type> table;
+
+         version_block* versions;
+         std::vector<watcher_type>* watchers;
+      };
+
+      BOOST_STATIC_ASSERT(sizeof(stripe_type) % 64 == 0);
+
+      stripe_type stripes_[stripes];
+      mutable epoch_type epoch_;
+
+      // the epoch domain needs serialized writers, only the retire of old
+      // snapshots is serialized between stripes
+      boost::mutex retire_mutex_;
+
+      detail::aspect_map_observer* observer_;
+
+      aspect_arena* arena_;
+
+      // the aspect_map that lookups fall through, parent_owner_ keeps it
+      // alive if it was given by a shared_ptr
+      aspect_map* parent_;
+      csbl::shared_ptr<aspect_map> parent_owner_;
+
+      boost::atomic<std::size_t> watches_;
       
       /// @cond
       template <class T>
       key_type aspec_id() {
-        return csbl::get_type_id<T>();
+        return detail::aspect_id<T>();
+      }
+
+      static std::size_t stripe_of(key_type id) {
+         return id % stripes;
+      }
+
+      static key_type slot_of(key_type id) {
+         return id / stripes;
+      }
+
+      boost::mutex& mutex_of(key_type id) {
+         return stripes_[stripe_of(id)].mutex;
+      }
+
+      // the caller must be inside of a epoch, or hold the stripe lock
+      snapshot_type snapshot(std::size_t stripe) const {
+         return stripes_[stripe].table.load(boost::memory_order_seq_cst);
+      }
+
+      // a private copy of the current snapshot of the stripe of id, to be
+      // changed by a writer, the stripe lock must be held.
+      table_ptr clone(key_type id) const {
+         snapshot_type current = snapshot(stripe_of(id));
+
+         if(current)
+            return table_ptr(new (arena_) table_type(*current));
+
+         return table_ptr(new (arena_) table_type(arena_));
+      }
+
+      // set (or reset, if value is empty) the slot of id on a private table
+      static void assign(table_type& table, key_type id, const value_type& value) {
+         key_type slot = slot_of(id);
+
+         if(table.slots.size() <= slot)
+            table.slots.resize(slot + 1);
+
+         if(table.slots[slot] && !value)
+            --table.size;
+         else if(!table.slots[slot] && value)
+            ++table.size;
+
+         table.slots[slot] = value;
+      }
+
+      // the stripe lock must be held
+      void publish(std::size_t stripe, table_ptr next) {
+         snapshot_type old = stripes_[stripe].table.exchange(
+            next.release(), boost::memory_order_seq_cst);
+
+         if(old) {
+            boost::lock_guard<boost::mutex> lock(retire_mutex_);
+            epoch_.retire(old);
+         }
+      }
+
+      // replace the aspect of id, the stripe lock must be held
+      void store(key_type id, const value_type& value) {
+         table_ptr next = clone(id);
+         assign(*next, id, value);
+         publish(stripe_of(id), boost::move(next));
+         notify(id, value);
+      }
+
+      // the stripe lock must be held, a null pointer if there is no
+      // counter for slot and create is false
+      static boost::atomic<std::size_t>* version_of(stripe_type& stripe,
+         key_type slot, bool create) {
+         version_block** block = &stripe.versions;
+
+         for(key_type first = 0; ; first += version_block_size) {
+            if(!*block) {
+               if(!create)
+                  return 0;
+
+               *block = new version_block();
+            }
+
+            if(slot < first + version_block_size)
+               return &(*block)->counters[slot - first];
+
+            block = &(*block)->next;
+         }
+      }
+
+      // the stripe lock must be held, called after the change is published
+      void notify(const key_type& id, const value_type& value) {
+         if(observer_)
+            observer_->changed(id, value);
+
+         stripe_type& stripe = stripes_[stripe_of(id)];
+
+         if(boost::atomic<std::size_t>* version = version_of(stripe, slot_of(id), false))
+            version->fetch_add(1, boost::memory_order_release);
+
+         if(!stripe.watchers)
+            return;
+
+         std::vector<watcher_type>& watchers = *stripe.watchers;
+
+         for(std::size_t i = 0; i < watchers.size(); ++i) {
+            if(watchers[i].id == id)
+               watchers[i].handler(value);
+         }
+      }
+
+      template <class T>
+      csbl::shared_ptr<T> lookup() {
+         key_type id = aspec_id<T>();
+         snapshot_type snap = snapshot(stripe_of(id));
+
+         if(!snap || snap->slots.size() <= slot_of(id))
+            return csbl::shared_ptr<T>();
+
+         return csbl::static_pointer_cast<T>(snap->slots[slot_of(id)]);
+      }
+
+      // the aspect of aspect_map, or of its parents
+      template <class T>
+      csbl::shared_ptr<T> lookup_through() {
+         csbl::shared_ptr<T> asp = lookup<T>();
+
+         if(asp || !parent_)
+            return asp;
+
+         return parent_->find<T>();
+      }
+
+      // the writers, the stripe of T must be locked
+
+      template <class T>
+      csbl::shared_ptr<T> insert_(const csbl::shared_ptr<T>& asp) {
+         csbl::shared_ptr<T> temp = lookup<T>();
+
+         if(temp)
+            return temp;
+
+         store(aspec_id<T>(), asp);
+         return csbl::shared_ptr<T>();
+      }
+
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_RVALUE_REFERENCES)
+      template <class T, class... Args>
+      csbl::shared_ptr<T> emplace_(Args&&... args) {
+         csbl::shared_ptr<T> temp = lookup<T>();
+
+         if(temp)
+            return temp;
+
+         temp = csbl::allocate_shared<T>(
+            arena_allocator<T>(arena_), std::forward<Args>(args)...);
+
+         store(aspec_id<T>(), temp);
+         return temp;
+      }
+#endif
+
+      template <class T>
+      csbl::shared_ptr<T> exchange_(const csbl::shared_ptr<T>& asp) {
+         store(aspec_id<T>(), asp);
+         return csbl::shared_ptr<T>();
+      }
+
+      template <class T>
+      csbl::shared_ptr<T> erase_() {
+         csbl::shared_ptr<T> temp = lookup<T>();
+
+         if(temp)
+            store(aspec_id<T>(), value_type());
+
+         return temp;
+      }
+
+      template<class T, class F>
+      csbl::shared_ptr<T> reduce_(const csbl::shared_ptr<T>& asp, F f) {
+         csbl::shared_ptr<T> tmp = lookup<T>();
+
+         if (tmp) {
+            store(aspec_id<T>(), f(tmp, asp));
+            return tmp;
+         }
+
+         store(aspec_id<T>(), asp);
+         return csbl::shared_ptr<T>();
       }
       /// @endcond
       
    public:
 
+      /*!
+       * \brief A cheap guard that gives borrowed access to the aspects.
+       *
+       * The guard pins the snapshots of the stripes that are current when it
+       * is created. While the guard is alive that snapshots, and each aspect
+       * on them, are not deleted, even if the aspect is exchanged or erased
+       * from the aspect_map, so find_ref can return a plain pointer, without
+       * touch the shared_ptr refcount.
+       *
+       * The guard don't take any lock, and don't block writers, it only
+       * delays the reclamation of old snapshots, so it should be kept
+       * only for the duration of a hot path (e.g. a loop iteration).
+       *
+       * Changes done after the guard is created are not visible through it.
+       *
+       * The snapshots of the parents are pinned too, on an array inside of
+       * the guard, so the creation of a guard don't allocate unless the
+       * chain of parents is deeper than
+       * BOOST_APPLICATION_READ_GUARD_DEPTH.
+       *
+       */
+      class read_guard : noncopyable {
+      public:
+         explicit read_guard(const aspect_map& map)
+            : map_(map), depth_(0) {
+            const aspect_map* m = &map;
+
+            for(; m && depth_ < max_depth; m = m->parent_) {
+               level& l = levels_[depth_];
+
+               l.map = m;
+               l.token = m->epoch_.enter();
+
+               for(std::size_t i = 0; i < stripes; ++i)
+                  l.snapshots[i] = m->snapshot(i);
+
+               ++depth_;
+            }
+
+            // a chain deeper than the inline levels
+            if(m)
+               overflow_.reset(new read_guard(*m));
+         }
+
+         ~read_guard() {
+            for(std::size_t i = depth_; i-- > 0; )
+               levels_[i].map->epoch_.leave(levels_[i].token);
+         }
+
+      private:
+         friend class aspect_map;
+
+         static const std::size_t max_depth =
+            BOOST_APPLICATION_READ_GUARD_DEPTH;
+
+         // the snapshots pinned on an aspect_map of the chain
+         struct level {
+            const aspect_map* map;
+            epoch_type::token token;
+            snapshot_type snapshots[stripes];
+         };
+
+         const aspect_map& map_;
+         level levels_[max_depth];
+         std::size_t depth_;
+         boost::movelib::unique_ptr<read_guard> overflow_;
+      };
+
+      aspect_map()
+         : observer_(0), arena_(0), parent_(0), watches_(0) {}
+
+      /*!
+       * Constructs an aspect_map that keeps its tables, and the aspects
+       * built by emplace, on arena.
+       *
+       * The arena must outlive the aspect_map, and every shared_ptr of the
+       * aspects built by emplace.
+       */
+      explicit aspect_map(aspect_arena& arena)
+         : observer_(0), arena_(&arena), parent_(0), watches_(0) {}
+
+      /*!
+       * Constructs a child of parent, the lookups that don't find a aspect
+       * on the child fall through to parent.
+       *
+       * The parent must outlive the child.
+       */
+      explicit aspect_map(aspect_map* parent)
+         : observer_(0), arena_(0), parent_(parent), watches_(0) {}
+
+      aspect_map(aspect_map* parent, aspect_arena& arena)
+         : observer_(0), arena_(&arena), parent_(parent), watches_(0) {}
+
+      /*!
+       * Constructs a child of parent, the lookups that don't find a aspect
+       * on the child fall through to parent.
+       *
+       * The child keeps the parent alive (e.g. the global_context, even
+       * after global_context::destroy()).
+       */
+      explicit aspect_map(const csbl::shared_ptr<aspect_map>& parent)
+         : observer_(0), arena_(0)
+         , parent_(parent.get()), parent_owner_(parent), watches_(0) {}
+
+      aspect_map(const csbl::shared_ptr<aspect_map>& parent, aspect_arena& arena)
+         : observer_(0), arena_(&arena)
+         , parent_(parent.get()), parent_owner_(parent), watches_(0) {}
+
+      ~aspect_map() {
+         for(std::size_t i = 0; i < stripes; ++i) {
+            delete stripes_[i].table.load(boost::memory_order_relaxed);
+
+            while(version_block* block = stripes_[i].versions) {
+               stripes_[i].versions = block->next;
+               delete block;
+            }
+
+            delete stripes_[i].watchers;
+         }
+      }
+
+      /// The type of version counters of aspects.
+      typedef std::size_t version_type;
+
+      /// Identifies a callback registered by watch.
+      typedef std::size_t watch_handle;
+
+      /*!
+       * The aspect_map that lookups fall through, or 0 if there is none.
+       */
+      aspect_map* parent() const {
+         return parent_;
+      }
+
+      /*!
+       * Locks all stripes of the aspect_map, used by
+       * strict_lock<aspect_map>. Not recursive.
+       */
+      void lock() {
+         for(std::size_t i = 0; i < stripes; ++i)
+            stripes_[i].mutex.lock();
+      }
+
+      void unlock() {
+         for(std::size_t i = stripes; i > 0; --i)
+            stripes_[i - 1].mutex.unlock();
+      }
+
+      bool try_lock() {
+         for(std::size_t i = 0; i < stripes; ++i) {
+            if(!stripes_[i].mutex.try_lock()) {
+               for(; i > 0; --i)
+                  stripes_[i - 1].mutex.unlock();
+
+               return false;
+            }
+         }
+
+         return true;
+      }
+
       /*!
        * Lookup a aspect and return the shared_ptr<T> of it.
        * Internal locking Version.
        *
+       * This version don't take the aspect_map lock, it reads the last
+       * published snapshot, and so never blocks.
+       *
+       * If the aspect is not on aspect_map, it is looked up on the parent.
+       *
        * \b Effects: If the the aspect associated to the type T exists,
        *             returns an shared_ptr<T> of it; otherwise a disengaged
        *             object.
@@ -79,14 +684,18 @@ namespace boost { namespace application {
        */
       template <class T>
       csbl::shared_ptr<T> find() {
-         strict_lock<aspect_map> guard(*this);
-         return find<T>(guard);
+         epoch_type::reader reader(epoch_);
+         return lookup_through<T>();
       }
 
       /*!
        * Lookup a aspect and return the shared_ptr<T> of it.
        * External locking Version, can be used as part of an atomic transaction.
        *
+       * If the aspect is not on aspect_map, it is looked up on the parent,
+       * with the internal locking version (the guard don't lock the
+       * parent).
+       *
        * \b Effects: If the the aspect associated to the type T exists,
        *             returns an shared_ptr<T> of it; otherwise a disengaged
        *             object.
@@ -99,12 +708,124 @@ namespace boost { namespace application {
       template <class T>
       csbl::shared_ptr<T> find(strict_lock<aspect_map>& guard) {
          ensure_correct_lock(guard);
-         map_type::const_iterator it = aspects_.find( aspec_id<T>() );
+         return lookup_through<T>();
+      }
 
-         if (aspects_.cend() == it)
-            return csbl::shared_ptr<T>();
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_HDR_TUPLE)
+      /*!
+       * Lookup several aspects at once, and return a tuple with the
+       * shared_ptr of each one.
+       * Internal locking Version.
+       *
+       * All lookups are done inside of one epoch, without take any mutex,
+       * so the cost of entering the snapshot is paid once, not once per
+       * aspect. Each aspect is the last published one when it is read; use
+       * the external locking version to get all aspects atomically with
+       * respect to writers.
+       *
+       * \b Examples:
+       * \code
+       * csbl::shared_ptr<status> st;
+       * csbl::shared_ptr<run_mode> mode;
+       *
+       * std::tie(st, mode) = context.find_all<status, run_mode>();
+       * \endcode
+       *
+       * \return A tuple with a <tt> shared_ptr </tt> of each aspect, in the
+       *         order of the template parameters, with a disengaged
+       *         <tt> shared_ptr </tt> for the aspects that don't exist.
+       * \throw Nothing.
+       */
+      template <class... Aspects>
+      std::tuple< csbl::shared_ptr<Aspects>... > find_all() {
+         epoch_type::reader reader(epoch_);
+         return std::tuple< csbl::shared_ptr<Aspects>... >(
+            lookup_through<Aspects>()...);
+      }
+
+      /*!
+       * Lookup several aspects at once, and return a tuple with the
+       * shared_ptr of each one.
+       * External locking Version, can be used as part of an atomic transaction.
+       *
+       * The guard is checked once, and all aspects are read while all
+       * stripes are locked, so they are consistent with each other.
+       *
+       * \return A tuple with a <tt> shared_ptr </tt> of each aspect, in the
+       *         order of the template parameters, with a disengaged
+       *         <tt> shared_ptr </tt> for the aspects that don't exist.
+       * \throw std::logic_error if guard hold Wrong Object;
+       *        Does not owns correct lock.
+       */
+      template <class... Aspects>
+      std::tuple< csbl::shared_ptr<Aspects>... >
+      find_all(strict_lock<aspect_map>& guard) {
+         ensure_correct_lock(guard);
+         return std::tuple< csbl::shared_ptr<Aspects>... >(
+            lookup_through<Aspects>()...);
+      }
+
+      /*!
+       * Lookup several aspects at once, and return a tuple with a plain
+       * pointer to each one, borrowed from the snapshots pinned by guard
+       * (see find_ref).
+       *
+       * \return A tuple with a pointer to each aspect, in the order of the
+       *         template parameters, that are valid while the guard is
+       *         alive, or 0 for the aspects that don't exist.
+       * \throw std::logic_error if guard belongs to another aspect_map.
+       */
+      template <class... Aspects>
+      std::tuple< Aspects*... > find_all(const read_guard& guard) {
+         if(&guard.map_ != this)
+            throw std::logic_error("Locking Error: Wrong Object Guarded");
+
+         return std::tuple< Aspects*... >(borrow_through<Aspects>(guard)...);
+      }
+#endif
+
+      /*!
+       * Lookup a aspect and return a plain pointer to it, borrowed from the
+       * snapshot pinned by guard.
+       *
+       * \b Effects: If the the aspect associated to the type T exists on
+       *             the snapshot of guard (or on the snapshots of the
+       *             parents), returns a pointer to it; otherwise a null
+       *             pointer.
+       *
+       * \return A pointer to the aspect, that is valid while the guard is
+       *         alive, or 0 if aspect don't exists.
+       * \throw std::logic_error if guard belongs to another aspect_map.
+       */
+      template <class T>
+      T* find_ref(const read_guard& guard) {
+         if(&guard.map_ != this)
+            throw std::logic_error("Locking Error: Wrong Object Guarded");
 
-         return csbl::static_pointer_cast<T>(it->second);
+         return borrow_through<T>(guard);
+      }
+
+      /*!
+       * Call f with a reference to the aspect, without touch the
+       * shared_ptr refcount.
+       *
+       * \b Effects: If the the aspect associated to the type T exists,
+       *             calls f(T&) while a read_guard is held; otherwise
+       *             f is not called.
+       *
+       * \return true if f was called, false if aspect don't exists.
+       * \throw Any exception throw by f.
+       */
+      template <class T, class F>
+      bool with(F f) {
+         read_guard guard(*this);
+         T* asp = find_ref<T>(guard);
+
+         if(!asp)
+            return false;
+
+         f(*asp);
+         return true;
       }
 
       /*!
@@ -123,8 +844,10 @@ namespace boost { namespace application {
        */
       template <class T>
       size_type count() {
-         strict_lock<aspect_map> guard(*this);
-         return count<T>(guard);
+         if(find<T>())
+            return 1;
+
+         return 0;
       }
 
       /*!
@@ -169,8 +892,8 @@ namespace boost { namespace application {
        */
       template <class T>
       csbl::shared_ptr<T> insert(csbl::shared_ptr<T> asp) {
-         strict_lock<aspect_map> guard(*this);
-         return insert<T>(asp, guard);
+         boost::lock_guard<boost::mutex> lock(mutex_of(aspec_id<T>()));
+         return insert_<T>(asp);
       }
 
       /*!
@@ -195,16 +918,61 @@ namespace boost { namespace application {
       csbl::shared_ptr<T> insert(csbl::shared_ptr<T> asp,
          strict_lock<aspect_map>& guard) {
          ensure_correct_lock(guard);
-         key_type ti = aspec_id<T>();
-
-         csbl::shared_ptr<T> temp = find<T>(guard);
+         return insert_<T>(asp);
+      }
 
-         if(temp)
-            return temp;
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_RVALUE_REFERENCES)
+      /*!
+       * Builds a aspect in place, if its aspect id (key_type(T)) is not
+       * already present.
+       * Internal locking Version.
+       *
+       * The aspect and its shared_ptr control block are allocated together,
+       * on the arena of the aspect_map if it has one (see aspect_arena),
+       * otherwise on the heap (as make_shared does).
+       *
+       * \b Effects: Constructs T from args and insert it, if id
+       *             (key_type(T)) key is not present.
+       *
+       * \post <tt> get_aspect<T>.get() != nullptr </tt>
+       *
+       * \param args The arguments of the constructor of T.
+       * \return An <tt> shared_ptr </tt> of the aspect of the type T that
+       *         is on the aspect_map, the new one or the one that was
+       *         already present (then args are not used).
+       * \throw Any exception throw by the constructor of T or due to
+       *        resources unavailable.
+       */
+      template <class T, class... Args>
+      csbl::shared_ptr<T> emplace(Args&&... args) {
+         boost::lock_guard<boost::mutex> lock(mutex_of(aspec_id<T>()));
+         return emplace_<T>(std::forward<Args>(args)...);
+      }
 
-         aspects_.insert(std::make_pair(ti, asp));
-         return csbl::shared_ptr<T>();
+      /*!
+       * Builds a aspect in place, if its aspect id (key_type(T)) is not
+       * already present.
+       * External locking Version, can be used as part of an atomic transaction.
+       *
+       * \b Effects: Constructs T from args and insert it, if id
+       *             (key_type(T)) key is not present.
+       *
+       * \post <tt> get_aspect<T>.get() != nullptr </tt>
+       *
+       * \param args The arguments of the constructor of T.
+       * \return An <tt> shared_ptr </tt> of the aspect of the type T that
+       *         is on the aspect_map, the new one or the one that was
+       *         already present (then args are not used).
+       * \throw std::logic_error if guard hold Wrong Object;
+       *        Does not owns correct lock, or any exception throw by the
+       *        constructor of T or due to resources unavailable.
+       */
+      template <class T, class... Args>
+      csbl::shared_ptr<T> emplace(strict_lock<aspect_map>& guard, Args&&... args) {
+         ensure_correct_lock(guard);
+         return emplace_<T>(std::forward<Args>(args)...);
       }
+#endif
 
       /*!
        * Exchange a stored aspect to another one.
@@ -225,8 +993,8 @@ namespace boost { namespace application {
        */
       template <class T>
       csbl::shared_ptr<T> exchange(csbl::shared_ptr<T> asp) {
-         strict_lock<aspect_map> guard(*this);
-         return exchange(asp, guard);
+         boost::lock_guard<boost::mutex> lock(mutex_of(aspec_id<T>()));
+         return exchange_<T>(asp);
       }
 
       /*!
@@ -251,15 +1019,7 @@ namespace boost { namespace application {
       csbl::shared_ptr<T> exchange(csbl::shared_ptr<T> asp,
          strict_lock<aspect_map>& guard) {
          ensure_correct_lock(guard);
-         key_type ti = aspec_id<T>();
-
-         csbl::shared_ptr<T> temp = find<T>(guard);
-
-         if(temp)
-            aspects_.erase(ti);
-
-         aspects_.insert(std::make_pair(ti, asp));
-         return csbl::shared_ptr<T>();
+         return exchange_<T>(asp);
       }
 
       /*!
@@ -276,8 +1036,8 @@ namespace boost { namespace application {
        */
       template <class T>
       csbl::shared_ptr<T> erase() {
-         strict_lock<aspect_map> guard(*this);
-         return erase<T>(guard);
+         boost::lock_guard<boost::mutex> lock(mutex_of(aspec_id<T>()));
+         return erase_<T>();
       }
 
       /*!
@@ -296,17 +1056,7 @@ namespace boost { namespace application {
       template <class T>
       csbl::shared_ptr<T> erase(strict_lock<aspect_map>& guard) {
          ensure_correct_lock(guard);
-
-         key_type ti = aspec_id<T>();
-
-         csbl::shared_ptr<T> temp = find<T>(guard);
-
-         if(temp) {
-            aspects_.erase(ti);
-            return temp;
-         }
-
-         return csbl::shared_ptr<T>();
+         return erase_<T>();
       }
 
       /*!
@@ -331,8 +1081,8 @@ namespace boost { namespace application {
        */
       template<class T, class F>
       shared_ptr<T> reduce(shared_ptr<T> asp, F f) {
-         strict_lock<aspect_map> guard(*this);
-         return reduce<T, F>(asp, f, guard);
+         boost::lock_guard<boost::mutex> lock(mutex_of(aspec_id<T>()));
+         return reduce_<T, F>(asp, f);
       }
 
       /*!
@@ -359,24 +1109,131 @@ namespace boost { namespace application {
       template<class T, class F>
       shared_ptr<T> reduce(shared_ptr<T> asp, F f, strict_lock<aspect_map>& guard) {
          ensure_correct_lock(guard);
-         key_type ti = aspec_id<T>();
+         return reduce_<T, F>(asp, f);
+      }
 
-         csbl::shared_ptr<T> tmp = find<T>(guard);
+      /*!
+       * The version counter of the aspect of type T, it is bumped
+       * (with release semantics) after each change of the aspect is
+       * visible to find. The changes of the aspect on parents are not
+       * counted.
+       *
+       * The counter is created on the first call, and the returned
+       * reference is valid while the aspect_map is alive, so a hot loop
+       * can keep it and only check it (one atomic load) to know if the
+       * aspect must be found again.
+       *
+       * Takes the lock of the stripe of T, so it can't be called inside
+       * of a transaction (strict_lock) or a watch callback.
+       *
+       * \b Examples:
+       * \code
+       * const boost::atomic<aspect_map::version_type>& version =
+       *    context.version_counter<my_config>();
+       *
+       * aspect_map::version_type seen = version.load();
+       * csbl::shared_ptr<my_config> config = context.find<my_config>();
+       *
+       * for(;;) {
+       *    if(version.load(boost::memory_order_acquire) != seen) {
+       *       seen = version.load(boost::memory_order_acquire);
+       *       config = context.find<my_config>();
+       *    }
+       *
+       *    // use config
+       * }
+       * \endcode
+       *
+       * \return A reference to the version counter of T.
+       * \throw Any exception throw due to resources unavailable.
+       */
+      template <class T>
+      const boost::atomic<version_type>& version_counter() {
+         key_type id = aspec_id<T>();
+         boost::lock_guard<boost::mutex> lock(mutex_of(id));
 
-         if (tmp) {
-            csbl::shared_ptr<T> red = f(tmp, asp) ;
-            aspects_.erase(ti);
-            aspects_.insert(std::make_pair(ti, red));
+         return *version_of(stripes_[stripe_of(id)], slot_of(id), true);
+      }
 
-            return tmp;
+      /*!
+       * The current version of the aspect of type T (see version_counter).
+       *
+       * \return The number of changes of the aspect since its counter
+       *         was created.
+       * \throw Any exception throw due to resources unavailable.
+       */
+      template <class T>
+      version_type version() {
+         return version_counter<T>().load(boost::memory_order_acquire);
+      }
+
+      /*!
+       * Registers a callback that is called with the new aspect (or a
+       * disengaged shared_ptr, when it is erased) each time the aspect of
+       * type T is changed on this aspect_map.
+       *
+       * The callback is called by the thread that made the change, after
+       * the change is visible to find, with the stripe of T locked, so the
+       * calls for a given aspect are serialized. The callback can use the
+       * internal locking find, but can't change the aspect_map or call
+       * watch, unwatch or version_counter. Exceptions thrown by the
+       * callback are propagated to the writer, the change is already
+       * done at that point.
+       *
+       * \param f A callable as void (const csbl::shared_ptr<T>&).
+       * \return A handle that can be passed to unwatch.
+       * \throw Any exception throw due to resources unavailable.
+       */
+      template <class T, class F>
+      watch_handle watch(F f) {
+         key_type id = aspec_id<T>();
+
+         watcher_type watcher;
+         watcher.id = id;
+         watcher.handle = ++watches_;
+         watcher.handler = detail::watch_caller<T, F>(f);
+
+         boost::lock_guard<boost::mutex> lock(mutex_of(id));
+         stripe_type& stripe = stripes_[stripe_of(id)];
+
+         if(!stripe.watchers)
+            stripe.watchers = new std::vector<watcher_type>();
+
+         stripe.watchers->push_back(watcher);
+
+         return watcher.handle;
+      }
+
+      /*!
+       * Removes a callback registered by watch. When it returns, the
+       * callback is not running and will not be called again.
+       *
+       * \return true if the callback was found.
+       * \throw Nothing.
+       */
+      bool unwatch(watch_handle handle) {
+         for(std::size_t s = 0; s < stripes; ++s) {
+            boost::lock_guard<boost::mutex> lock(stripes_[s].mutex);
+
+            if(!stripes_[s].watchers)
+               continue;
+
+            std::vector<watcher_type>& watchers = *stripes_[s].watchers;
+
+            for(std::size_t i = 0; i < watchers.size(); ++i) {
+               if(watchers[i].handle == handle) {
+                  watchers.erase(watchers.begin() + i);
+                  return true;
+               }
+            }
          }
 
-         aspects_.insert(std::make_pair(ti, asp));
-         return csbl::shared_ptr<T>();
+         return false;
       }
 
       /*!
-       * Estimate of the number of aspects in the container.
+       * Estimate of the number of aspects in the container, the aspects
+       * of parent are not counted.
        *
        * \b Effects: This function does not modify the container in any way.
        *
@@ -386,7 +1243,17 @@ namespace boost { namespace application {
        * \throw Nothing.
        */
       size_type size() const {
-         return aspects_.size();
+         epoch_type::reader reader(epoch_);
+         size_type count = 0;
+
+         for(std::size_t i = 0; i < stripes; ++i) {
+            snapshot_type snap = snapshot(i);
+
+            if(snap)
+               count += snap->size;
+         }
+
+         return count;
       }
 
       /*!
@@ -413,7 +1280,36 @@ namespace boost { namespace application {
        */
       void clear() {
          strict_lock<aspect_map> guard(*this);
-         aspects_.clear();
+
+         for(std::size_t s = 0; s < stripes; ++s) {
+            snapshot_type old = snapshot(s);
+
+            if(!old)
+               continue;
+
+            std::vector<key_type> erased;
+            for(key_type slot = 0; slot < old->slots.size(); ++slot) {
+               if(old->slots[slot])
+                  erased.push_back(slot * stripes + s);
+            }
+
+            publish(s, table_ptr());
+
+            for(std::size_t i = 0; i < erased.size(); ++i)
+               notify(erased[i], value_type());
+         }
+      }
+
+   protected:
+
+      /*!
+       * Set the observer that will be notified about changes
+       * on the aspect_map, or 0 to remove it.
+       *
+       */
+      void observe(detail::aspect_map_observer* observer) {
+         strict_lock<aspect_map> guard(*this);
+         observer_ = observer;
       }
 
    private:
@@ -423,6 +1319,31 @@ namespace boost { namespace application {
          if (!guard.owns_lock(this))
             throw std::logic_error("Locking Error: Wrong Object Locked");
       }
+
+      // the aspect on the snapshots pinned by a level of a guard
+      template <class T>
+      static T* borrow(const snapshot_type* snapshots) {
+         key_type id = detail::aspect_id<T>();
+         snapshot_type snap = snapshots[stripe_of(id)];
+
+         if(!snap || snap->slots.size() <= slot_of(id))
+            return 0;
+
+         return static_cast<T*>(snap->slots[slot_of(id)].get());
+      }
+
+      // the aspect on snapshots of guard, or of its parents
+      template <class T>
+      static T* borrow_through(const read_guard& guard) {
+         for(const read_guard* g = &guard; g; g = g->overflow_.get()) {
+            for(std::size_t i = 0; i < g->depth_; ++i) {
+               if(T* asp = borrow<T>(g->levels_[i].snapshots))
+                  return asp;
+            }
+         }
+
+         return 0;
+      }
       /// @endcond
       
    }; // aspect_map
@@ -0,0 +1,404 @@
+// drain_controller.hpp ------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 01-06-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_DRAIN_CONTROLLER_ASPECT_HPP
+#define BOOST_APPLICATION_DRAIN_CONTROLLER_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/detail/csbl.hpp>
+
+#if defined( BOOST_WINDOWS_API )
+#include <boost/application/detail/windows/cpu_affinity_impl.hpp>
+#elif defined( BOOST_POSIX_API )
+#include <boost/application/detail/posix/cpu_affinity_impl.hpp>
+#else
+#error "Sorry, no boost application are available for this platform."
+#endif
+
+#include <boost/bind.hpp>
+#include <boost/align/aligned_allocator.hpp>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <vector>
+
+namespace boost { namespace application {
+
+   /*!
+    * \brief An aspect that counts the requests in flight, so on
+    *        termination the application stops only when they are done
+    *        (or a deadline expires).
+    *
+    * The count is sharded by cpu, each request counts on the shard of
+    * the cpu that entered it, so there is no single atomic shared by all
+    * threads.
+    *
+    * When the signal_manager receives a termination signal and this
+    * aspect is on context, it starts draining: new requests are refused,
+    * and the wait_for_termination_request is released when the requests
+    * in flight are done, or the deadline expires. A second termination
+    * signal during the drain ends it at once, the requests still in
+    * flight are abandoned.
+    *
+    * \b Examples:
+    * \code
+    * // on each request:
+    * application::drain_controller::request request(*drain);
+    *
+    * if(!request)
+    *    return reply_unavailable(); // draining
+    *
+    * // handle request ...
+    * \endcode
+    */
+   class drain_controller : noncopyable
+   {
+   public:
+
+      typedef std::size_t ticket;
+      typedef csbl::function< void (void) > drained_handler;
+
+      /*!
+       * \brief RAII request, entered on construction, and left on
+       *        destruction if it was accepted.
+       */
+      class request : noncopyable
+      {
+      public:
+
+         explicit request(drain_controller &drain)
+            : drain_(drain)
+            , ticket_(0)
+            , accepted_(drain.try_enter(ticket_))
+         {}
+
+         ~request()
+         {
+            if(accepted_)
+               drain_.leave(ticket_);
+         }
+
+         bool accepted() const
+         {
+            return accepted_;
+         }
+
+         operator bool() const
+         {
+            return accepted_;
+         }
+
+      private:
+
+         drain_controller &drain_;
+         ticket ticket_;
+         bool accepted_;
+      };
+
+      /*!
+       * Constructs a drain_controller.
+       *
+       * \param deadline The maximum time of drain.
+       *
+       * \param shards The number of counters, 0 is one for each core
+       *        (hardware_concurrency).
+       */
+      explicit drain_controller(
+         boost::chrono::milliseconds deadline = boost::chrono::seconds(30),
+         std::size_t shards = 0)
+         : deadline_(deadline)
+         , draining_(false)
+         , drained_(false)
+         , forced_(false)
+         , timed_out_(false)
+         , left_(0)
+         , duration_(0)
+      {
+         if(!shards)
+            shards = csbl::thread::hardware_concurrency();
+
+         if(!shards)
+            shards = 1;
+
+         shards_ = shard_vector(shards);
+      }
+
+      virtual ~drain_controller()
+      {
+         if(thread_ && thread_->joinable())
+            thread_->join();
+      }
+
+      /*!
+       * Enters a request.
+       *
+       * \param t Receives the ticket to be passed to leave().
+       *
+       * \return false if the controller is draining, the request is
+       *         refused (and need not leave).
+       */
+      bool try_enter(ticket &t)
+      {
+         t = current_shard();
+
+         // counted before the draining check, see begin()
+         shards_[t].count.fetch_add(1);
+
+         if(draining_.load()) {
+            leave(t);
+            return false;
+         }
+
+         return true;
+      }
+
+      /*!
+       * Leaves a request entered by try_enter().
+       */
+      void leave(ticket t)
+      {
+         shards_[t].count.fetch_sub(1);
+
+         if(draining_.load()) {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            cond_.notify_all();
+         }
+      }
+
+      /*!
+       * The requests in flight. Exact when draining, an approximation
+       * otherwise.
+       */
+      std::size_t in_flight() const
+      {
+         long count = 0;
+
+         for(std::size_t i = 0; i < shards_.size(); ++i)
+            count += shards_[i].count.load();
+
+         return count > 0 ? (std::size_t) count : 0;
+      }
+
+      bool draining() const
+      {
+         return draining_.load();
+      }
+
+      void deadline(boost::chrono::milliseconds deadline)
+      {
+         deadline_ = deadline;
+      }
+
+      boost::chrono::milliseconds deadline() const
+      {
+         return deadline_;
+      }
+
+      /*!
+       * Refuses new requests, and waits the requests in flight, or the
+       * deadline.
+       *
+       * \return true if all requests are done, false if the deadline
+       *         expired.
+       */
+      bool drain()
+      {
+         begin();
+         return wait(clock_type::now());
+      }
+
+      /*!
+       * Drains on a thread of the controller, and calls handler when
+       * done. Used by signal_manager, so the signal thread is not
+       * blocked. The new requests are refused when it returns. Only the
+       * first call drains.
+       *
+       * \return false if a drain was already started by a previous call.
+       */
+      bool async_drain(const drained_handler &handler)
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         if(thread_)
+            return false;
+
+         begin();
+
+         thread_.reset(new csbl::thread(
+            boost::bind(&drain_controller::wait_and_call, this,
+               clock_type::now(), handler)));
+
+         return true;
+      }
+
+      /*!
+       * Ends the drain at once, without waiting the requests in flight
+       * or the deadline, they are reported by abandoned(). Used by
+       * signal_manager on a second termination signal.
+       */
+      void force()
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         forced_.store(true);
+         cond_.notify_all();
+      }
+
+      /*!
+       * True when the drain was ended by force().
+       */
+      bool forced() const
+      {
+         return forced_.load();
+      }
+
+      /*!
+       * True when a drain is finished.
+       */
+      bool drained() const
+      {
+         return drained_.load();
+      }
+
+      /*!
+       * The requests abandoned when the deadline expired.
+       *
+       * The results of a drain (abandoned, timed_out and drain_duration)
+       * can be read by any thread, they are consistent once drained()
+       * returns true.
+       */
+      std::size_t abandoned() const
+      {
+         return left_.load();
+      }
+
+      bool timed_out() const
+      {
+         return timed_out_.load();
+      }
+
+      /*!
+       * The time spent by the last drain, from the termination request
+       * until the requests in flight were done (or the deadline).
+       */
+      boost::chrono::milliseconds drain_duration() const
+      {
+         return boost::chrono::milliseconds(duration_.load());
+      }
+
+   protected:
+
+      typedef boost::chrono::steady_clock clock_type;
+
+      // the counters on different cache lines, each shard is aligned to
+      // its own line, and the vector allocates them aligned
+      struct BOOST_ALIGNMENT(64) shard {
+         shard() : count(0) {}
+         shard(const shard&) : count(0) {}
+
+         shard& operator=(const shard&) { return *this; }
+
+         boost::atomic<long> count;
+      };
+
+      BOOST_STATIC_ASSERT(sizeof(shard) % 64 == 0);
+
+      typedef std::vector<shard,
+         boost::alignment::aligned_allocator<shard, 64> > shard_vector;
+
+      ticket current_shard() const
+      {
+         int cpu = detail::current_cpu();
+
+         if(cpu < 0)
+            return boost::hash<boost::thread::id>()(
+               boost::this_thread::get_id()) % shards_.size();
+
+         return (std::size_t) cpu % shards_.size();
+      }
+
+      void begin()
+      {
+         // pairs with the increment and check of try_enter(), a request
+         // either see draining or is counted by in_flight()
+         draining_.store(true);
+      }
+
+      // waits the requests in flight, or the deadline
+      bool wait(clock_type::time_point start)
+      {
+         clock_type::time_point until = start + deadline_;
+         std::size_t count;
+
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+
+            while((count = in_flight()) != 0 && !forced_.load()) {
+               if(cond_.wait_until(lock, until) == boost::cv_status::timeout) {
+                  count = in_flight();
+                  break;
+               }
+            }
+         }
+
+         // written by the drain thread while others can read them, they
+         // are published by drained_
+         duration_.store(boost::chrono::duration_cast<boost::chrono::milliseconds>(
+            clock_type::now() - start).count());
+
+         left_.store(count);
+         timed_out_.store(count != 0 && !forced_.load());
+
+         drained_.store(true);
+         return count == 0;
+      }
+
+      void wait_and_call(clock_type::time_point start, drained_handler handler)
+      {
+         wait(start);
+
+         if(handler)
+            handler();
+      }
+
+   private:
+
+      shard_vector shards_;
+      boost::chrono::milliseconds deadline_;
+
+      boost::atomic<bool> draining_;
+      boost::atomic<bool> drained_;
+      boost::atomic<bool> forced_;
+
+      boost::atomic<bool> timed_out_;
+      boost::atomic<std::size_t> left_;
+      boost::atomic<boost::chrono::milliseconds::rep> duration_;
+
+      boost::mutex mutex_;
+      boost::condition_variable cond_;
+
+      csbl::shared_ptr<csbl::thread> thread_;
+
+   }; // drain_controller
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_DRAIN_CONTROLLER_ASPECT_HPP
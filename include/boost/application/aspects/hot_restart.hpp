@@ -0,0 +1,664 @@
+// hot_restart.hpp -----------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 28-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_HOT_RESTART_ASPECT_HPP
+#define BOOST_APPLICATION_HOT_RESTART_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/detail/csbl.hpp>
+#include <boost/application/detail/posix/fd_passing_impl.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdlib>
+#include <cstring>
+
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+namespace boost { namespace application {
+
+   namespace posix {
+
+      /*!
+       * \brief POSIX platform specific aspect that restart the application
+       *        without close its listening sockets (hot restart).
+       *
+       * On the running instance, restart() execs the new binary, passes the
+       * listening sockets (SCM_RIGHTS) and a state blob to it over an unix
+       * socket, and waits until the new instance calls ready(). Then
+       * the running instance drains and exits. If the new instance fails,
+       * it is killed and the running instance goes on.
+       *
+       * The new instance reports its pid before ready() (and when it
+       * daemonizes, from the daemon process), so the running instance
+       * kills the process that holds the sockets, not the one it forked.
+       *
+       * On the new instance, the hot_restart aspect receives the sockets
+       * and the state when is created, before launch.
+       *
+       * The signal_manager binds trigger_signal() (SIGUSR2 by default) to
+       * async_restart(), handing over the limit_single_instance lock, and
+       * if the new instance is ready, calls the drain handler and
+       * terminates the application. The handover runs on a thread of the
+       * aspect, so the signal thread goes on servicing the signals. When
+       * the new instance fails the failure handler is called, and if the
+       * lock can't be taken back and there is no failure handler, the
+       * application is terminated.
+       *
+       * \b Examples:
+       * \code
+       * csbl::shared_ptr<application::hot_restart> restart =
+       *    boost::make_shared<application::hot_restart>();
+       *
+       * if(restart->inherited()) // started by a hot restart
+       *    listen_fds = restart->fds();
+       * else
+       *    listen_fds = bind_and_listen();
+       *
+       * restart->handover_fds(listen_fds);
+       * restart->drain_handler(boost::bind(&myapp::stop_accepting, &app));
+       * context.insert<application::hot_restart>(restart);
+       *
+       * // on application, when is serving
+       * context.find<application::hot_restart>()->ready();
+       * \endcode
+       */
+      class hot_restart : noncopyable
+      {
+      public:
+
+         typedef csbl::function< std::string (void) > state_handler_type;
+         typedef csbl::function< void (void) > drain_handler_type;
+         typedef csbl::function<
+            void (const boost::system::error_code&) > failure_handler_type;
+         typedef csbl::function<
+            void (pid_t, const boost::system::error_code&) > restarted_handler;
+
+         /*!
+          * Constructs a hot_restart, if the application was started by
+          * a hot restart, receives the sockets and the state.
+          *
+          * \throw boost::system::system_error if the handover fails.
+          */
+         hot_restart()
+         {
+            boost::system::error_code ec;
+
+            setup(ec);
+
+            if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "hot_restart() failed", ec);
+         }
+
+         hot_restart(boost::system::error_code &ec)
+         {
+            setup(ec);
+         }
+
+         ~hot_restart()
+         {
+            join();
+
+            // destroyed by the handler of async_restart()
+            if(thread_ && thread_->joinable())
+               thread_->detach();
+
+            if(channel_ != -1)
+               ::close(channel_);
+         }
+
+         // new instance
+
+         /*!
+          * Indicate that the application was started by a hot restart.
+          */
+         bool inherited() const
+         {
+            return inherited_;
+         }
+
+         /*!
+          * The sockets received from the previous instance, they are
+          * close-on-exec.
+          */
+         const std::vector<int>& fds() const
+         {
+            return fds_;
+         }
+
+         /*!
+          * The state blob received from the previous instance.
+          */
+         const std::string& state() const
+         {
+            return state_;
+         }
+
+         /*!
+          * The unix socket connected to the previous instance, -1 if
+          * there is none (kept open when the application daemonize).
+          */
+         int channel() const
+         {
+            return channel_;
+         }
+
+         /*!
+          * Report the pid of this process to the previous instance, it is
+          * the process killed if this instance fails before ready(). Called
+          * by ready(), and by the server application when it daemonizes.
+          * Does nothing if the application was not started by a hot
+          * restart.
+          */
+         void report_pid(boost::system::error_code &ec)
+         {
+            ec.clear();
+
+            if(channel_ == -1)
+               return;
+
+            char message[1 + sizeof(pid_t)];
+            pid_t pid = getpid();
+
+            message[0] = 'P';
+            std::memcpy(message + 1, &pid, sizeof(pid));
+
+            detail::send_all(channel_, message, sizeof(message), ec);
+         }
+
+         /*!
+          * Report to the previous instance that this one is serving, the
+          * previous instance will drain and exit. Does nothing if the
+          * application was not started by a hot restart.
+          */
+         void ready(boost::system::error_code &ec)
+         {
+            ec.clear();
+
+            if(channel_ == -1)
+               return;
+
+            report_pid(ec);
+
+            if(!ec)
+               detail::send_all(channel_, "R", 1, ec);
+
+            ::close(channel_);
+            channel_ = -1;
+         }
+
+         void ready()
+         {
+            boost::system::error_code ec;
+
+            ready(ec);
+
+            if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "ready() failed", ec);
+         }
+
+         // running instance
+
+         void trigger_signal(int signal_number)
+         {
+            trigger_signal_ = signal_number;
+         }
+
+         int trigger_signal() const
+         {
+            return trigger_signal_;
+         }
+
+         /*!
+          * The sockets passed to the new instance, by default the ones
+          * received from the previous instance.
+          */
+         void handover_fds(const std::vector<int> &fds)
+         {
+            handover_fds_ = fds;
+         }
+
+         const std::vector<int>& handover_fds() const
+         {
+            return handover_fds_;
+         }
+
+         /*!
+          * Produces the state blob passed to the new instance.
+          */
+         void state_handler(const state_handler_type &handler)
+         {
+            state_handler_ = handler;
+         }
+
+         /*!
+          * Called when the new instance is ready, before the termination
+          * of this one, to stop accepting and finish the in-flight work.
+          */
+         void drain_handler(const drain_handler_type &handler)
+         {
+            drain_handler_ = handler;
+         }
+
+         /*!
+          * Called with the error when a restart started by signal_manager
+          * fails, or when the limit_single_instance lock can't be taken
+          * back after it.
+          */
+         void failure_handler(const failure_handler_type &handler)
+         {
+            failure_handler_ = handler;
+         }
+
+         /*!
+          * Call the failure handler.
+          *
+          * \return false if there is no failure handler.
+          */
+         bool failed(const boost::system::error_code &ec)
+         {
+            if(!failure_handler_)
+               return false;
+
+            failure_handler_(ec);
+            return true;
+         }
+
+         /*!
+          * The command line of the new instance, argv[0] is the path of
+          * executable. By default (on Linux) the path of the running
+          * executable (that can be replaced on disk by a new binary) with
+          * the arguments of the running instance.
+          */
+         void command(const std::vector<std::string> &argv)
+         {
+            command_ = argv;
+         }
+
+         /*!
+          * How long restart() waits for the new instance be ready,
+          * 30 seconds by default.
+          */
+         void ready_timeout(int milliseconds)
+         {
+            ready_timeout_ = milliseconds;
+         }
+
+         /*!
+          * Exec the new instance, pass the sockets and the state, and
+          * wait for it be ready.
+          *
+          * \return The pid reported by the new instance, 0 on error (the
+          *         new instance is killed).
+          */
+         pid_t restart(boost::system::error_code &ec)
+         {
+            ec.clear();
+
+            std::vector<std::string> argv = command_;
+
+            if(argv.empty() && !default_command(argv, ec))
+               return 0;
+
+            std::string blob;
+            if(state_handler_)
+               blob = state_handler_();
+
+            int sv[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+               ec = last_error_code();
+               return 0;
+            }
+
+            // all allocations are done before fork
+            std::vector<std::string> env;
+            env.push_back(channel_variable() + "=" + lexical_cast<std::string>(sv[1]));
+
+            std::string prefix = channel_variable() + "=";
+            for(char **e = environ; e && *e; ++e) {
+               if(std::string(*e).compare(0, prefix.size(), prefix) != 0)
+                  env.push_back(*e);
+            }
+
+            std::vector<char*> c_argv, c_env;
+            for(std::size_t i = 0; i < argv.size(); ++i)
+               c_argv.push_back(const_cast<char*>(argv[i].c_str()));
+            c_argv.push_back(0);
+
+            for(std::size_t i = 0; i < env.size(); ++i)
+               c_env.push_back(const_cast<char*>(env[i].c_str()));
+            c_env.push_back(0);
+
+            pid_t child = fork();
+
+            if(child == 0) {
+               // new instance, keep its end of channel across exec
+               fcntl(sv[1], F_SETFD, 0);
+               execve(c_argv[0], &c_argv[0], &c_env[0]);
+               _exit(127);
+            }
+
+            ::close(sv[1]);
+
+            if(child < 0) {
+               ec = last_error_code();
+               ::close(sv[0]);
+               return 0;
+            }
+
+            // the child until the new instance reports another pid (it
+            // daemonized)
+            pid_t pid = child;
+
+            detail::send_fds(sv[0], handover_fds_, blob, ec);
+
+            if(!ec)
+               wait_ready(sv[0], pid, ec);
+
+            ::close(sv[0]);
+
+            if(ec) {
+               if(pid != child)
+                  kill(pid, SIGKILL);
+
+               kill(child, SIGKILL);
+               waitpid(child, 0, 0);
+               return 0;
+            }
+
+            // the child forked the new instance and exited
+            if(pid != child)
+               waitpid(child, 0, 0);
+
+            return pid;
+         }
+
+         pid_t restart()
+         {
+            boost::system::error_code ec;
+
+            pid_t pid = restart(ec);
+
+            if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "restart() failed", ec);
+
+            return pid;
+         }
+
+         /*!
+          * Restarts on a thread of the aspect, and calls handler with the
+          * result of restart(). Used by signal_manager, so the signal
+          * thread is not blocked while the new instance gets ready.
+          *
+          * \return false if a restart is already running.
+          */
+         bool async_restart(const restarted_handler &handler)
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+
+            if(restarting_.load())
+               return false;
+
+            // the previous restart is done
+            if(thread_ && thread_->joinable())
+               thread_->join();
+
+            restarting_.store(true);
+
+            thread_.reset(new csbl::thread(
+               boost::bind(&hot_restart::restart_and_call, this, handler)));
+
+            return true;
+         }
+
+         /*!
+          * Waits the restart started by async_restart().
+          */
+         void join()
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+
+            if(thread_ && thread_->joinable()
+               && thread_->get_id() != boost::this_thread::get_id())
+               thread_->join();
+         }
+
+         /*!
+          * True while a restart started by async_restart() runs.
+          */
+         bool restarting() const
+         {
+            return restarting_.load();
+         }
+
+         /*!
+          * Call the drain handler.
+          */
+         void drain()
+         {
+            if(drain_handler_)
+               drain_handler_();
+         }
+
+      protected:
+
+         static std::string channel_variable()
+         {
+            return "BOOST_APPLICATION_HOT_RESTART_FD";
+         }
+
+         void setup(boost::system::error_code &ec)
+         {
+            ec.clear();
+
+            channel_ = -1;
+            inherited_ = false;
+            restarting_.store(false);
+            trigger_signal_ = SIGUSR2;
+            ready_timeout_ = 30000;
+
+            const char *channel = getenv(channel_variable().c_str());
+
+            if(!channel)
+               return;
+
+            try {
+               channel_ = lexical_cast<int>(channel);
+            } catch(const bad_lexical_cast&) {
+               channel_ = -1;
+            }
+
+            // don't pass it to child processes
+            unsetenv(channel_variable().c_str());
+
+            if(channel_ < 0 || fcntl(channel_, F_SETFD, FD_CLOEXEC) == -1) {
+               channel_ = -1;
+               ec = boost::system::error_code(
+                  boost::system::errc::bad_file_descriptor,
+                  boost::system::generic_category());
+               return;
+            }
+
+            detail::receive_fds(channel_, fds_, state_, ec);
+
+            if(ec) {
+               ::close(channel_);
+               channel_ = -1;
+               return;
+            }
+
+            inherited_ = true;
+            handover_fds_ = fds_;
+         }
+
+         void restart_and_call(restarted_handler handler)
+         {
+            boost::system::error_code ec;
+
+            pid_t pid = restart(ec);
+
+            if(handler)
+               handler(pid, ec);
+
+            restarting_.store(false);
+         }
+
+         // receives the pids reported by the new instance ('P'), until
+         // it is ready ('R')
+         bool wait_ready(int socket, pid_t &pid, boost::system::error_code &ec)
+         {
+            typedef boost::chrono::steady_clock clock_type;
+
+            clock_type::time_point until = clock_type::now()
+               + boost::chrono::milliseconds(ready_timeout_);
+
+            for(;;) {
+               boost::chrono::milliseconds left =
+                  boost::chrono::duration_cast<boost::chrono::milliseconds>(
+                     until - clock_type::now());
+
+               struct pollfd pfd;
+               pfd.fd = socket;
+               pfd.events = POLLIN;
+               pfd.revents = 0;
+
+               int r = 0;
+               if(left.count() > 0)
+                  r = poll(&pfd, 1, (int) left.count());
+
+               if(r == -1 && errno == EINTR)
+                  continue;
+
+               if(r == 0) {
+                  ec = boost::system::error_code(
+                     boost::system::errc::timed_out,
+                     boost::system::generic_category());
+                  return false;
+               }
+
+               if(r < 0) {
+                  ec = last_error_code();
+                  return false;
+               }
+
+               char reply = 0;
+               if(!detail::receive_all(socket, &reply, 1, ec))
+                  return false;
+
+               if(reply == 'R')
+                  return true;
+
+               if(reply != 'P') {
+                  ec = boost::system::error_code(
+                     boost::system::errc::protocol_error,
+                     boost::system::generic_category());
+                  return false;
+               }
+
+               if(!detail::receive_all(socket,
+                     reinterpret_cast<char*>(&pid), sizeof(pid), ec))
+                  return false;
+            }
+         }
+
+         bool default_command(std::vector<std::string> &argv,
+                              boost::system::error_code &ec)
+         {
+#if BOOST_OS_LINUX
+            char path[4096];
+            ssize_t size = readlink("/proc/self/exe", path, sizeof(path) - 1);
+
+            if(size < 0) {
+               ec = last_error_code();
+               return false;
+            }
+
+            std::string executable(path, size);
+
+            // the running executable was replaced by the new binary
+            const std::string deleted = " (deleted)";
+            if(executable.size() > deleted.size() &&
+               executable.compare(executable.size() - deleted.size(),
+                                  deleted.size(), deleted) == 0)
+               executable.erase(executable.size() - deleted.size());
+
+            std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+            std::string args((std::istreambuf_iterator<char>(cmdline)),
+                              std::istreambuf_iterator<char>());
+
+            argv.clear();
+            argv.push_back(executable);
+
+            // skip argv[0]
+            std::string::size_type begin = args.find('\0');
+            while(begin != std::string::npos && begin + 1 < args.size()) {
+               std::string::size_type end = args.find('\0', begin + 1);
+               argv.push_back(args.substr(begin + 1, end - begin - 1));
+               begin = end;
+            }
+
+            return true;
+#else
+            ec = boost::system::error_code(
+               boost::system::errc::function_not_supported,
+               boost::system::generic_category());
+            return false;
+#endif
+         }
+
+      private:
+
+         int channel_;
+         bool inherited_;
+         std::vector<int> fds_;
+         std::string state_;
+
+         int trigger_signal_;
+         int ready_timeout_;
+         std::vector<int> handover_fds_;
+         std::vector<std::string> command_;
+         state_handler_type state_handler_;
+         drain_handler_type drain_handler_;
+         failure_handler_type failure_handler_;
+
+         boost::atomic<bool> restarting_;
+         boost::mutex mutex_;
+         csbl::shared_ptr<csbl::thread> thread_;
+
+      }; // hot_restart
+
+   } // posix
+
+// platform usage
+#if defined( BOOST_POSIX_API )
+   using posix::hot_restart;
+#endif
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_HOT_RESTART_ASPECT_HPP
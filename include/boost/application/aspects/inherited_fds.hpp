@@ -0,0 +1,91 @@
+// inherited_fds.hpp ---------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 26-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_INHERITED_FDS_ASPECT_HPP
+#define BOOST_APPLICATION_INHERITED_FDS_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+
+#include <vector>
+#include <algorithm>
+
+namespace boost { namespace application {
+
+   namespace posix {
+
+      /*!
+       * \brief POSIX platform specific aspect that hold the file descriptors
+       *        that are kept open when the server application daemonize
+       *        (e.g. sockets bound before launch).
+       *
+       * All other descriptors, but stdin, stdout and stderr that are
+       * redirected to /dev/null, are closed.
+       *
+       * \b Examples:
+       * \code
+       * context.insert<application::inherited_fds>(
+       *    boost::make_shared<application::inherited_fds>(listen_fd));
+       * \endcode
+       */
+      class inherited_fds
+      {
+      public:
+
+         inherited_fds()
+         {
+         }
+
+         explicit inherited_fds(int fd)
+            : fds_(1, fd)
+         {
+         }
+
+         explicit inherited_fds(const std::vector<int> &fds)
+            : fds_(fds)
+         {
+         }
+
+         void add(int fd)
+         {
+            if(!contains(fd))
+               fds_.push_back(fd);
+         }
+
+         bool contains(int fd) const
+         {
+            return std::find(fds_.begin(), fds_.end(), fd) != fds_.end();
+         }
+
+         const std::vector<int>& fds() const
+         {
+            return fds_;
+         }
+
+      private:
+
+         std::vector<int> fds_;
+
+      }; // inherited_fds
+
+   } // posix
+
+// platform usage
+#if defined( BOOST_POSIX_API )
+   using posix::inherited_fds;
+#endif
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_INHERITED_FDS_ASPECT_HPP
@@ -0,0 +1,364 @@
+// io_service_pool.hpp -------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 30-05-2014 dd-mm-yyyy - Initial Release
+// 02-06-2014 dd-mm-yyyy - pause and resume
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_IO_SERVICE_POOL_ASPECT_HPP
+#define BOOST_APPLICATION_IO_SERVICE_POOL_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/context.hpp>
+#include <boost/application/detail/csbl.hpp>
+#include <boost/application/aspects/status.hpp>
+#include <boost/application/aspects/wait_for_termination_request.hpp>
+
+#if defined( BOOST_WINDOWS_API )
+#include <boost/application/detail/windows/cpu_affinity_impl.hpp>
+#elif defined( BOOST_POSIX_API )
+#include <boost/application/detail/posix/cpu_affinity_impl.hpp>
+#else
+#error "Sorry, no boost application are available for this platform."
+#endif
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <vector>
+
+namespace boost { namespace application {
+
+   /*!
+    * \brief A runtime aspect that holds one io_service for each core, each
+    *        one run by its own thread, pinned to a cpu.
+    *
+    * Handlers posted to an io_service always run on the same thread (and
+    * cpu), so there is no contention on a shared queue, and the
+    * io_service and its handlers stay on the cache (and NUMA node) of
+    * that cpu.
+    *
+    * The pool is stopped when a termination is requested, using the
+    * wait_for_termination_request aspect of context.
+    *
+    * \b Examples:
+    * \code
+    * int operator()() {
+    *    csbl::shared_ptr<application::io_service_pool> pool =
+    *       context_.find<application::io_service_pool>();
+    *
+    *    // on each connection:
+    *    // tcp::socket socket(pool->get_io_service());
+    *
+    *    // returns when SIGTERM is received
+    *    return pool->run(context_);
+    * }
+    * \endcode
+    */
+   class io_service_pool : noncopyable
+   {
+   public:
+
+      /*!
+       * Constructs an io_service_pool. The threads are created by start()
+       * or run().
+       *
+       * \param size The number of io_service (and threads), 0 is one for
+       *        each core (hardware_concurrency).
+       */
+      explicit io_service_pool(std::size_t size = 0)
+         : pin_to_cpu_(true)
+         , numa_aware_(false)
+         , next_(0)
+         , started_(0)
+         , paused_(false)
+      {
+         if(!size)
+            size = csbl::thread::hardware_concurrency();
+
+         if(!size)
+            size = 1;
+
+         for(std::size_t i = 0; i < size; ++i) {
+            io_services_.push_back(
+               csbl::shared_ptr<asio::io_service>(new asio::io_service(1)));
+         }
+
+         cpus_.resize(size, -1);
+      }
+
+      virtual ~io_service_pool()
+      {
+         stop();
+      }
+
+      /*!
+       * Pin each thread to a cpu, default true. If there are more threads
+       * than cpus, the cpus are reused.
+       */
+      void pin_to_cpu(bool pin)
+      {
+         pin_to_cpu_ = pin;
+      }
+
+      bool pin_to_cpu() const
+      {
+         return pin_to_cpu_;
+      }
+
+      /*!
+       * Spread consecutive threads on the NUMA nodes, default false (the
+       * threads are placed on the cpus in order).
+       */
+      void numa_aware(bool numa)
+      {
+         numa_aware_ = numa;
+      }
+
+      bool numa_aware() const
+      {
+         return numa_aware_;
+      }
+
+      std::size_t size() const
+      {
+         return io_services_.size();
+      }
+
+      /*!
+       * Retrieves an io_service of pool, round robin.
+       */
+      asio::io_service& get_io_service()
+      {
+         std::size_t index = next_.fetch_add(1, boost::memory_order_relaxed);
+         return *io_services_[index % io_services_.size()];
+      }
+
+      asio::io_service& get_io_service(std::size_t index)
+      {
+         return *io_services_[index];
+      }
+
+      /*!
+       * The cpu where the thread of io_service 'index' is pinned, -1 if
+       * it is not pinned or the pool is not started.
+       */
+      int cpu(std::size_t index) const
+      {
+         return cpus_[index];
+      }
+
+      bool running() const
+      {
+         return !threads_.empty();
+      }
+
+      /*!
+       * Creates the threads, returns when all are pinned and are running
+       * its io_service. The io_services run until stop() is called.
+       *
+       * \param ec Variable (boost::system::error_code) that will be
+       *        set to the result of the operation.
+       *
+       * Check ec for errors.
+       *
+       */
+      void start(boost::system::error_code &ec)
+      {
+         ec.clear();
+
+         if(running()) {
+            ec = boost::system::error_code(
+               boost::system::errc::operation_in_progress,
+               boost::system::generic_category());
+            return;
+         }
+
+         std::vector<int> cpus;
+         if(pin_to_cpu_)
+            cpus = detail::allowed_cpus(numa_aware_);
+
+         started_ = 0;
+
+         for(std::size_t i = 0; i < io_services_.size(); ++i) {
+            io_services_[i]->reset();
+
+            works_.push_back(csbl::shared_ptr<asio::io_service::work>(
+               new asio::io_service::work(*io_services_[i])));
+
+            int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+
+            threads_.push_back(csbl::shared_ptr<csbl::thread>(new csbl::thread(
+               boost::bind(&io_service_pool::run_io_service, this, i, cpu))));
+         }
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         while(started_ < threads_.size())
+            started_cond_.wait(lock);
+      }
+
+      void start()
+      {
+         boost::system::error_code ec;
+         start(ec);
+
+         if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+            "start() failed", ec);
+      }
+
+      /*!
+       * Stops all io_services and joins the threads. The handlers not yet
+       * run are discarded.
+       */
+      void stop()
+      {
+         resume();
+
+         works_.clear();
+
+         for(std::size_t i = 0; i < io_services_.size(); ++i)
+            io_services_[i]->stop();
+
+         join();
+      }
+
+      /*!
+       * Waits for the threads, without stopping the io_services.
+       */
+      void join()
+      {
+         for(std::size_t i = 0; i < threads_.size(); ++i) {
+            if(threads_[i]->joinable())
+               threads_[i]->join();
+         }
+
+         threads_.clear();
+      }
+
+      /*!
+       * Parks the thread of each io_service after the handler that it is
+       * running, so they consume no cpu. The handlers posted meanwhile
+       * run after resume(). Don't block.
+       */
+      void pause()
+      {
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+
+            if(paused_ || !running())
+               return;
+
+            paused_ = true;
+         }
+
+         for(std::size_t i = 0; i < io_services_.size(); ++i)
+            io_services_[i]->post(boost::bind(&io_service_pool::park, this));
+      }
+
+      void resume()
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         paused_ = false;
+         paused_cond_.notify_all();
+      }
+
+      bool paused()
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         return paused_;
+      }
+
+      /*!
+       * Starts the pool, waits for a termination request (as the
+       * wait_for_termination_request aspect of context) and stops the
+       * pool.
+       *
+       * \param context The context of application.
+       *
+       * \return 0, to be returned by the application functor.
+       *
+       */
+      int run(application::context &context)
+      {
+         start();
+
+         csbl::shared_ptr<status> st = context.find<status>();
+
+         if(!st || st->state() != status::stopped) {
+            csbl::shared_ptr<wait_for_termination_request> waiter =
+               context.find<wait_for_termination_request>();
+
+            if(waiter)
+               waiter->wait();
+         }
+
+         stop();
+         return 0;
+      }
+
+   protected:
+
+      void run_io_service(std::size_t index, int cpu)
+      {
+         if(cpu >= 0) {
+            boost::system::error_code ec;
+            detail::pin_current_thread(cpu, ec);
+
+            if(!ec)
+               cpus_[index] = cpu;
+         }
+
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            started_++;
+         }
+
+         started_cond_.notify_all();
+
+         io_services_[index]->run();
+      }
+
+      // the safe point, a handler of each io_service
+      void park()
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+
+         while(paused_)
+            paused_cond_.wait(lock);
+      }
+
+   private:
+
+      bool pin_to_cpu_;
+      bool numa_aware_;
+
+      std::vector<csbl::shared_ptr<asio::io_service> > io_services_;
+      std::vector<csbl::shared_ptr<asio::io_service::work> > works_;
+      std::vector<csbl::shared_ptr<csbl::thread> > threads_;
+      std::vector<int> cpus_;
+
+      boost::atomic<std::size_t> next_;
+
+      boost::mutex mutex_;
+      boost::condition_variable started_cond_;
+      std::size_t started_;
+
+      boost::condition_variable paused_cond_;
+      bool paused_;
+
+   }; // io_service_pool
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_IO_SERVICE_POOL_ASPECT_HPP
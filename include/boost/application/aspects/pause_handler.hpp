@@ -10,6 +10,8 @@
 
 // Revision History
 // 18-10-2013 dd-mm-yyyy - Initial Release
+// 02-06-2014 dd-mm-yyyy - Signal number on posix
+// 03-06-2014 dd-mm-yyyy - Real-time signal by default, hooks
 
 // -----------------------------------------------------------------------------
 
@@ -19,13 +21,78 @@
 #include <boost/application/config.hpp>
 #include <boost/application/handler.hpp>
 
+#if defined( BOOST_POSIX_API )
+#include <csignal>
+#include <vector>
+#endif
+
 namespace boost { namespace application {
 
    class pause_handler : public handler<>
    {
    public:
       pause_handler(const callback& cb)
-         : handler<>(cb) {}
+         : handler<>(cb)
+#if defined( BOOST_POSIX_API )
+         , signal_number_(default_signal_number())
+#endif
+      {}
+
+#if defined( BOOST_POSIX_API )
+      /*!
+       * Sets the signal that pauses the application, bound by the
+       * signal_manager (SIGRTMIN + 2 by default, or SIGUSR1 where there is
+       * no real-time signal). Shall be set before the signal_manager is
+       * created.
+       *
+       * The signal_manager fails with device_or_resource_busy if the
+       * signal is already bound, e.g. to hot_restart.
+       */
+      void signal_number(int signal_number) {
+         signal_number_ = signal_number;
+      }
+
+      int signal_number() const {
+         return signal_number_;
+      }
+
+      typedef csbl::function<void ()> hook;
+
+      /*!
+       * Adds a hook that the signal_manager calls each time the
+       * application is paused (the callback accepted and the status
+       * changed), e.g. to park the workers of a pool:
+       *
+       * \code
+       * ph->add_hook(boost::bind(&application::work_queue::pause, queue));
+       * \endcode
+       *
+       * Shall be added before the signal_manager is created.
+       */
+      void add_hook(const hook& h) {
+         hooks_.push_back(h);
+      }
+
+      void call_hooks() const {
+         for(std::size_t i = 0; i < hooks_.size(); ++i)
+            hooks_[i]();
+      }
+
+   private:
+
+      // SIGUSR1 and SIGUSR2 are taken by hot_restart and by the SIGUSR1
+      // version of wait_for_termination_request
+      static int default_signal_number() {
+#if defined( SIGRTMIN )
+         return SIGRTMIN + 2;
+#else
+         return SIGUSR1;
+#endif
+      }
+
+      int signal_number_;
+      std::vector<hook> hooks_;
+#endif
    };
 
    class pause_handler_default_behaviour : public pause_handler
@@ -12,6 +12,7 @@
 
 // Revision History
 // 08-11-2013 dd-mm-yyyy - Initial Release
+// 25-05-2014 dd-mm-yyyy - eventfd backend, pokes are coalesced
 
 // -----------------------------------------------------------------------------
 
@@ -27,6 +28,10 @@
 #if defined( BOOST_POSIX_API )
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#if defined( BOOST_APPLICATION_HAS_EVENTFD )
+#include <sys/eventfd.h>
+#endif
 #endif
 
 namespace boost { namespace application { 
@@ -35,7 +40,21 @@ namespace boost { namespace application {
 
       /*!
        * \brief POSIX platform specific aspect that implement self-pipe trick.
-       *        
+       *
+       * On Linux the "pipe" is an eventfd, read_fd() and write_fd() are
+       * the same descriptor and the pokes are added to a counter of
+       * eventfd, so any number of pokes never fill it. Elsewhere a pipe
+       * is used, and pokes done when the pipe is full are dropped (the
+       * pipe is readable anyway).
+       *
+       * Note that an eventfd only accepts 8 byte reads and writes: a
+       * write(write_fd(), "x", 1) or read(read_fd(), buf, 1) fails with
+       * EINVAL. Use poke() and drain() instead of I/O on the
+       * descriptors, and only poll (select) read_fd(), or define
+       * BOOST_APPLICATION_NO_EVENTFD to keep the pipe.
+       *
+       * The descriptor stays readable until drain() is called, so any
+       * number of threads can wait (poll) for a poke on it.
        */
       class selfpipe : noncopyable
       {
@@ -66,6 +85,14 @@ namespace boost { namespace application {
 
          void setup(boost::system::error_code &ec)
          {
+#if defined( BOOST_APPLICATION_HAS_EVENTFD )
+            fd_[readfd] = fd_[writefd] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+            if (fd_[readfd] == -1)
+            {
+               ec = last_error_code(); return;
+            }
+#else
             if (pipe(fd_) == -1)
             {
                ec = last_error_code(); return;
@@ -76,12 +103,15 @@ namespace boost { namespace application {
 
             fcntl(fd_[writefd], F_SETFL,
                fcntl(fd_[writefd], F_GETFL) | O_NONBLOCK);
+#endif
          }
 
          void teardown()
          {
             close(fd_[readfd]);
-            close(fd_[writefd]);
+
+            if (fd_[writefd] != fd_[readfd])
+               close(fd_[writefd]);
          }
 
       public:
@@ -98,7 +128,33 @@ namespace boost { namespace application {
 
          void poke()
          {
-            write(fd_[writefd], "", 1);
+#if defined( BOOST_APPLICATION_HAS_EVENTFD )
+            eventfd_write(fd_[writefd], 1);
+#else
+            while (write(fd_[writefd], "", 1) == -1 && errno == EINTR)
+            {
+               // nothing here, restart when signal is catch
+            }
+#endif
+         }
+
+         // consume all pending pokes, then read_fd() is not readable
+         // until next poke
+         void drain()
+         {
+#if defined( BOOST_APPLICATION_HAS_EVENTFD )
+            eventfd_t value;
+            eventfd_read(fd_[readfd], &value);
+#else
+            char buffer[256];
+            ssize_t r;
+
+            while ((r = read(fd_[readfd], buffer, sizeof(buffer))) > 0
+               || (r == -1 && errno == EINTR))
+            {
+               // nothing here, read until EAGAIN
+            }
+#endif
          }
 
       private:
@@ -0,0 +1,252 @@
+// socket_activation.hpp -----------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 27-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_SOCKET_ACTIVATION_ASPECT_HPP
+#define BOOST_APPLICATION_SOCKET_ACTIVATION_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/detail/csbl.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <vector>
+#include <cstdlib>
+
+// platform usage
+#if defined( BOOST_POSIX_API )
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#endif
+
+namespace boost { namespace application {
+
+   namespace posix {
+
+      /*!
+       * \brief POSIX platform specific aspect that hold the listening
+       *        sockets passed to application (socket activation).
+       *
+       * The sockets are taken from LISTEN_FDS/LISTEN_PID environment
+       * variables as defined by systemd (sd_listen_fds), or from an
+       * explicit list of descriptors (e.g. sockets bound by a parent).
+       *
+       * The sockets are kept open when the server application daemonize,
+       * and can be used by the application as ready asio acceptors, so
+       * there is no new bind/listen when application is restarted.
+       *
+       * \b Examples:
+       * \code
+       * context.insert<application::socket_activation>(
+       *    boost::make_shared<application::socket_activation>());
+       *
+       * // on application
+       * csbl::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor =
+       *    context.find<application::socket_activation>()->acceptor(io_service, 0);
+       * \endcode
+       */
+      class socket_activation
+      {
+      public:
+
+         // first descriptor passed, SD_LISTEN_FDS_START of systemd
+         static const int listen_fds_start = 3;
+
+         /*!
+          * Take the sockets from LISTEN_FDS/LISTEN_PID environment
+          * variables, that are removed from environment. There is no
+          * socket if the variables are not defined, or if LISTEN_PID is
+          * other process.
+          *
+          * \throw boost::system::system_error if LISTEN_FDS is invalid.
+          */
+         socket_activation()
+         {
+            boost::system::error_code ec;
+
+            from_environment(ec);
+
+            if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "socket_activation() failed", ec);
+         }
+
+         socket_activation(boost::system::error_code &ec)
+         {
+            from_environment(ec);
+         }
+
+         /*!
+          * Use an explicit list of listening sockets.
+          */
+         explicit socket_activation(const std::vector<int> &fds)
+            : fds_(fds)
+         {
+         }
+
+         const std::vector<int>& fds() const
+         {
+            return fds_;
+         }
+
+         std::size_t size() const
+         {
+            return fds_.size();
+         }
+
+         /*!
+          * Create an acceptor for the TCP socket at index, the acceptor
+          * own a duplicate of socket, the socket itself is kept open.
+          *
+          * \throw boost::system::system_error if the socket is not a
+          *        listening TCP socket.
+          */
+         csbl::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor(
+            boost::asio::io_service &io_service, std::size_t index)
+         {
+            boost::system::error_code ec;
+
+            csbl::shared_ptr<boost::asio::ip::tcp::acceptor> result =
+               acceptor(io_service, index, ec);
+
+            if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "socket_activation::acceptor() failed", ec);
+
+            return result;
+         }
+
+         csbl::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor(
+            boost::asio::io_service &io_service, std::size_t index,
+            boost::system::error_code &ec)
+         {
+            ec.clear();
+
+            if(index >= fds_.size()) {
+               ec = boost::system::error_code(
+                  boost::system::errc::bad_file_descriptor,
+                  boost::system::generic_category());
+               return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+            }
+
+            int fd = fds_[index];
+
+            int type = 0, listening = 0;
+            socklen_t len = sizeof(int);
+
+            if(getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) != 0) {
+               ec = last_error_code();
+               return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+            }
+
+            len = sizeof(int);
+            getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len);
+
+            struct sockaddr_storage address;
+            len = sizeof(address);
+
+            if(getsockname(fd, (struct sockaddr*)&address, &len) != 0) {
+               ec = last_error_code();
+               return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+            }
+
+            if(type != SOCK_STREAM || !listening ||
+               (address.ss_family != AF_INET && address.ss_family != AF_INET6)) {
+               ec = boost::system::error_code(
+                  boost::system::errc::invalid_argument,
+                  boost::system::generic_category());
+               return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+            }
+
+            int dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+            if(dup_fd == -1) {
+               ec = last_error_code();
+               return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+            }
+
+            csbl::shared_ptr<boost::asio::ip::tcp::acceptor> result(
+               new boost::asio::ip::tcp::acceptor(io_service));
+
+            result->assign(address.ss_family == AF_INET
+               ? boost::asio::ip::tcp::v4() : boost::asio::ip::tcp::v6(), dup_fd, ec);
+
+            if(ec) {
+               ::close(dup_fd);
+               return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+            }
+
+            return result;
+         }
+
+      protected:
+
+         void from_environment(boost::system::error_code &ec)
+         {
+            ec.clear();
+
+            const char *pid = getenv("LISTEN_PID");
+            const char *count = getenv("LISTEN_FDS");
+
+            if(!pid || !count)
+               return;
+
+            int n = 0;
+
+            try {
+               if(lexical_cast<pid_t>(pid) != getpid())
+                  return;
+
+               n = lexical_cast<int>(count);
+            } catch(const bad_lexical_cast&) {
+               n = -1;
+            }
+
+            // don't pass them to child processes
+            unsetenv("LISTEN_PID");
+            unsetenv("LISTEN_FDS");
+            unsetenv("LISTEN_FDNAMES");
+
+            if(n < 0) {
+               ec = boost::system::error_code(
+                  boost::system::errc::invalid_argument,
+                  boost::system::generic_category());
+               return;
+            }
+
+            for(int fd = listen_fds_start; fd < listen_fds_start + n; ++fd) {
+               if(fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+                  ec = last_error_code();
+                  fds_.clear();
+                  return;
+               }
+
+               fds_.push_back(fd);
+            }
+         }
+
+      private:
+
+         std::vector<int> fds_;
+
+      }; // socket_activation
+
+   } // posix
+
+// platform usage
+#if defined( BOOST_POSIX_API )
+   using posix::socket_activation;
+#endif
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_SOCKET_ACTIVATION_ASPECT_HPP
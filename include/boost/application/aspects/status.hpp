@@ -10,6 +10,7 @@
 
 // Revision History
 // 14-10-2013 dd-mm-yyyy - Initial Release
+// 02-06-2014 dd-mm-yyyy - Atomic state machine, timestamps, wait and hooks
 
 // -----------------------------------------------------------------------------
 
@@ -18,6 +19,16 @@
 
 // appication
 #include <boost/application/config.hpp>
+#include <boost/application/detail/csbl.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <vector>
 
 namespace boost { namespace application {
 
@@ -29,10 +40,30 @@ namespace boost { namespace application {
     *
     * - application_stopped
     * - application_running
-    * - application_paused (used only on server appliation on windows side)
+    * - application_paused (windows service, or pause/resume on posix)
+    *
+    * The state is an atomic, reads are lock-free and can be done from
+    * any thread (e.g. health checks). Transitions are made by CAS, the
+    * time of each transition is recorded on a monotonic clock, and
+    * callers can wait for a state without polling.
+    *
+    * The status is noncopyable (it holds the waiters and the hooks), use
+    * the shared_ptr of context to share it. It uses boost::chrono, so
+    * boost_chrono must be linked.
+    *
+    * \b Examples:
+    * \code
+    * csbl::shared_ptr<status> st = context.find<status>();
     *
+    * if(st->transition(status::running, status::paused)) {
+    *    // we paused it
+    * }
+    *
+    * st->wait(status::stopped);
+    * std::cout << st->uptime() << ", paused " << st->paused_duration();
+    * \endcode
     */
-   class status
+   class status : noncopyable
    {
       friend class server;
       friend class common;
@@ -42,16 +73,29 @@ namespace boost { namespace application {
       enum application_state {
          stopped = 0,
          running,
-         paused // Windows Service
+         paused
       };
 
+      typedef boost::chrono::steady_clock clock_type;
+
+      typedef csbl::function< void (application_state, application_state) >
+         transition_handler;
+
       /*!
        * Constructs an application_state aspect.
        *
        * \param state The state of application.
        */
       status(application_state state)
-         :  application_state_(state) {}
+         : application_state_(state)
+         , created_(now())
+         , paused_total_(0)
+         , waiters_(0)
+         , hooked_(false)
+      {
+         for(int i = 0; i < states; ++i)
+            entered_[i].store(i == state ? created_ : 0);
+      }
 
       /*!
        * Retreaves current state of application.
@@ -59,35 +103,192 @@ namespace boost { namespace application {
        * \return the state of application.
        *
        */
-      application_state state() {
-         return application_state_;
+      application_state state() const {
+         return (application_state)
+            application_state_.load(boost::memory_order_acquire);
       }
 
       /*!
-       * Sets the current state of application.
+       * Sets the current state of application, whatever the state it
+       * was.
        *
        * \param state The state of application.
        *
        */
       void state(application_state state) {
-         application_state_ = state;
+         int from = application_state_.exchange(state);
+
+         if(from != state)
+            changed((application_state) from, state);
+      }
+
+      /*!
+       * Changes the state of application to 'to', only if it is 'from'.
+       *
+       * \return true if the state was changed.
+       *
+       */
+      bool transition(application_state from, application_state to) {
+         int expected = from;
+
+         if(!application_state_.compare_exchange_strong(expected, to))
+            return false;
+
+         if(from != to)
+            changed(from, to);
+
+         return true;
+      }
+
+      /*!
+       * Waits until the application is on state.
+       */
+      void wait(application_state state) {
+         if(this->state() == state)
+            return;
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         waiters_.fetch_add(1);
+
+         while(this->state() != state)
+            condition_.wait(lock);
+
+         waiters_.fetch_sub(1);
+      }
+
+      /*!
+       * Waits until the application is on state, or timeout.
+       *
+       * \return true if the application is on state.
+       */
+      template <class Rep, class Period>
+      bool wait_for(application_state state,
+                    const boost::chrono::duration<Rep, Period>& timeout) {
+         if(this->state() == state)
+            return true;
+
+         clock_type::time_point until = clock_type::now() + timeout;
+
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         waiters_.fetch_add(1);
+
+         while(this->state() != state) {
+            if(condition_.wait_until(lock, until) == boost::cv_status::timeout)
+               break;
+         }
+
+         waiters_.fetch_sub(1);
+         return this->state() == state;
+      }
+
+      /*!
+       * Adds a handler that is called after each transition, on the
+       * thread that made it.
+       */
+      void on_transition(const transition_handler& handler) {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         handlers_.push_back(handler);
+         hooked_.store(true);
+      }
+
+      /*!
+       * The last time that the application entered state, or the
+       * epoch of clock if it never did.
+       */
+      clock_type::time_point since(application_state state) const {
+         return clock_type::time_point(
+            clock_type::duration(entered_[state].load()));
+      }
+
+      /*!
+       * The time on the current state.
+       */
+      clock_type::duration elapsed() const {
+         return clock_type::now() - since(state());
+      }
+
+      /*!
+       * The time since the construction of aspect.
+       */
+      clock_type::duration uptime() const {
+         return clock_type::duration(now() - created_);
+      }
+
+      /*!
+       * The total time on paused, including the current pause.
+       */
+      clock_type::duration paused_duration() const {
+         boost::int_least64_t total = paused_total_.load();
+
+         if(state() == paused)
+            total += now() - entered_[paused].load();
+
+         return clock_type::duration(total);
       }
 
       bool operator==(application_state state) const {
-         return state == application_state_;
+         return state == this->state();
       }
 
       bool operator!=(application_state state) const {
-         return state != application_state_;
+         return state != this->state();
+      }
+
+   protected:
+
+      static boost::int_least64_t now() {
+         return clock_type::now().time_since_epoch().count();
+      }
+
+      void changed(application_state from, application_state to) {
+         boost::int_least64_t time = now();
+
+         if(from == paused)
+            paused_total_.fetch_add(time - entered_[paused].load());
+
+         entered_[to].store(time);
+
+         if(waiters_.load()) {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            condition_.notify_all();
+         }
+
+         if(hooked_.load()) {
+            std::vector<transition_handler> handlers;
+
+            {
+               boost::lock_guard<boost::mutex> lock(mutex_);
+               handlers = handlers_;
+            }
+
+            for(std::size_t i = 0; i < handlers.size(); ++i)
+               handlers[i](from, to);
+         }
       }
 
    private:
 
-      application_state application_state_;
+      enum { states = paused + 1 };
+
+      boost::atomic<int> application_state_;
+
+      // times as ticks of clock_type
+      boost::int_least64_t created_;
+      boost::atomic<boost::int_least64_t> entered_[states];
+      boost::atomic<boost::int_least64_t> paused_total_;
+
+      // only signaled when someone waits
+      boost::atomic<int> waiters_;
+      boost::atomic<bool> hooked_;
+
+      boost::mutex mutex_;
+      boost::condition_variable condition_;
+
+      std::vector<transition_handler> handlers_;
 
    };
 
 }} // boost::application
 
 #endif // BOOST_APPLICATION_STATUS_ASPECT_HPP
-
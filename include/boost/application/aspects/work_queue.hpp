@@ -0,0 +1,617 @@
+// work_queue.hpp ------------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 31-05-2014 dd-mm-yyyy - Initial Release
+// 02-06-2014 dd-mm-yyyy - pause and resume
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_WORK_QUEUE_ASPECT_HPP
+#define BOOST_APPLICATION_WORK_QUEUE_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/context.hpp>
+#include <boost/application/detail/csbl.hpp>
+#include <boost/application/detail/work_stealing_deque.hpp>
+#include <boost/application/aspects/status.hpp>
+#include <boost/application/aspects/wait_for_termination_request.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace boost { namespace application {
+
+   /*!
+    * \brief Counts the completion of tasks added to a work_queue.
+    *
+    * A task added with a task_latch counts it down when it is done,
+    * wait() returns when all tasks are done.
+    *
+    * \b Examples:
+    * \code
+    * application::task_latch done;
+    * queue->add_tasks(tasks.begin(), tasks.end(), done);
+    * queue->wait(done);
+    * \endcode
+    */
+   class task_latch : noncopyable
+   {
+   public:
+
+      explicit task_latch(std::size_t count = 0)
+         : count_(count)
+         , done_(count == 0)
+      {}
+
+      /*!
+       * Adds count tasks to wait for.
+       */
+      void add(std::size_t count = 1)
+      {
+         if(count_.fetch_add(count) == 0) {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            done_.store(false);
+         }
+      }
+
+      void count_down()
+      {
+         if(count_.fetch_sub(1) == 1) {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            done_.store(true);
+            cond_.notify_all();
+         }
+      }
+
+      /*!
+       * Check if all tasks are done, don't block.
+       */
+      bool try_wait()
+      {
+         if(!done_.load(boost::memory_order_acquire))
+            return false;
+
+         // the last count_down() can still be notifying
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         return done_.load();
+      }
+
+      void wait()
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+
+         while(!done_.load())
+            cond_.wait(lock);
+      }
+
+   private:
+
+      boost::atomic<std::size_t> count_;
+      boost::atomic<bool> done_;
+
+      boost::mutex mutex_;
+      boost::condition_variable cond_;
+   };
+
+   /*!
+    * \brief A work stealing thread pool aspect.
+    *
+    * Each worker thread has its own deque (Chase-Lev). The tasks added
+    * by a worker go to its deque, and are run LIFO by it. The tasks
+    * added by other threads go to a shared queue. An idle worker takes
+    * tasks from the shared queue, then steals the oldest tasks of other
+    * workers, and sleeps only if there is no task anywhere.
+    *
+    * On stop() (or termination, see run()) the tasks already added are
+    * done (graceful drain), new tasks from outside the pool are refused.
+    *
+    * On pause() the workers park before taking the next task, so they
+    * consume no cpu, the tasks added meanwhile are kept until resume().
+    *
+    * The tasks shall not throw.
+    *
+    * \b Examples:
+    * \code
+    * context.insert<application::work_queue>(
+    *    boost::make_shared<application::work_queue>());
+    *
+    * // on application functor:
+    * context_.find<application::work_queue>()->add_task(my_task());
+    * \endcode
+    */
+   class work_queue : noncopyable
+   {
+   public:
+
+      typedef csbl::function< void (void) > task_type;
+
+      /*!
+       * Constructs a work_queue, and starts the workers.
+       *
+       * \param workers The number of worker threads, 0 is one for each
+       *        core (hardware_concurrency).
+       */
+      explicit work_queue(std::size_t workers = 0)
+         : current_(&work_queue::no_cleanup)
+         , pending_(0)
+         , injected_(0)
+         , idle_(0)
+         , stopping_(false)
+         , paused_(false)
+      {
+         if(!workers)
+            workers = csbl::thread::hardware_concurrency();
+
+         if(!workers)
+            workers = 1;
+
+         for(std::size_t i = 0; i < workers; ++i)
+            workers_.push_back(csbl::shared_ptr<worker>(new worker(this, i)));
+
+         for(std::size_t i = 0; i < workers; ++i) {
+            threads_.push_back(csbl::shared_ptr<csbl::thread>(new csbl::thread(
+               boost::bind(&work_queue::work, this, workers_[i].get()))));
+         }
+      }
+
+      virtual ~work_queue()
+      {
+         stop();
+      }
+
+      std::size_t size() const
+      {
+         return workers_.size();
+      }
+
+      /*!
+       * Adds a task.
+       *
+       * \return false if the work_queue is stopping, and the task
+       *         was not added.
+       */
+      template <typename Task>
+      bool add_task(const Task &task)
+      {
+         task_type *t = new task_type(task);
+         return push(&t, &t + 1);
+      }
+
+      /*!
+       * Adds a task, that counts down the latch when done.
+       */
+      template <typename Task>
+      bool add_task(const Task &task, task_latch &latch)
+      {
+         latch.add(1);
+
+         if(add_task(counted_task<Task>(task, latch)))
+            return true;
+
+         latch.count_down();
+         return false;
+      }
+
+      /*!
+       * Adds the tasks of range [first, last), the shared queue is locked
+       * only once, and the idle workers are waked up once.
+       */
+      template <typename Iterator>
+      bool add_tasks(Iterator first, Iterator last)
+      {
+         std::vector<task_type*> tasks;
+
+         for(; first != last; ++first)
+            tasks.push_back(new task_type(*first));
+
+         if(tasks.empty())
+            return true;
+
+         return push(&tasks[0], &tasks[0] + tasks.size());
+      }
+
+      /*!
+       * Adds the tasks of range [first, last), each one counts down the
+       * latch when done.
+       */
+      template <typename Iterator>
+      bool add_tasks(Iterator first, Iterator last, task_latch &latch)
+      {
+         typedef typename std::iterator_traits<Iterator>::value_type task;
+
+         std::vector<task_type*> tasks;
+
+         for(; first != last; ++first)
+            tasks.push_back(new task_type(counted_task<task>(*first, latch)));
+
+         if(tasks.empty())
+            return true;
+
+         latch.add(tasks.size());
+
+         if(push(&tasks[0], &tasks[0] + tasks.size()))
+            return true;
+
+         for(std::size_t i = 0; i < tasks.size(); ++i)
+            latch.count_down();
+
+         return false;
+      }
+
+      /*!
+       * Waits for the tasks of latch. If called by a worker, it runs
+       * other tasks while waiting (so a task can wait for its subtasks).
+       */
+      void wait(task_latch &latch)
+      {
+         worker *self = current_.get();
+
+         if(!self || self->owner != this) {
+            latch.wait();
+            return;
+         }
+
+         while(!latch.try_wait()) {
+            task_type *task = next(self);
+
+            if(task)
+               execute(task);
+            else
+               boost::this_thread::yield();
+         }
+      }
+
+      /*!
+       * Waits until all tasks added are done, shall not be called by a
+       * worker.
+       */
+      void drain()
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+
+         while(pending_.load() != 0)
+            cond_.wait(lock);
+      }
+
+      /*!
+       * Refuses new tasks from outside of the pool, waits until all tasks
+       * are done (the running tasks can still add tasks), and joins the
+       * workers. Shall not be called by a worker.
+       */
+      void stop()
+      {
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            stopping_.store(true);
+            cond_.notify_all();
+            idle_cond_.notify_all();
+         }
+
+         for(std::size_t i = 0; i < threads_.size(); ++i) {
+            if(threads_[i]->joinable())
+               threads_[i]->join();
+         }
+
+         threads_.clear();
+      }
+
+      bool stopping() const
+      {
+         return stopping_.load();
+      }
+
+      /*!
+       * Parks the workers: the running tasks go on, but no worker takes
+       * a new task until resume() (or stop()). Don't block.
+       */
+      void pause()
+      {
+         paused_.store(true);
+      }
+
+      void resume()
+      {
+         boost::lock_guard<boost::mutex> lock(mutex_);
+         paused_.store(false);
+         cond_.notify_all();
+      }
+
+      bool paused() const
+      {
+         return paused_.load();
+      }
+
+      /*!
+       * Waits for a termination request (as the
+       * wait_for_termination_request aspect of context), and stops the
+       * work_queue, doing the tasks already added.
+       *
+       * \param context The context of application.
+       *
+       * \return 0, to be returned by the application functor.
+       *
+       */
+      int run(application::context &context)
+      {
+         csbl::shared_ptr<status> st = context.find<status>();
+
+         if(!st || st->state() != status::stopped) {
+            csbl::shared_ptr<wait_for_termination_request> waiter =
+               context.find<wait_for_termination_request>();
+
+            if(waiter)
+               waiter->wait();
+         }
+
+         stop();
+         return 0;
+      }
+
+   protected:
+
+      typedef detail::work_stealing_deque<task_type> work_stealing_deque_type;
+
+      struct worker : noncopyable
+      {
+         worker(work_queue *q, std::size_t i)
+            : owner(q)
+            , index(i)
+            , seed((unsigned)i * 2654435761u + 1)
+         {}
+
+         work_stealing_deque_type deque;
+         work_queue *owner;
+         std::size_t index;
+         unsigned seed;
+      };
+
+      template <typename Task>
+      struct counted_task
+      {
+         counted_task(const Task &t, task_latch &l)
+            : task(t), latch(&l) {}
+
+         void operator()()
+         {
+            task();
+            latch->count_down();
+         }
+
+         Task task;
+         task_latch *latch;
+      };
+
+      static void no_cleanup(worker *) {}
+
+      // the tasks are deleted if refused
+      bool push(task_type **first, task_type **last)
+      {
+         std::size_t count = last - first;
+
+         worker *self = current_.get();
+         bool inside = self && self->owner == this;
+
+         // counted before the stopping check, see work()
+         pending_.fetch_add(count);
+
+         if(!inside && stopping_.load()) {
+            for(task_type **t = first; t != last; ++t)
+               delete *t;
+
+            done(count);
+            return false;
+         }
+
+         if(inside) {
+            for(task_type **t = first; t != last; ++t)
+               self->deque.push(*t);
+         } else {
+            boost::lock_guard<boost::mutex> lock(injected_mutex_);
+            injected_queue_.insert(injected_queue_.end(), first, last);
+            injected_.fetch_add(count);
+         }
+
+         wake(count);
+         return true;
+      }
+
+      void wake(std::size_t count)
+      {
+         // pairs with idle_ increment and has_work() of work()
+         boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+         if(idle_.load() == 0)
+            return;
+
+         boost::lock_guard<boost::mutex> lock(mutex_);
+
+         if(count == 1)
+            idle_cond_.notify_one();
+         else
+            idle_cond_.notify_all();
+      }
+
+      void done(std::size_t count)
+      {
+         if(pending_.fetch_sub(count) == count) {
+            // drain() and the workers waiting to stop
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            cond_.notify_all();
+            idle_cond_.notify_all();
+         }
+      }
+
+      void execute(task_type *task)
+      {
+         (*task)();
+         delete task;
+
+         done(1);
+      }
+
+      task_type* next(worker *self)
+      {
+         task_type *task = self->deque.pop();
+         if(task)
+            return task;
+
+         task = take_injected(self);
+         if(task)
+            return task;
+
+         return steal(self);
+      }
+
+      // takes one task, and moves a share of the others to the deque of
+      // worker, so the shared queue is locked less times
+      task_type* take_injected(worker *self)
+      {
+         if(injected_.load(boost::memory_order_relaxed) == 0)
+            return 0;
+
+         boost::lock_guard<boost::mutex> lock(injected_mutex_);
+
+         if(injected_queue_.empty())
+            return 0;
+
+         task_type *task = injected_queue_.front();
+         injected_queue_.pop_front();
+
+         std::size_t share = injected_queue_.size() / workers_.size();
+         if(share > 32)
+            share = 32;
+
+         for(std::size_t i = 0; i < share; ++i) {
+            self->deque.push(injected_queue_.front());
+            injected_queue_.pop_front();
+         }
+
+         injected_.fetch_sub(share + 1);
+         return task;
+      }
+
+      task_type* steal(worker *self)
+      {
+         std::size_t count = workers_.size();
+
+         // xorshift, a random first victim
+         self->seed ^= self->seed << 13;
+         self->seed ^= self->seed >> 17;
+         self->seed ^= self->seed << 5;
+
+         std::size_t first = self->seed % count;
+
+         for(std::size_t i = 0; i < count; ++i) {
+            worker *victim = workers_[(first + i) % count].get();
+
+            if(victim == self)
+               continue;
+
+            task_type *task = victim->deque.steal();
+            if(task)
+               return task;
+         }
+
+         return 0;
+      }
+
+      bool has_work() const
+      {
+         if(injected_.load() != 0)
+            return true;
+
+         for(std::size_t i = 0; i < workers_.size(); ++i) {
+            if(!workers_[i]->deque.empty())
+               return true;
+         }
+
+         return false;
+      }
+
+      void work(worker *self)
+      {
+         current_.reset(self);
+
+         for(;;) {
+            // the safe point, no task is running
+            if(paused_.load(boost::memory_order_relaxed))
+               park();
+
+            task_type *task = next(self);
+
+            if(task) {
+               execute(task);
+               continue;
+            }
+
+            // a steal can fail on a race, look again before sleep
+            if(has_work())
+               continue;
+
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            idle_.fetch_add(1);
+
+            while(!has_work()) {
+               if(stopping_.load() && pending_.load() == 0) {
+                  idle_.fetch_sub(1);
+                  current_.reset();
+                  return;
+               }
+
+               idle_cond_.wait(lock);
+            }
+
+            idle_.fetch_sub(1);
+         }
+      }
+
+      void park()
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+
+         while(paused_.load() && !stopping_.load())
+            cond_.wait(lock);
+      }
+
+   private:
+
+      std::vector<csbl::shared_ptr<worker> > workers_;
+      std::vector<csbl::shared_ptr<csbl::thread> > threads_;
+
+      boost::thread_specific_ptr<worker> current_;
+
+      // the tasks added and not done yet
+      boost::atomic<std::size_t> pending_;
+
+      boost::mutex injected_mutex_;
+      std::deque<task_type*> injected_queue_;
+      boost::atomic<std::size_t> injected_;
+
+      // drain() and the parked workers wait on cond_, the idle workers
+      // on idle_cond_, so a single task wake up always reaches an idle
+      // worker
+      boost::mutex mutex_;
+      boost::condition_variable cond_;
+      boost::condition_variable idle_cond_;
+      boost::atomic<std::size_t> idle_;
+      boost::atomic<bool> stopping_;
+      boost::atomic<bool> paused_;
+
+   }; // work_queue
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_WORK_QUEUE_ASPECT_HPP
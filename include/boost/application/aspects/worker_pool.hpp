@@ -0,0 +1,234 @@
+// worker_pool.hpp -----------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 29-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_WORKER_POOL_ASPECT_HPP
+#define BOOST_APPLICATION_WORKER_POOL_ASPECT_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/detail/csbl.hpp>
+
+#include <sys/socket.h>
+
+namespace boost { namespace application {
+
+   namespace posix {
+
+      /*!
+       * \brief POSIX platform specific aspect that configure the worker
+       *        processes of prefork_server application mode.
+       *
+       * On master, it holds the configuration, on each worker it
+       * also tells the index of worker.
+       *
+       * \b Examples:
+       * \code
+       * csbl::shared_ptr<application::worker_pool> pool =
+       *    boost::make_shared<application::worker_pool>(8);
+       *
+       * pool->backoff(100, 30000);
+       * context.insert<application::worker_pool>(pool);
+       *
+       * application::launch<application::prefork_server>(app, context);
+       * \endcode
+       */
+      class worker_pool
+      {
+      public:
+
+         /*!
+          * Constructs a worker_pool.
+          *
+          * \param workers The number of worker processes, 0 is one for
+          *        each core (hardware_concurrency).
+          */
+         explicit worker_pool(std::size_t workers = 0)
+            : workers_(workers)
+            , pin_to_cpu_(true)
+            , daemonize_(true)
+            , initial_backoff_(100)
+            , max_backoff_(30000)
+            , grace_period_(30000)
+            , worker_index_(-1)
+         {
+            if(!workers_)
+               workers_ = csbl::thread::hardware_concurrency();
+
+            if(!workers_)
+               workers_ = 1;
+         }
+
+         std::size_t workers() const
+         {
+            return workers_;
+         }
+
+         /*!
+          * Pin each worker to a CPU (Linux only), default true.
+          */
+         void pin_to_cpu(bool pin)
+         {
+            pin_to_cpu_ = pin;
+         }
+
+         bool pin_to_cpu() const
+         {
+            return pin_to_cpu_;
+         }
+
+         /*!
+          * Daemonize the master before fork workers, default true. Can be
+          * disabled when the process is supervised (e.g. systemd).
+          */
+         void daemonize(bool daemonize)
+         {
+            daemonize_ = daemonize;
+         }
+
+         bool daemonize() const
+         {
+            return daemonize_;
+         }
+
+         /*!
+          * A worker that exits is restarted after a delay, that is doubled
+          * on each fast consecutive failure, from initial to max
+          * milliseconds. A worker that ran for max milliseconds resets the
+          * delay. Default 100 ms to 30 s.
+          */
+         void backoff(int initial_milliseconds, int max_milliseconds)
+         {
+            initial_backoff_ = initial_milliseconds;
+            max_backoff_ = max_milliseconds;
+         }
+
+         int initial_backoff() const
+         {
+            return initial_backoff_;
+         }
+
+         int max_backoff() const
+         {
+            return max_backoff_;
+         }
+
+         /*!
+          * On termination, the workers still alive this many milliseconds
+          * after SIGTERM are killed (SIGKILL). Default 30 s, it should be
+          * longer than the time a worker needs to drain.
+          */
+         void grace_period(int milliseconds)
+         {
+            grace_period_ = milliseconds;
+         }
+
+         int grace_period() const
+         {
+            return grace_period_;
+         }
+
+         /*!
+          * The index of this worker, from 0 to workers() - 1, -1 on
+          * master. It is set by prefork_server.
+          */
+         int worker_index() const
+         {
+            return worker_index_;
+         }
+
+         void worker_index(int index)
+         {
+            worker_index_ = index;
+         }
+
+         bool is_worker() const
+         {
+            return worker_index_ >= 0;
+         }
+
+         /*!
+          * Creates a listening socket for this worker, bound with
+          * SO_REUSEPORT (where available), so each worker has its own
+          * accept queue. Sockets opened before launch are shared by all
+          * workers (one accept queue) and don't need this.
+          */
+         csbl::shared_ptr<boost::asio::ip::tcp::acceptor> listen(
+            boost::asio::io_service &io_service,
+            const boost::asio::ip::tcp::endpoint &endpoint,
+            boost::system::error_code &ec)
+         {
+            csbl::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor(
+               new boost::asio::ip::tcp::acceptor(io_service));
+
+            acceptor->open(endpoint.protocol(), ec);
+            if(ec) return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+
+            acceptor->set_option(
+               boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+            if(ec) return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+
+#if defined( SO_REUSEPORT )
+            typedef boost::asio::detail::socket_option::boolean<
+               SOL_SOCKET, SO_REUSEPORT> reuse_port;
+
+            acceptor->set_option(reuse_port(true), ec);
+            if(ec) return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+#endif
+
+            acceptor->bind(endpoint, ec);
+            if(ec) return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+
+            acceptor->listen(boost::asio::socket_base::max_connections, ec);
+            if(ec) return csbl::shared_ptr<boost::asio::ip::tcp::acceptor>();
+
+            return acceptor;
+         }
+
+         csbl::shared_ptr<boost::asio::ip::tcp::acceptor> listen(
+            boost::asio::io_service &io_service,
+            const boost::asio::ip::tcp::endpoint &endpoint)
+         {
+            boost::system::error_code ec;
+
+            csbl::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor =
+               listen(io_service, endpoint, ec);
+
+            if(ec) BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "listen() failed", ec);
+
+            return acceptor;
+         }
+
+      private:
+
+         std::size_t workers_;
+         bool pin_to_cpu_;
+         bool daemonize_;
+         int initial_backoff_;
+         int max_backoff_;
+         int grace_period_;
+         int worker_index_;
+
+      }; // worker_pool
+
+   } // posix
+
+// platform usage
+#if defined( BOOST_POSIX_API )
+   using posix::worker_pool;
+#endif
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_WORKER_POOL_ASPECT_HPP
@@ -64,8 +64,8 @@ namespace boost { namespace application {
     * The available handlers are:
     *
     * - stop
-    * - pause (windows only)
-    * - resume (windows only)
+    * - pause (windows, or a signal on posix)
+    * - resume (windows, or a signal on posix)
     * - instace_aready_running
     *
     * Functor class methods (to handler) signature:
@@ -85,12 +85,8 @@ namespace boost { namespace application {
          // handlers that we will check
          // (look for, rule)
          MEMBER_HANDLER_EXIST(stop, has_stop); 
-         // platform dependent 
-         // pause and resume is only available on windows
-#        if defined( BOOST_WINDOWS_API )
          MEMBER_HANDLER_EXIST(pause, has_pause); 
          MEMBER_HANDLER_EXIST(resume, has_resume); 
-#        endif
          MEMBER_HANDLER_EXIST(instace_aready_running, has_single_instance); 
       };
 
@@ -211,9 +207,7 @@ namespace boost { namespace application {
                            > )));
          }
   
-         // platform dependent
-         // pause and resume is only available on windows     
-#        if defined( BOOST_WINDOWS_API )   
+         // pause and resume (on posix, bound to signals by signal_manager)
          if(has_pause<Application, bool(Application::*)()>::value) {
             cxt.insert<pause_handler>(
                csbl::make_shared<pause_handler_default_behaviour>(
@@ -231,7 +225,6 @@ namespace boost { namespace application {
                         has_resume<Application, bool(Application::*)()>::value
                            > )));
          }
-#        endif  
 
       }
 
@@ -260,9 +253,6 @@ namespace boost { namespace application {
          return false; 
       } 
     
-      // platform dependent
-      // pause and resume is only available on windows       
-#     if defined( BOOST_WINDOWS_API ) 
       // pause
 
       template<bool Enable>  
@@ -290,7 +280,6 @@ namespace boost { namespace application {
          resume_handler_() {
          return false; 
       }
-#     endif  
 
       // single_instance
 
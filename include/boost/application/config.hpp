@@ -116,6 +116,18 @@
 #   endif
 #endif
 
+// signalfd(2) backend of signal_binder is available on linux,
+// define BOOST_APPLICATION_NO_SIGNALFD to disable it.
+#if BOOST_OS_LINUX && !defined(BOOST_APPLICATION_NO_SIGNALFD)
+#   define BOOST_APPLICATION_HAS_SIGNALFD
+#endif
+
+// eventfd(2) backend of selfpipe is available on linux,
+// define BOOST_APPLICATION_NO_EVENTFD to use a pipe.
+#if BOOST_OS_LINUX && !defined(BOOST_APPLICATION_NO_EVENTFD)
+#   define BOOST_APPLICATION_HAS_EVENTFD
+#endif
+
 // check if compiler provide some STL features of c++11
 // that we use by the library, else use boost.
 
@@ -160,6 +172,7 @@
 // on functin/method scope.
 #define BOOST_APPLICATION_FEATURE_SELECT                                                             \
    using BOOST_APPLICATION_FEATURE_HDR_MEMORY_NS_SELECT::make_shared;                                \
+   using BOOST_APPLICATION_FEATURE_HDR_MEMORY_NS_SELECT::allocate_shared;                            \
    using BOOST_APPLICATION_FEATURE_HDR_MEMORY_NS_SELECT::shared_ptr;                                 \
    using BOOST_APPLICATION_FEATURE_HDR_TYPEINDEX_NS_SELECT::BOOST_APPLICATION_TYPE_INDEX_NS_SELECT;  \
    using BOOST_APPLICATION_FEATURE_HDR_UNORDERED_MAP_NS_SELECT::unordered_map;                       \
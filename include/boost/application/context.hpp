@@ -45,7 +45,9 @@
 #include <boost/application/config.hpp>
 #include <boost/application/detail/csbl.hpp>
 #include <boost/application/aspect_map.hpp>
+#include <boost/atomic.hpp>
 #include <boost/thread/shared_lock_guard.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/core/noncopyable.hpp>
 
 
@@ -63,10 +65,40 @@ namespace boost { namespace application {
       {
          static csbl::shared_ptr<T> ptr;
          static boost::shared_mutex lock;
+
+         // bumped (with lock held) each time ptr is changed,
+         // invalidates the per thread caches
+         static boost::atomic<unsigned long> generation;
       };
 
       template <class T> csbl::shared_ptr<T> T_instance<T>::ptr;
       template <class T> boost::shared_mutex T_instance<T>::lock;
+      template <class T> boost::atomic<unsigned long> T_instance<T>::generation(1);
+
+      // per thread copy of T_instance<T>::ptr, it don't own the instance,
+      // it is only valid while generation is the current one
+
+      template <class T> struct T_instance_cache
+      {
+         T_instance_cache() : generation(0), ptr(0) {}
+
+         unsigned long generation;
+         T* ptr;
+
+         static T_instance_cache& this_thread() {
+#if !defined(BOOST_NO_CXX11_THREAD_LOCAL)
+            static thread_local T_instance_cache cache;
+            return cache;
+#else
+            static boost::thread_specific_ptr<T_instance_cache> cache;
+
+            if(!cache.get())
+               cache.reset(new T_instance_cache());
+
+            return *cache;
+#endif
+         }
+      };
 
    } // application::detail
 
@@ -90,7 +122,52 @@ namespace boost { namespace application {
       : public aspect_map, noncopyable
    {
    public:
-      // nothing here! Reserved for future use.
+      basic_context() {}
+
+      /*!
+       * Constructs a context that keeps its aspects on arena
+       * (see aspect_map::emplace), e.g. a context per request.
+       *
+       * The arena must outlive the context.
+       */
+      explicit basic_context(aspect_arena& arena)
+         : aspect_map(arena) {}
+
+      /*!
+       * Constructs a child context of parent, that overlays it: the
+       * aspects that are not found on the child are looked up on parent,
+       * and the aspects added to the child are only visible on it.
+       *
+       * The parent must outlive the child.
+       *
+       * \b Examples:
+       * \code
+       * void handle_request(application::context& module)
+       * {
+       *    application::context request(&module);
+       *    request.insert<my_request>(csbl::make_shared<my_request>());
+       *
+       *    // found on module
+       *    request.find<application::path>();
+       * }
+       * \endcode
+       */
+      explicit basic_context(aspect_map* parent)
+         : aspect_map(parent) {}
+
+      basic_context(aspect_map* parent, aspect_arena& arena)
+         : aspect_map(parent, arena) {}
+
+      /*!
+       * Constructs a child context of parent, that is kept alive by the
+       * child, e.g. a child of global_context::get().
+       */
+      explicit basic_context(const csbl::shared_ptr<aspect_map>& parent)
+         : aspect_map(parent) {}
+
+      basic_context(const csbl::shared_ptr<aspect_map>& parent,
+                    aspect_arena& arena)
+         : aspect_map(parent, arena) {}
    };
 
    class global_context : public basic_context
@@ -121,6 +198,8 @@ namespace boost { namespace application {
          }
 
          instance_t::ptr.reset(new context_t());
+         instance_t::generation++;
+
          return instance_t::ptr;
       }
 	  
@@ -145,6 +224,7 @@ namespace boost { namespace application {
          }
 
          instance_t::ptr.reset();
+         instance_t::generation++;
       }
 
       static inline csbl::shared_ptr<global_context> get() {
@@ -171,13 +251,99 @@ namespace boost { namespace application {
 
          return instance_t::ptr;
       }
+
+      /*!
+       * Fast accessor to global context, intended to be called very
+       * often (e.g. by a this_application() function).
+       *
+       * Each thread caches the global context, the cache is
+       * invalidated when the global context is created or destroyed, so
+       * the common call is a couple of plain loads, without lock or
+       * refcount.
+       *
+       * The cache don't own the context, the returned pointer is valid
+       * until destroy() is called, so destroy() shall not run while
+       * other threads are still using it. Hold get() (or a read_guard)
+       * to keep the context alive across a destroy().
+       *
+       * \return A pointer to global context.
+       * \throw boost::system::system_error if there is no global context.
+       */
+      static inline global_context* instance() {
+         boost::system::error_code ec;
+         global_context* cxt = instance(ec);
+
+         if(ec)
+            BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC("there is no global context", ec);
+
+         return cxt;
+      }
+
+      static inline global_context* instance(boost::system::error_code &ec) BOOST_NOEXCEPT {
+         cache_t& cache = cache_t::this_thread();
+
+         ec.clear();
+         if(cache.ptr &&
+            cache.generation == instance_t::generation.load(boost::memory_order_acquire))
+            return cache.ptr;
+
+         // refresh, the generation is only changed with the lock held
+         boost::shared_lock_guard<boost::shared_mutex> s_guard(instance_t::lock);
+
+         cache.ptr = instance_t::ptr.get();
+         cache.generation = instance_t::generation.load(boost::memory_order_relaxed);
+
+         if(!cache.ptr) {
+            ec = boost::system::error_code(
+                 boost::system::errc::bad_file_descriptor,
+                 boost::system::generic_category()
+                 );
+         }
+
+         return cache.ptr;
+      }
 	  
+      /*!
+       * \brief A read_guard on the global context.
+       *
+       * Holds the global context (so destroy() don't delete it while the
+       * guard is alive) and pins its aspects, then find_ref can be used on
+       * hot paths without any refcount or lock.
+       *
+       * \b Examples:
+       * \code
+       * application::global_context::read_guard guard;
+       * my_aspect* asp = guard.find_ref<my_aspect>();
+       * \endcode
+       *
+       * \throw boost::system::system_error if there is no global context.
+       */
+      class read_guard : boost::noncopyable {
+      public:
+         read_guard()
+            : context_(global_context::get()), guard_(*context_) {}
+
+         global_context& context() const {
+            return *context_;
+         }
+
+         template <class T>
+         T* find_ref() const {
+            return context_->find_ref<T>(guard_);
+         }
+
+      private:
+         csbl::shared_ptr<global_context> context_;
+         aspect_map::read_guard guard_;
+      };
+
    protected:
       global_context() { }
 	  
    private:
       typedef global_context context_t;
       typedef detail::T_instance<context_t> instance_t;
+      typedef detail::T_instance_cache<context_t> cache_t;
       typedef csbl::shared_ptr<context_t> context_ptr_t;
 	  
       static inline bool already_created() {
@@ -0,0 +1,160 @@
+// epoch.hpp -----------------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 12-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_DETAIL_EPOCH_HPP
+#define BOOST_APPLICATION_DETAIL_EPOCH_HPP
+
+#include <vector>
+
+#include <boost/application/config.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/core/noncopyable.hpp>
+
+namespace boost { namespace application { namespace detail {
+
+   // Epoch based reclamation of objects that was published through an
+   // atomic pointer (e.g.: the aspect_map table).
+   //
+   // Readers enter the domain before load the pointer and leave after they
+   // are done with the object, they never block, they only increment and
+   // decrement a counter that is sharded by thread.
+   //
+   // A writer (writers must be serialized by the user) unpublish the
+   // object and retire it, the object is deleted when there is no more
+   // readers that entered before the retire. Writers never wait for
+   // readers, objects that can't be deleted yet are kept and deleted on a
+   // next retire or on domain destruction.
+
+   template <class T>
+   class epoch_domain : noncopyable
+   {
+      enum { shards = 8 };
+
+      // each counter is on its own cache line
+      struct counter {
+         boost::atomic<unsigned> value;
+         char pad[64 - sizeof(boost::atomic<unsigned>)];
+      };
+
+   public:
+
+      // identify the counter used by a reader
+      typedef unsigned token;
+
+      epoch_domain()
+         : current_(0) {
+         for(unsigned e = 0; e < 2; ++e)
+            for(unsigned s = 0; s < shards; ++s)
+               counters_[e][s].value.store(0, boost::memory_order_relaxed);
+      }
+
+      ~epoch_domain() {
+         // no readers at this point
+         for(unsigned e = 0; e < 2; ++e)
+            reclaim(e);
+      }
+
+      token enter() {
+         unsigned e = current_.load(boost::memory_order_seq_cst);
+         unsigned s = shard();
+
+         counters_[e][s].value.fetch_add(1, boost::memory_order_seq_cst);
+         return e * shards + s;
+      }
+
+      void leave(token t) {
+         counters_[t / shards][t % shards].value.fetch_sub(
+            1, boost::memory_order_release);
+      }
+
+      // the object need be unpublished before retire
+      void retire(T* p) {
+         retired_[current_.load(boost::memory_order_relaxed)].push_back(p);
+         collect();
+      }
+
+      // RAII reader
+      class reader : noncopyable {
+      public:
+         explicit reader(epoch_domain& d)
+            : domain_(d), token_(d.enter()) {}
+
+         ~reader() {
+            domain_.leave(token_);
+         }
+
+      private:
+         epoch_domain& domain_;
+         token token_;
+      };
+
+   private:
+
+      static unsigned shard() {
+#if !defined(BOOST_NO_CXX11_THREAD_LOCAL)
+         static thread_local unsigned s = next_shard();
+         return s;
+#else
+         int local;
+         return unsigned(std::size_t(&local) >> 16) % shards;
+#endif
+      }
+
+      static unsigned next_shard() {
+         static boost::atomic<unsigned> next(0);
+         return next++ % shards;
+      }
+
+      unsigned readers(unsigned e) {
+         unsigned n = 0;
+         for(unsigned s = 0; s < shards; ++s)
+            n += counters_[e][s].value.load(boost::memory_order_seq_cst);
+
+         return n;
+      }
+
+      void reclaim(unsigned e) {
+         for(std::size_t i = 0; i < retired_[e].size(); ++i)
+            delete retired_[e][i];
+
+         retired_[e].clear();
+      }
+
+      // the epoch is only flipped when there is no reader on the other
+      // epoch, so when the readers of an epoch are gone, all objects retired
+      // before the flip that started it can be deleted.
+      void collect() {
+         for(unsigned i = 0; i < 2; ++i) {
+            unsigned e = current_.load(boost::memory_order_relaxed);
+
+            if(readers(1 - e))
+               return;
+
+            reclaim(1 - e);
+            current_.store(1 - e, boost::memory_order_seq_cst);
+         }
+      }
+
+      boost::atomic<unsigned> current_;
+      counter counters_[2][shards];
+
+      // objects retired on each epoch
+      std::vector<T*> retired_[2];
+   };
+
+}}} // boost::application::detail
+
+#endif // BOOST_APPLICATION_DETAIL_EPOCH_HPP
@@ -0,0 +1,138 @@
+// close_fds_impl.hpp --------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 26-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_IMPL_POSIX_CLOSE_FDS_IMPL_HPP
+#define BOOST_APPLICATION_IMPL_POSIX_CLOSE_FDS_IMPL_HPP
+
+#include <boost/application/config.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+#if BOOST_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace boost { namespace application { namespace detail {
+
+   // Close all descriptors of process starting at lowfd, but the ones
+   // in keep (that need be sorted).
+   //
+   // There are 3 ways, from the fastest:
+   //
+   // close_fds_range: close_range(2), Linux 5.9, one syscall for each
+   //                  range between kept descriptors.
+   // close_fds_proc:  close only the open descriptors, listed on
+   //                  /proc/self/fd.
+   // close_fds_loop:  close every descriptor up to RLIMIT_NOFILE, that can
+   //                  be milions of syscalls.
+   //
+   // Each one return false if it can't be used here.
+
+#if BOOST_OS_LINUX && !defined(SYS_close_range) && defined(__NR_close_range)
+#   define SYS_close_range __NR_close_range
+#endif
+
+   inline bool close_fds_range(int lowfd, const std::vector<int> &keep) {
+#if defined(SYS_close_range)
+      unsigned int first = lowfd;
+
+      for(std::vector<int>::const_iterator it = keep.begin(); it != keep.end(); ++it) {
+         if(*it < lowfd || (unsigned int)*it < first)
+            continue;
+
+         if((unsigned int)*it > first && syscall(SYS_close_range, first, *it - 1, 0) != 0)
+            return false;
+
+         first = *it + 1;
+      }
+
+      return syscall(SYS_close_range, first, ~0U, 0) == 0;
+#else
+      return false;
+#endif
+   }
+
+   inline bool close_fds_proc(int lowfd, const std::vector<int> &keep) {
+      DIR *dir = opendir("/proc/self/fd");
+
+      if(!dir)
+         return false;
+
+      // collect first, close after, so the directory is not changed
+      // while it is read
+      std::vector<int> fds;
+
+      for(struct dirent *entry = readdir(dir); entry; entry = readdir(dir)) {
+         if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            continue; // "." and ".."
+
+         int fd = std::atoi(entry->d_name);
+
+         if(fd >= lowfd && fd != dirfd(dir)
+            && !std::binary_search(keep.begin(), keep.end(), fd))
+            fds.push_back(fd);
+      }
+
+      closedir(dir);
+
+      for(std::vector<int>::const_iterator it = fds.begin(); it != fds.end(); ++it)
+         close(*it);
+
+      return true;
+   }
+
+   inline bool close_fds_loop(int lowfd, const std::vector<int> &keep) {
+      struct rlimit rl;
+
+      if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
+         return false;
+
+      if (rl.rlim_max == RLIM_INFINITY)
+      {
+         rl.rlim_max = 1024;
+      }
+
+      for (int i = lowfd; i < (int)rl.rlim_max; i++)
+      {
+         if(!std::binary_search(keep.begin(), keep.end(), i))
+            close(i);
+      }
+
+      return true;
+   }
+
+   inline void close_fds(int lowfd, std::vector<int> keep, boost::system::error_code &ec) {
+      ec.clear();
+
+      std::sort(keep.begin(), keep.end());
+
+      if(close_fds_range(lowfd, keep)
+         || close_fds_proc(lowfd, keep)
+         || close_fds_loop(lowfd, keep))
+         return;
+
+      ec = last_error_code();
+   }
+
+}}} // boost::application::detail
+
+#endif // BOOST_APPLICATION_IMPL_POSIX_CLOSE_FDS_IMPL_HPP
@@ -0,0 +1,166 @@
+// cpu_affinity_impl.hpp -----------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 30-05-2014 dd-mm-yyyy - Initial Release
+// 01-06-2014 dd-mm-yyyy - current_cpu
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_IMPL_POSIX_CPU_AFFINITY_IMPL_HPP
+#define BOOST_APPLICATION_IMPL_POSIX_CPU_AFFINITY_IMPL_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/system_error.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace boost { namespace application { namespace detail {
+
+#if BOOST_OS_LINUX
+
+   // parse a sysfs cpu list, e.g.: "0-3,8-11"
+   inline std::vector<int> parse_cpu_list(const std::string &list) {
+      std::vector<int> cpus;
+      std::istringstream in(list);
+      std::string range;
+
+      while(std::getline(in, range, ',')) {
+         std::string::size_type dash = range.find('-');
+
+         int first = std::atoi(range.c_str());
+         int last = dash == std::string::npos
+            ? first : std::atoi(range.c_str() + dash + 1);
+
+         for(int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+      }
+
+      return cpus;
+   }
+
+   // the allowed cpus of each NUMA node, empty if there is only one node
+   inline std::vector< std::vector<int> > numa_nodes(const cpu_set_t &allowed) {
+      std::vector< std::vector<int> > nodes;
+
+      for(int node = 0; ; ++node) {
+         std::ostringstream name;
+         name << "/sys/devices/system/node/node" << node << "/cpulist";
+
+         std::ifstream file(name.str().c_str());
+         if(!file)
+            break;
+
+         std::string list;
+         std::getline(file, list);
+
+         std::vector<int> all = parse_cpu_list(list), cpus;
+         for(std::size_t i = 0; i < all.size(); ++i) {
+            if(all[i] < CPU_SETSIZE && CPU_ISSET(all[i], &allowed))
+               cpus.push_back(all[i]);
+         }
+
+         if(!cpus.empty())
+            nodes.push_back(cpus);
+      }
+
+      if(nodes.size() < 2)
+         nodes.clear();
+
+      return nodes;
+   }
+
+#endif
+
+   // The cpus that the process can use, in the order that threads should
+   // be placed on them. When numa_aware is set, consecutive threads are
+   // spread on the NUMA nodes (round robin), so load is balanced between
+   // memory controllers. Empty if affinity is not supported.
+   inline std::vector<int> allowed_cpus(bool numa_aware) {
+      std::vector<int> cpus;
+
+#if BOOST_OS_LINUX
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+
+      if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+         return cpus;
+
+      std::vector< std::vector<int> > nodes;
+      if(numa_aware)
+         nodes = numa_nodes(allowed);
+
+      if(nodes.empty()) {
+         for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if(CPU_ISSET(cpu, &allowed))
+               cpus.push_back(cpu);
+         }
+
+         return cpus;
+      }
+
+      for(std::size_t i = 0; ; ++i) {
+         bool more = false;
+
+         for(std::size_t n = 0; n < nodes.size(); ++n) {
+            if(i < nodes[n].size()) {
+               cpus.push_back(nodes[n][i]);
+               more = true;
+            }
+         }
+
+         if(!more)
+            break;
+      }
+#else
+      (void) numa_aware;
+#endif
+
+      return cpus;
+   }
+
+   // pin the calling thread to cpu
+   inline void pin_current_thread(int cpu, boost::system::error_code &ec) {
+      ec.clear();
+
+#if BOOST_OS_LINUX
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+
+      int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      if(result != 0)
+         ec = boost::system::error_code(result, boost::system::system_category());
+#else
+      (void) cpu;
+      ec = boost::system::error_code(
+         boost::system::errc::not_supported, boost::system::generic_category());
+#endif
+   }
+
+   // the cpu running the calling thread, -1 if not supported
+   inline int current_cpu() {
+#if BOOST_OS_LINUX
+      return sched_getcpu();
+#else
+      return -1;
+#endif
+   }
+
+}}} // boost::application::detail
+
+#endif // BOOST_APPLICATION_IMPL_POSIX_CPU_AFFINITY_IMPL_HPP
@@ -0,0 +1,211 @@
+// fd_passing_impl.hpp -------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 28-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_IMPL_POSIX_FD_PASSING_IMPL_HPP
+#define BOOST_APPLICATION_IMPL_POSIX_FD_PASSING_IMPL_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/cstdint.hpp>
+
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace boost { namespace application { namespace detail {
+
+   // Pass descriptors and a blob over an unix socket (SCM_RIGHTS).
+   //
+   // The message is a header {count of descriptors, size of blob}, that
+   // carries the descriptors, followed by the blob.
+
+   // SCM_MAX_FD of Linux
+   static const std::size_t max_passed_fds = 253;
+
+   struct fd_passing_header {
+      boost::uint32_t fds;
+      boost::uint32_t size;
+   };
+
+   inline bool send_all(int socket, const char *data, std::size_t size,
+                         boost::system::error_code &ec) {
+      while(size) {
+         ssize_t r = ::send(socket, data, size, MSG_NOSIGNAL);
+
+         if(r == -1 && errno == EINTR)
+            continue;
+
+         if(r <= 0) {
+            ec = last_error_code();
+            return false;
+         }
+
+         data += r;
+         size -= r;
+      }
+
+      return true;
+   }
+
+   inline bool receive_all(int socket, char *data, std::size_t size,
+                        boost::system::error_code &ec) {
+      while(size) {
+         ssize_t r = ::recv(socket, data, size, 0);
+
+         if(r == -1 && errno == EINTR)
+            continue;
+
+         if(r == 0) {
+            // peer closed
+            ec = boost::system::error_code(
+               boost::system::errc::connection_aborted,
+               boost::system::generic_category());
+            return false;
+         }
+
+         if(r < 0) {
+            ec = last_error_code();
+            return false;
+         }
+
+         data += r;
+         size -= r;
+      }
+
+      return true;
+   }
+
+   inline void send_fds(int socket, const std::vector<int> &fds,
+                        const std::string &blob, boost::system::error_code &ec) {
+      ec.clear();
+
+      if(fds.size() > max_passed_fds) {
+         ec = boost::system::error_code(
+            boost::system::errc::argument_list_too_long,
+            boost::system::generic_category());
+         return;
+      }
+
+      fd_passing_header header;
+      header.fds = (boost::uint32_t)fds.size();
+      header.size = (boost::uint32_t)blob.size();
+
+      struct iovec iov;
+      iov.iov_base = &header;
+      iov.iov_len = sizeof(header);
+
+      std::vector<char> control(CMSG_SPACE(sizeof(int) * max_passed_fds));
+
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+
+      if(!fds.empty()) {
+         msg.msg_control = &control[0];
+         msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+         struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+         cmsg->cmsg_level = SOL_SOCKET;
+         cmsg->cmsg_type = SCM_RIGHTS;
+         cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+         std::memcpy(CMSG_DATA(cmsg), &fds[0], sizeof(int) * fds.size());
+      }
+
+      ssize_t r;
+      while((r = ::sendmsg(socket, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+      {
+         // nothing here, restart when signal is catch
+      }
+
+      if(r != (ssize_t)sizeof(header)) {
+         ec = last_error_code();
+         return;
+      }
+
+      send_all(socket, blob.data(), blob.size(), ec);
+   }
+
+   // the received descriptors are close-on-exec
+   inline void receive_fds(int socket, std::vector<int> &fds,
+                           std::string &blob, boost::system::error_code &ec) {
+      ec.clear();
+
+      fd_passing_header header;
+
+      struct iovec iov;
+      iov.iov_base = &header;
+      iov.iov_len = sizeof(header);
+
+      std::vector<char> control(CMSG_SPACE(sizeof(int) * max_passed_fds));
+
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = &control[0];
+      msg.msg_controllen = control.size();
+
+      ssize_t r;
+      while((r = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR)
+      {
+         // nothing here, restart when signal is catch
+      }
+
+      if(r != (ssize_t)sizeof(header)) {
+         ec = r < 0 ? last_error_code() : boost::system::error_code(
+            boost::system::errc::connection_aborted,
+            boost::system::generic_category());
+         return;
+      }
+
+      fds.clear();
+
+      for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+         if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+         std::size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+         const int *data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+
+         fds.insert(fds.end(), data, data + count);
+      }
+
+      if(fds.size() != header.fds || (msg.msg_flags & MSG_CTRUNC)) {
+         for(std::size_t i = 0; i < fds.size(); ++i)
+            ::close(fds[i]);
+
+         fds.clear();
+
+         ec = boost::system::error_code(
+            boost::system::errc::protocol_error,
+            boost::system::generic_category());
+         return;
+      }
+
+      blob.resize(header.size);
+
+      if(header.size)
+         receive_all(socket, &blob[0], header.size, ec);
+   }
+
+}}} // boost::application::detail
+
+#endif // BOOST_APPLICATION_IMPL_POSIX_FD_PASSING_IMPL_HPP
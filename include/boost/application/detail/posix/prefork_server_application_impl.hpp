@@ -0,0 +1,516 @@
+// prefork_server_application_impl.hpp ---------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 29-05-2014 dd-mm-yyyy - Initial Release
+// 31-05-2014 dd-mm-yyyy - workers forked by a single threaded fork server
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_PREFORK_SERVER_APPLICATION_IMPL_HPP
+#define BOOST_APPLICATION_PREFORK_SERVER_APPLICATION_IMPL_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/context.hpp>
+#include <boost/application/detail/posix/server_application_impl.hpp>
+#include <boost/application/aspects/worker_pool.hpp>
+#include <boost/application/aspects/status.hpp>
+#include <boost/application/aspects/process_id.hpp>
+
+#include <boost/chrono.hpp>
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+namespace boost { namespace application {
+
+   // The master daemonizes, and forks a fork server before it starts its
+   // signal_binder, so the fork server has a single thread. The fork
+   // server forks the workers, reaps them and restarts the ones that
+   // exit, so a worker is never forked by a process whose other threads
+   // can hold a lock (e.g. of aspect_map) at fork time. Each worker runs
+   // the application with its own signal_manager, so the termination
+   // signals sent to workers run the termination_handler of each worker.
+   //
+   // On termination the master closes the control pipe, then the fork
+   // server sends SIGTERM to the workers, kills (SIGKILL) the ones alive
+   // after the grace period, reaps them and exits. The pipe is closed
+   // too when the master dies.
+   //
+   // The fork server blocks the signals bound by the master, they would
+   // run the handlers of master (inherited), and the workers unblock
+   // them. On Linux the worker signal_manager uses signalfd, that don't
+   // use the global signal state of asio.
+
+   template <typename CharType>
+   class prefork_server_application_impl_
+      : public server_application_impl_<CharType>
+   {
+      typedef server_application_impl_<CharType> base_type;
+
+   public:
+
+      typedef typename base_type::mainop mainop;
+
+      prefork_server_application_impl_(const mainop &main, signal_binder &sb,
+         application::context &context, boost::system::error_code& ec)
+         : base_type(main, context)
+         , sb_(sb)
+         , pool_(context.find<worker_pool>())
+         , control_(-1)
+         , stopping_(false)
+      {
+         wake_[0] = wake_[1] = -1;
+
+         if(pool_->daemonize() && !this->daemonize_process(ec))
+            return;
+      }
+
+      int run()
+      {
+         int control[2];
+
+         if(pipe(control) != 0)
+            return EXIT_FAILURE;
+
+         // the buffered output would be written by master and fork server
+         std::fflush(0);
+
+         pid_t server = fork();
+
+         if(server == 0) {
+            ::close(control[1]);
+
+            int result = fork_server(control[0]);
+
+            std::fflush(0);
+            _exit(result);
+         }
+
+         ::close(control[0]);
+
+         if(server < 0) {
+            ::close(control[1]);
+            return EXIT_FAILURE;
+         }
+
+         sb_.start();
+
+         this->context_.template find<wait_for_termination_request>()->wait();
+
+         // termination, the fork server stops the workers and exits, after
+         // the grace period at most
+         ::close(control[1]);
+
+         while(waitpid(server, 0, 0) == -1 && errno == EINTR)
+         {
+            // nothing here, restart when signal is catch
+         }
+
+         return 0;
+      }
+
+   protected:
+
+      typedef boost::chrono::steady_clock clock_type;
+
+      struct slot {
+         slot() : pid(0), failures(0) {}
+
+         pid_t pid;
+         unsigned failures;
+         clock_type::time_point started;
+      };
+
+      // runs on the fork server, that has a single thread. Returns when
+      // the workers are gone after termination.
+      int fork_server(int control)
+      {
+         control_ = control;
+
+         sigset_t bound;
+         sigemptyset(&bound);
+
+         for(int i = 1; i < NSIG; ++i) {
+            if(sb_.is_bound(i))
+               sigaddset(&bound, i);
+         }
+
+         sigprocmask(SIG_BLOCK, &bound, &mask_);
+
+         // SIGCHLD wakes the poll
+         if(pipe(wake_) != 0)
+            return EXIT_FAILURE;
+
+         for(int i = 0; i < 2; ++i) {
+            fcntl(wake_[i], F_SETFL, fcntl(wake_[i], F_GETFL) | O_NONBLOCK);
+         }
+
+         wake_fd() = wake_[1];
+
+         struct sigaction sa;
+         std::memset(&sa, 0, sizeof(sa));
+         sa.sa_handler = &child_exited;
+         sigemptyset(&sa.sa_mask);
+         sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+
+         if(sigaction(SIGCHLD, &sa, 0) != 0)
+            return EXIT_FAILURE;
+
+         slots_.resize(pool_->workers());
+
+         // a worker never returns from spawn
+         for(std::size_t i = 0; i < slots_.size(); ++i)
+            spawn(i);
+
+         clock_type::time_point until;
+
+         for(;;) {
+            clock_type::time_point next =
+               stopping_ ? until : next_restart();
+
+            int timeout = -1;
+
+            if(next != clock_type::time_point::max()) {
+               boost::chrono::milliseconds left =
+                  boost::chrono::duration_cast<boost::chrono::milliseconds>(
+                     next - clock_type::now());
+
+               timeout = left.count() < 0 ? 0 : (int) left.count() + 1;
+            }
+
+            // the control pipe is at end of file when stopping
+            pollfd fds[2] = { { wake_[0], POLLIN, 0 }, { control_, POLLIN, 0 } };
+
+            int r = ::poll(fds, stopping_ ? 1 : 2, timeout);
+
+            if(r == -1 && errno != EINTR)
+               return EXIT_FAILURE;
+
+            char buffer[64];
+            while(::read(wake_[0], buffer, sizeof(buffer)) > 0)
+            {
+               // nothing here, read until EAGAIN
+            }
+
+            // the master closed the pipe
+            if(!stopping_ && r > 0 && fds[1].revents) {
+               stopping_ = true;
+               until = clock_type::now()
+                  + boost::chrono::milliseconds(pool_->grace_period());
+
+               signal_workers(SIGTERM);
+            }
+
+            reap(WNOHANG);
+
+            if(stopping_) {
+               if(alive() == 0)
+                  return 0;
+
+               if(clock_type::now() >= until) {
+                  // the workers that ignore SIGTERM, or hang on shutdown
+                  signal_workers(SIGKILL);
+                  reap(0);
+                  return 0;
+               }
+
+               continue;
+            }
+
+            restart_due();
+         }
+      }
+
+      static void child_exited(int)
+      {
+         int saved = errno;
+
+         ssize_t r = ::write(wake_fd(), "", 1);
+         (void) r;
+
+         errno = saved;
+      }
+
+      static int& wake_fd()
+      {
+         static int fd = -1;
+         return fd;
+      }
+
+      void spawn(std::size_t index)
+      {
+         // the buffered output would be written by fork server and worker
+         std::fflush(0);
+
+         pid_t pid = fork();
+
+         if(pid == 0) {
+            int result = worker(index);
+
+            std::fflush(0);
+            _exit(result);
+         }
+
+         if(pid > 0) {
+            slots_[index].pid = pid;
+            slots_[index].started = clock_type::now();
+         }
+      }
+
+      int worker(std::size_t index)
+      {
+         application::context &context = this->context_;
+
+         // the state of fork server
+         ::close(control_);
+         ::close(wake_[0]);
+         ::close(wake_[1]);
+
+         signal(SIGCHLD, SIG_DFL);
+
+         pool_->worker_index((int)index);
+
+         if(pool_->pin_to_cpu())
+            pin(index);
+
+         // the aspects that have state of master process are replaced
+         context.template erase<wait_for_termination_request>();
+         context.template insert<wait_for_termination_request>(
+            csbl::shared_ptr<wait_for_termination_request>(
+               new wait_for_termination_request_default_behaviour));
+
+         context.template erase<process_id>();
+         context.template insert<process_id>(csbl::make_shared<process_id>());
+
+         context.template find<status>()->state(status::running);
+
+         // hot restart is driven by master, the trigger signal would be
+         // handled by the signal handler of master (inherited)
+         csbl::shared_ptr<hot_restart> restart =
+            context.template erase<hot_restart>();
+
+         if(restart)
+            signal(restart->trigger_signal(), SIG_DFL);
+
+         // the signals bound by master, blocked by fork server
+         sigprocmask(SIG_SETMASK, &mask_, 0);
+
+         // the signal thread is not joined, the worker exits with
+         // _exit, so it shares the ownership of signal_manager
+         boost::system::error_code ec;
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+         csbl::shared_ptr<signal_manager> sm(
+            new signal_manager(context, use_signalfd, ec));
+         if(ec) return EXIT_FAILURE;
+
+         csbl::thread signal_thread(
+            boost::bind(&prefork_server_application_impl_::poll_signals, sm));
+#else
+         csbl::shared_ptr<asio::io_service> io_service(new asio::io_service);
+
+         csbl::shared_ptr<signal_manager> sm(
+            new signal_manager(context, *io_service, ec));
+         if(ec) return EXIT_FAILURE;
+
+         // new pipe for the signal state of asio
+         io_service->notify_fork(asio::io_service::fork_child);
+
+         csbl::thread signal_thread(
+            boost::bind(&prefork_server_application_impl_::run_signals,
+               io_service, sm));
+#endif
+         signal_thread.detach();
+
+         return base_type::run();
+      }
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      static void poll_signals(csbl::shared_ptr<signal_manager> sm)
+      {
+         pollfd fd = { sm->native_handle(), POLLIN, 0 };
+         boost::system::error_code ec;
+
+         for(;;) {
+            if(::poll(&fd, 1, -1) > 0)
+               sm->poll(ec);
+         }
+      }
+#else
+      static void run_signals(csbl::shared_ptr<asio::io_service> io_service,
+         csbl::shared_ptr<signal_manager>)
+      {
+         io_service->run();
+      }
+#endif
+
+      void pin(std::size_t index)
+      {
+#if BOOST_OS_LINUX
+         cpu_set_t allowed;
+         CPU_ZERO(&allowed);
+
+         if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return;
+
+         int count = CPU_COUNT(&allowed);
+         if(!count)
+            return;
+
+         // the n-th allowed CPU
+         int n = (int)(index % count);
+
+         for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if(CPU_ISSET(cpu, &allowed) && n-- == 0) {
+               cpu_set_t set;
+               CPU_ZERO(&set);
+               CPU_SET(cpu, &set);
+
+               sched_setaffinity(0, sizeof(set), &set);
+               return;
+            }
+         }
+#endif
+      }
+
+      // reap the workers that exited, and schedule their restart
+      void reap(int options)
+      {
+         for(;;) {
+            int status_code = 0;
+            pid_t pid = waitpid(-1, &status_code, options);
+
+            if(pid == -1 && errno == EINTR)
+               continue;
+
+            // no worker exited (WNOHANG), or ECHILD
+            if(pid <= 0)
+               return;
+
+            std::size_t index = find(pid);
+            if(index == slots_.size())
+               continue; // not a worker
+
+            slot &s = slots_[index];
+            s.pid = 0;
+
+            if(stopping_)
+               continue;
+
+            // exponential backoff, reset if worker ran for a long time
+            boost::chrono::milliseconds ran =
+               boost::chrono::duration_cast<boost::chrono::milliseconds>(
+                  clock_type::now() - s.started);
+
+            if(ran.count() >= pool_->max_backoff())
+               s.failures = 0;
+
+            s.started = clock_type::now() + delay(s.failures);
+            s.failures++;
+         }
+      }
+
+      // restart the workers whose delay is over
+      void restart_due()
+      {
+         clock_type::time_point now = clock_type::now();
+
+         for(std::size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].pid == 0 && slots_[i].started <= now)
+               spawn(i);
+         }
+      }
+
+      // when the next worker is restarted, max if all are alive
+      clock_type::time_point next_restart() const
+      {
+         clock_type::time_point next = clock_type::time_point::max();
+
+         for(std::size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].pid == 0 && slots_[i].started < next)
+               next = slots_[i].started;
+         }
+
+         return next;
+      }
+
+      void signal_workers(int signal_number)
+      {
+         for(std::size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].pid > 0)
+               kill(slots_[i].pid, signal_number);
+         }
+      }
+
+      boost::chrono::milliseconds delay(unsigned failures) const
+      {
+         long long ms = pool_->initial_backoff();
+
+         for(unsigned i = 0; i < failures && ms < pool_->max_backoff(); ++i)
+            ms *= 2;
+
+         if(ms > pool_->max_backoff())
+            ms = pool_->max_backoff();
+
+         return boost::chrono::milliseconds(ms);
+      }
+
+      std::size_t find(pid_t pid) const
+      {
+         for(std::size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].pid == pid)
+               return i;
+         }
+
+         return slots_.size();
+      }
+
+      std::size_t alive() const
+      {
+         std::size_t count = 0;
+
+         for(std::size_t i = 0; i < slots_.size(); ++i) {
+            if(slots_[i].pid > 0)
+               count++;
+         }
+
+         return count;
+      }
+
+   private:
+
+      signal_binder &sb_;
+      csbl::shared_ptr<worker_pool> pool_;
+
+      // on fork server
+      int control_;
+      int wake_[2];
+      sigset_t mask_;
+      std::vector<slot> slots_;
+      bool stopping_;
+   };
+
+   /////////////////////////////////////////////////////////////////////////////
+   // prefork_server_application_impl
+   //
+
+   typedef prefork_server_application_impl_<character_types::char_type> prefork_server_application_impl;
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_PREFORK_SERVER_APPLICATION_IMPL_HPP
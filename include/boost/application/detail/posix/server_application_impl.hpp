@@ -10,6 +10,10 @@
 
 // Revision History
 // 22-10-2013 dd-mm-yyyy - Initial Release
+// 26-05-2014 dd-mm-yyyy - daemonize don't loop up to RLIMIT_NOFILE
+// 27-05-2014 dd-mm-yyyy - daemonize keep socket_activation sockets
+// 28-05-2014 dd-mm-yyyy - daemonize keep hot_restart sockets
+// 29-05-2014 dd-mm-yyyy - daemonize_process used by prefork_server
 
 /*
 ---  0---|--- 10---|--- 20---|--- 30---|--- 40---|--- 50---|--- 60---|--- 70---|--- 80---|--- 90---|
@@ -25,6 +29,9 @@
 #include <boost/application/context.hpp>
 #include <boost/application/detail/application_impl.hpp>
 #include <boost/application/signal_binder.hpp>
+#include <boost/application/aspects/inherited_fds.hpp>
+#include <boost/application/aspects/socket_activation.hpp>
+#include <boost/application/detail/posix/close_fds_impl.hpp>
 
 #include <boost/assert.hpp>
 #include <boost/function.hpp>
@@ -86,6 +93,29 @@ namespace boost { namespace application {
                                application::context &context, boost::system::error_code& ec)
          : application_impl(context)
          , main_(main)
+      {
+         if(!daemonize_process(ec))
+            return;
+         
+         sb.start(); // need be started after daemonize
+      }
+
+      int run()
+      {
+         return main_();
+      }
+
+   protected:
+
+      // don't daemonize, the derived mode calls daemonize_process
+      server_application_impl_(const mainop &main, application::context &context)
+         : application_impl(context)
+         , process_id_(0)
+         , main_(main)
+      {
+      }
+
+      bool daemonize_process(boost::system::error_code &ec)
       {
          // ver 1
 #if defined( USE_DAEMONIZE_VER_1 )
@@ -94,21 +124,13 @@ namespace boost { namespace application {
          if(daemon(0, 0, ec) < 0)
          {
             ec = last_error_code();
-            return;
+            return false;
          }
          
          process_id_ = getpid();
 #endif
-         
-         sb.start(); // need be started after daemonize
-      }
-
-      int run()
-      {
-         return main_();
+         return true;
       }
-
-   protected:
    
       //
       // ver 2
@@ -260,19 +282,12 @@ namespace boost { namespace application {
 
          // Ensure future opens won't allocate controlling TTYs.
 
-         struct rlimit rl;
          struct sigaction sa;
 
          sa.sa_handler = SIG_IGN;
          sigemptyset(&sa.sa_mask);
          sa.sa_flags = 0;
 
-         if (getrlimit(RLIMIT_NOFILE, &rl) < 0)
-         {
-            // can't get system resource consumption limits
-            ec = last_error_code(); return 0;
-         }
-
          if (sigaction(SIGHUP, &sa, NULL) < 0)
          {
             // can't ignore SIGHUP
@@ -297,22 +312,65 @@ namespace boost { namespace application {
             ec = last_error_code();
          }
 
-         // close all open file descriptors.
-         if (rl.rlim_max == RLIM_INFINITY)
+         // close all open file descriptors, but the inherited ones,
+         // the activated sockets and the hot restart ones.
+         std::vector<int> keep;
+
+         csbl::shared_ptr<inherited_fds> inherited =
+            context_.find<inherited_fds>();
+
+         if(inherited)
+            keep = inherited->fds();
+
+         csbl::shared_ptr<socket_activation> activation =
+            context_.find<socket_activation>();
+
+         if(activation)
+            keep.insert(keep.end(), activation->fds().begin(), activation->fds().end());
+
+         csbl::shared_ptr<hot_restart> restart =
+            context_.find<hot_restart>();
+
+         if(restart)
          {
-            rl.rlim_max = 1024;
+            keep.insert(keep.end(), restart->fds().begin(), restart->fds().end());
+
+            if(restart->channel() != -1)
+               keep.push_back(restart->channel());
+         }
+
+         boost::system::error_code close_ec;
+         detail::close_fds(3, keep, close_ec);
+
+         if(close_ec)
+         {
+            ec = close_ec; return 0;
          }
 
-         for (int i = 0; i < (int)rl.rlim_max; i++)
+         // this is the process to kill if the hot restart fails
+         if(restart)
          {
-            close(i);
+            restart->report_pid(ec);
+
+            if(ec)
+               return 0;
          }
 
          // Attach file descriptors 0, 1, and 2 to /dev/null.
 
-         open("/dev/null", O_RDWR);
-         dup(0);
-         dup(0);
+         int null_fd = open("/dev/null", O_RDWR);
+
+         if(null_fd < 0)
+         {
+            ec = last_error_code(); return 0;
+         }
+
+         dup2(null_fd, 0);
+         dup2(null_fd, 1);
+         dup2(null_fd, 2);
+
+         if(null_fd > 2)
+            close(null_fd);
 
          // clear any inherited file mode creation mask
          umask(0);
@@ -0,0 +1,204 @@
+// signalfd_impl.hpp ---------------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 18-05-2014 dd-mm-yyyy - Initial Release
+// 04-06-2014 dd-mm-yyyy - Check the mask of other threads
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_IMPL_POSIX_SIGNALFD_IMPL_HPP
+#define BOOST_APPLICATION_IMPL_POSIX_SIGNALFD_IMPL_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/signalfd.h>
+
+namespace boost { namespace application {
+
+   // Linux signalfd(2) backend of signal_binder.
+   //
+   // The signals handled by the descriptor are blocked (pthread_sigmask)
+   // on calling thread, and are inherited by threads created after, so the
+   // signals should be bound before the application threads are created
+   // (or blocked first on main, see block_signals).
+   // A thread that don't block the signal would take it with the default
+   // action (e.g. terminate on SIGTERM), so add() fails with
+   // operation_not_permitted if any other thread of process don't block
+   // it.
+   // Only signals directed to process, or to the thread that reads the
+   // descriptor, are read.
+
+   class signalfd_impl : noncopyable
+   {
+   public:
+
+      signalfd_impl()
+         : fd_(-1) {
+         sigemptyset(&mask_);
+      }
+
+      ~signalfd_impl() {
+         if(fd_ != -1)
+            ::close(fd_);
+      }
+
+      void add(int signal_number, boost::system::error_code &ec) {
+         ec.clear();
+
+         if(!mask(SIG_BLOCK, signal_number, ec))
+            return;
+
+         if(!blocked_by_all_threads(signal_number)) {
+            ec = boost::system::error_code(
+                 boost::system::errc::operation_not_permitted,
+                 boost::system::generic_category()
+                 );
+
+            if(!sigismember(&mask_, signal_number)) {
+               boost::system::error_code ignored;
+               mask(SIG_UNBLOCK, signal_number, ignored);
+            }
+
+            return;
+         }
+
+         sigaddset(&mask_, signal_number);
+         update(ec);
+      }
+
+      void remove(int signal_number, boost::system::error_code &ec) {
+         ec.clear();
+
+         sigdelset(&mask_, signal_number);
+         if(!update(ec))
+            return;
+
+         mask(SIG_UNBLOCK, signal_number, ec);
+      }
+
+      // read one pending signal, return false if there is no more
+      bool read(signalfd_siginfo &info, boost::system::error_code &ec) {
+         ec.clear();
+
+         if(fd_ == -1)
+            return false;
+
+         for(;;) {
+            ssize_t r = ::read(fd_, &info, sizeof(info));
+
+            if(r == sizeof(info))
+               return true;
+
+            if(r == -1 && errno == EINTR)
+               continue;
+
+            if(r == -1 && errno != EAGAIN)
+               ec = last_error_code();
+
+            return false;
+         }
+      }
+
+      int native_handle() const {
+         return fd_;
+      }
+
+   private:
+
+      // check the SigBlk of each thread on /proc, true if it can't be read
+      static bool blocked_by_all_threads(int signal_number) {
+         DIR* tasks = ::opendir("/proc/self/task");
+
+         if(!tasks)
+            return true;
+
+         std::string self = lexical_cast<std::string>(::syscall(SYS_gettid));
+         bool blocked = true;
+
+         while(dirent* task = ::readdir(tasks)) {
+            std::string tid = task->d_name;
+
+            if(tid == "." || tid == ".." || tid == self)
+               continue;
+
+            if(!thread_blocks(tid, signal_number)) {
+               blocked = false;
+               break;
+            }
+         }
+
+         ::closedir(tasks);
+         return blocked;
+      }
+
+      static bool thread_blocks(const std::string& tid, int signal_number) {
+         std::ifstream status(("/proc/self/task/" + tid + "/status").c_str());
+         std::string line;
+
+         while(std::getline(status, line)) {
+            if(line.compare(0, 7, "SigBlk:") != 0)
+               continue;
+
+            unsigned long long blocked =
+               std::strtoull(line.c_str() + 7, 0, 16);
+
+            return (blocked >> (signal_number - 1)) & 1;
+         }
+
+         // the thread is gone
+         return true;
+      }
+
+      bool mask(int how, int signal_number, boost::system::error_code &ec) {
+         sigset_t set;
+         sigemptyset(&set);
+         sigaddset(&set, signal_number);
+
+         int r = pthread_sigmask(how, &set, 0);
+         if(r != 0) {
+            ec = boost::system::error_code(r, boost::system::system_category());
+            return false;
+         }
+
+         return true;
+      }
+
+      bool update(boost::system::error_code &ec) {
+         int fd = ::signalfd(fd_, &mask_, SFD_NONBLOCK | SFD_CLOEXEC);
+
+         if(fd == -1) {
+            ec = last_error_code();
+            return false;
+         }
+
+         fd_ = fd;
+         return true;
+      }
+
+      int fd_;
+      sigset_t mask_;
+   };
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_IMPL_POSIX_SIGNALFD_IMPL_HPP
@@ -10,6 +10,9 @@
 
 // Revision History
 // 15-10-2013 dd-mm-yyyy - Initial Release
+// 22-05-2014 dd-mm-yyyy - SIGUSR1 version signals the process
+// 24-05-2014 dd-mm-yyyy - Futex version replaces the yield based one
+// 25-05-2014 dd-mm-yyyy - Default version uses poll instead of select
 
 // -----------------------------------------------------------------------------
 
@@ -18,38 +21,100 @@
 
 #include <stdio.h>
 #include <signal.h>
+#include <unistd.h>
+#include <poll.h>
 
 #include <boost/application/aspects/selfpipe.hpp>
 
+// the yield based version was replaced by the futex based one
+#if defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_YELD_BASED ) \
+ && !defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED )
+#   define USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED
+#endif
+
+#if defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED )
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+#if BOOST_OS_LINUX
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#else
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#endif
+#endif
+
 namespace boost { namespace application {
 
-#if defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_YELD_BASED )
+#if defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED )
+   // wait() sleeps on a futex (Linux) or on a condition variable, without
+   // use any file descriptor or signal, it don't use CPU while waiting.
    class wait_for_termination_request_impl : noncopyable
    {
    public:
 
       wait_for_termination_request_impl()
-         : run_(true)
+         : run_(1)
       {
       }
 
       // will wait for termination request
       void wait()
       {
-         while (run_) { boost::this_thread::yield(); }
+#if BOOST_OS_LINUX
+         while (run_.load(boost::memory_order_acquire)) {
+            // sleeps only if run_ is still 1, wakes up on proceed()
+            // (or spuriously, e.g. EINTR)
+            syscall(SYS_futex, futex(), FUTEX_WAIT_PRIVATE, 1, 0, 0, 0);
+         }
+#else
+         boost::unique_lock<boost::mutex> lock(mutex_);
+
+         while (run_.load(boost::memory_order_acquire)) {
+            cond_.wait(lock);
+         }
+#endif
       }
 
       void proceed() 
       {
-         run_ = false;
+#if BOOST_OS_LINUX
+         run_.store(0, boost::memory_order_release);
+
+         // wake all waiters
+         syscall(SYS_futex, futex(), FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#else
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            run_.store(0, boost::memory_order_release);
+         }
+
+         cond_.notify_all();
+#endif
       }
 
    private:
 
-      bool run_;
+#if BOOST_OS_LINUX
+      // the futex word is the value of run_
+      int* futex()
+      {
+         BOOST_STATIC_ASSERT(sizeof(boost::atomic<int>) == sizeof(int));
+         return reinterpret_cast<int*>(&run_);
+      }
+#else
+      boost::mutex mutex_;
+      boost::condition_variable cond_;
+#endif
+
+      boost::atomic<int> run_;
 
    }; 
 #elif defined( USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_SIGUSR1_BASED )
+   // SIGUSR1 need be blocked on all threads of application (block it
+   // before threads are created), else it can be delivered to a thread
+   // that is not waiting for it.
    class wait_for_termination_request_impl : noncopyable
       // http://www.cs.kent.edu/~farrell/sp/lectures/signals.html
    {
@@ -76,10 +141,15 @@ namespace boost { namespace application {
 
       void proceed() 
 	    {
-         raise(SIGUSR1);
+         // directed to process (raise() is directed to calling thread,
+         // that is not the one waiting on sigwait)
+         kill(getpid(), SIGUSR1);
       }
    };
 #else // DRFAULT WAY
+   // poll don't have the FD_SETSIZE limit of select. The selfpipe is never
+   // drained, so it stays readable after proceed() and all the waiting
+   // threads (and the ones that wait after) are woken up.
    class wait_for_termination_request_impl : noncopyable
    {
    public:
@@ -87,12 +157,13 @@ namespace boost { namespace application {
       // will wait for termination request
       void wait()
       {
-         fd_set readfds;
-         FD_ZERO(&readfds);
-         FD_SET(selfpipe_.read_fd(), &readfds);
+         struct pollfd pfd;
+         pfd.fd = selfpipe_.read_fd();
+         pfd.events = POLLIN;
+         pfd.revents = 0;
 
          // block and wait
-         while(select(selfpipe_.read_fd() + 1, &readfds, 0, 0, 0) == -1 && errno == EINTR)
+         while(poll(&pfd, 1, -1) == -1 && errno == EINTR)
          {
             // nothing here, restart when signal is catch
          }
@@ -0,0 +1,97 @@
+// cpu_affinity_impl.hpp -----------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 30-05-2014 dd-mm-yyyy - Initial Release
+// 01-06-2014 dd-mm-yyyy - current_cpu
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_IMPL_WINDOWS_CPU_AFFINITY_IMPL_HPP
+#define BOOST_APPLICATION_IMPL_WINDOWS_CPU_AFFINITY_IMPL_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/application/system_error.hpp>
+
+#include <vector>
+
+#include <windows.h>
+
+namespace boost { namespace application { namespace detail {
+
+   // The cpus that the process can use (of its processor group), in the
+   // order that threads should be placed on them. When numa_aware is set,
+   // consecutive threads are spread on the NUMA nodes (round robin).
+   inline std::vector<int> allowed_cpus(bool numa_aware) {
+      std::vector<int> cpus;
+
+      DWORD_PTR process_mask = 0, system_mask = 0;
+      if(!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+         return cpus;
+
+      const int bits = sizeof(DWORD_PTR) * 8;
+
+      std::vector<DWORD_PTR> nodes;
+      ULONG highest = 0;
+
+      if(numa_aware && GetNumaHighestNodeNumber(&highest) && highest > 0) {
+         for(ULONG node = 0; node <= highest; ++node) {
+            ULONGLONG mask = 0;
+            if(GetNumaNodeProcessorMask((UCHAR)node, &mask) && (mask & process_mask))
+               nodes.push_back((DWORD_PTR)mask & process_mask);
+         }
+      }
+
+      if(nodes.size() < 2) {
+         for(int cpu = 0; cpu < bits; ++cpu) {
+            if(process_mask & ((DWORD_PTR)1 << cpu))
+               cpus.push_back(cpu);
+         }
+
+         return cpus;
+      }
+
+      // take the next cpu of each node, until all are taken
+      for(bool more = true; more; ) {
+         more = false;
+
+         for(std::size_t n = 0; n < nodes.size(); ++n) {
+            for(int cpu = 0; cpu < bits; ++cpu) {
+               DWORD_PTR bit = (DWORD_PTR)1 << cpu;
+
+               if(nodes[n] & bit) {
+                  cpus.push_back(cpu);
+                  nodes[n] &= ~bit;
+                  more = true;
+                  break;
+               }
+            }
+         }
+      }
+
+      return cpus;
+   }
+
+   // pin the calling thread to cpu
+   inline void pin_current_thread(int cpu, boost::system::error_code &ec) {
+      ec.clear();
+
+      if(!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu))
+         ec = last_error_code();
+   }
+
+   // the cpu running the calling thread (of its processor group)
+   inline int current_cpu() {
+      return (int)GetCurrentProcessorNumber();
+   }
+
+}}} // boost::application::detail
+
+#endif // BOOST_APPLICATION_IMPL_WINDOWS_CPU_AFFINITY_IMPL_HPP
@@ -0,0 +1,182 @@
+// work_stealing_deque.hpp ---------------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 31-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_DETAIL_WORK_STEALING_DEQUE_HPP
+#define BOOST_APPLICATION_DETAIL_WORK_STEALING_DEQUE_HPP
+
+#include <boost/application/config.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+#include <cstddef>
+
+namespace boost { namespace application { namespace detail {
+
+   // Chase-Lev work stealing deque, with the memory orders of
+   // "Correct and Efficient Work-Stealing for Weak Memory Models"
+   // (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+   //
+   // Only the owner thread calls push() and pop() (LIFO, on bottom),
+   // any thread can call steal() (FIFO, on top). The buffer grows when
+   // it is full, the old buffers are kept until destruction, since a
+   // thief can still be reading them.
+   template <typename T>
+   class work_stealing_deque : noncopyable
+   {
+      typedef std::ptrdiff_t index_type;
+
+      struct buffer : noncopyable
+      {
+         explicit buffer(std::size_t capacity)
+            : mask(capacity - 1)
+            , items(new boost::atomic<T*>[capacity])
+         {}
+
+         ~buffer() { delete [] items; }
+
+         std::size_t capacity() const { return mask + 1; }
+
+         T* get(index_type i) const {
+            return items[i & mask].load(boost::memory_order_relaxed);
+         }
+
+         void put(index_type i, T* item) {
+            items[i & mask].store(item, boost::memory_order_relaxed);
+         }
+
+         std::size_t mask;
+         boost::atomic<T*> *items;
+      };
+
+   public:
+
+      // capacity need be a power of two
+      explicit work_stealing_deque(std::size_t capacity = 256)
+         : top_(0)
+         , bottom_(0)
+         , buffer_(new buffer(capacity))
+      {
+         buffers_.push_back(buffer_.load(boost::memory_order_relaxed));
+      }
+
+      ~work_stealing_deque()
+      {
+         for(std::size_t i = 0; i < buffers_.size(); ++i)
+            delete buffers_[i];
+      }
+
+      // owner only
+      void push(T* item)
+      {
+         index_type b = bottom_.load(boost::memory_order_relaxed);
+         index_type t = top_.load(boost::memory_order_acquire);
+         buffer *a = buffer_.load(boost::memory_order_relaxed);
+
+         if(b - t > (index_type)a->capacity() - 1)
+            a = grow(a, b, t);
+
+         a->put(b, item);
+         boost::atomic_thread_fence(boost::memory_order_release);
+         bottom_.store(b + 1, boost::memory_order_relaxed);
+      }
+
+      // owner only, 0 if empty
+      T* pop()
+      {
+         index_type b = bottom_.load(boost::memory_order_relaxed) - 1;
+         buffer *a = buffer_.load(boost::memory_order_relaxed);
+
+         bottom_.store(b, boost::memory_order_relaxed);
+         boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+         index_type t = top_.load(boost::memory_order_relaxed);
+
+         if(t > b) {
+            // empty
+            bottom_.store(b + 1, boost::memory_order_relaxed);
+            return 0;
+         }
+
+         T* item = a->get(b);
+
+         if(t == b) {
+            // last item, race with thieves
+            if(!top_.compare_exchange_strong(t, t + 1,
+                  boost::memory_order_seq_cst, boost::memory_order_relaxed))
+               item = 0;
+
+            bottom_.store(b + 1, boost::memory_order_relaxed);
+         }
+
+         return item;
+      }
+
+      // any thread, 0 if empty or if lost a race (try again later)
+      T* steal()
+      {
+         index_type t = top_.load(boost::memory_order_acquire);
+         boost::atomic_thread_fence(boost::memory_order_seq_cst);
+         index_type b = bottom_.load(boost::memory_order_acquire);
+
+         if(t >= b)
+            return 0;
+
+         buffer *a = buffer_.load(boost::memory_order_consume);
+         T* item = a->get(t);
+
+         if(!top_.compare_exchange_strong(t, t + 1,
+               boost::memory_order_seq_cst, boost::memory_order_relaxed))
+            return 0;
+
+         return item;
+      }
+
+      // approximate, for idle checks
+      bool empty() const
+      {
+         index_type b = bottom_.load(boost::memory_order_seq_cst);
+         index_type t = top_.load(boost::memory_order_seq_cst);
+
+         return b <= t;
+      }
+
+   private:
+
+      buffer* grow(buffer *a, index_type b, index_type t)
+      {
+         buffer *bigger = new buffer(a->capacity() * 2);
+
+         for(index_type i = t; i < b; ++i)
+            bigger->put(i, a->get(i));
+
+         buffers_.push_back(bigger);
+         buffer_.store(bigger, boost::memory_order_release);
+
+         return bigger;
+      }
+
+      // top and bottom on different cache lines, thieves write top
+      boost::atomic<index_type> top_;
+      char pad_[64 - sizeof(boost::atomic<index_type>)];
+      boost::atomic<index_type> bottom_;
+
+      boost::atomic<buffer*> buffer_;
+      std::vector<buffer*> buffers_;
+   };
+
+}}} // boost::application::detail
+
+#endif // BOOST_APPLICATION_DETAIL_WORK_STEALING_DEQUE_HPP
@@ -0,0 +1,154 @@
+// prefork_server_application.hpp --------------------------------------------//
+// -----------------------------------------------------------------------------
+
+// Copyright 2011-2014 Renato Tegon Forti
+
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+
+// -----------------------------------------------------------------------------
+
+// Revision History
+// 29-05-2014 dd-mm-yyyy - Initial Release
+
+// -----------------------------------------------------------------------------
+
+#ifndef BOOST_APPLICATION_PREFORK_SERVER_APPLICATION_HPP
+#define BOOST_APPLICATION_PREFORK_SERVER_APPLICATION_HPP
+
+// application
+#include <boost/application/config.hpp>
+#include <boost/application/context.hpp>
+#include <boost/application/detail/csbl.hpp>
+#include <boost/application/application_mode_register.hpp>
+
+// internal aspects
+#include <boost/application/aspects/status.hpp>
+#include <boost/application/aspects/run_mode.hpp>
+#include <boost/application/aspects/path.hpp>
+#include <boost/application/aspects/process_id.hpp>
+#include <boost/application/aspects/worker_pool.hpp>
+
+// platform dependent
+#if defined( BOOST_POSIX_API )
+#   include <boost/application/detail/posix/prefork_server_application_impl.hpp>
+#else
+#   error "Sorry, prefork_server is available only on POSIX platforms."
+#endif
+
+namespace boost { namespace application {
+
+   /*!
+    * \brief This class hold a 'prefork_server' application mode system.
+    *
+    * prefork_server : A server (long-time duration) application that
+    *                  forks N worker processes (after daemonize) that run
+    *                  the application functor, each one pinned to a CPU.
+    *
+    * The workers are forked, supervised, and restarted when they exit
+    * (using an exponential backoff) by a fork server, a single threaded
+    * process forked by the master before it starts its signal handling.
+    * On termination, SIGTERM is sent to all workers, that are terminated
+    * by their own signal_manager (termination_handler and
+    * wait_for_termination_request of worker), and the workers still alive
+    * after the grace period of worker_pool are killed.
+    *
+    * The workers are configured by a worker_pool aspect, that also
+    * tells to application code the index of worker. The listening sockets
+    * opened before launch are shared by all workers.
+    *
+    * \b Examples:
+    * \code
+    * context.insert<application::worker_pool>(
+    *    boost::make_shared<application::worker_pool>(4));
+    *
+    * application::launch<application::prefork_server>(app, context);
+    * \endcode
+    */
+   class prefork_server
+   {
+   public:
+
+      /*!
+       * Retrieves a id that identify application run mode.
+       *
+       */
+      static int mode() {
+         static int id = new_run_mode<int>();
+         return id;
+      }
+
+      /*!
+       * Creates a prefork server application.
+       *
+       * \param myapp An user application functor class.
+       *
+       * \param sm The signal manager of master, that will be used
+       *           internaly by application type.
+       *
+       * \param context An context of application, that hold all
+       *        aspects.
+       *
+       * \param ec Variable (boost::system::error_code) that will be
+       *        set to the result of the operation.
+       *
+       * Check ec for errors.
+       *
+       */
+      template <typename Application, typename SignalManager>
+      prefork_server(Application& myapp, SignalManager &sm,
+             application::context &context, boost::system::error_code& ec) {
+         // default aspects patterns added to this kind of application
+
+         if(!context.find<run_mode>())
+             context.insert<run_mode>(
+               csbl::make_shared<run_mode>(mode()));
+
+         if(!context.find<status>())
+             context.insert<status>(
+               csbl::make_shared<status>(status::running));
+
+         if(!context.find<process_id>())
+              context.insert<process_id>(
+               csbl::make_shared<process_id>());
+
+         if(!context.find<path>())
+              context.insert<path>(
+               csbl::make_shared<path>());
+
+         if(!context.find<worker_pool>())
+              context.insert<worker_pool>(
+               csbl::make_shared<worker_pool>());
+
+         // need be created after run_mode, status
+
+         impl_.reset(new prefork_server_application_impl(
+            boost::bind( &Application::operator(), &myapp), sm,
+            context, ec));
+      }
+
+      /*!
+       * Fork the workers, supervise them until termination. Only the
+       * master returns.
+       *
+       */
+      int run() {
+         return impl_->run();
+      }
+
+      /*!
+       * Destruct an prefork server application.
+       *
+       */
+      virtual ~prefork_server() {
+         impl_->get_context().find<status>()->state(status::stopped);
+      }
+
+   private:
+
+      csbl::shared_ptr<prefork_server_application_impl> impl_;
+   };
+
+}} // boost::application
+
+#endif // BOOST_APPLICATION_PREFORK_SERVER_APPLICATION_HPP
@@ -10,6 +10,12 @@
 
 // Revision History
 // 26-10-2013 dd-mm-yyyy - Initial Release
+// 18-05-2014 dd-mm-yyyy - External io_service and signalfd backend
+// 20-05-2014 dd-mm-yyyy - Queued (real-time) signals with siginfo
+// 28-05-2014 dd-mm-yyyy - signal_manager triggers hot_restart
+// 29-05-2014 dd-mm-yyyy - prefork_server can start a signal_binder
+// 01-06-2014 dd-mm-yyyy - signal_manager drains the requests in flight
+// 02-06-2014 dd-mm-yyyy - signal_manager pauses and resumes on posix
 
 // -----------------------------------------------------------------------------
 
@@ -21,6 +27,14 @@
 
 #include <boost/application/context.hpp>
 #include <boost/application/handler.hpp>
+#include <boost/application/detail/epoch.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+#include <signal.h>
 
 // #include <boost/bind.hpp>
 // #include <boost/thread/thread.hpp>
@@ -28,9 +42,105 @@
 #include <boost/application/aspects/termination_handler.hpp>
 #include <boost/application/aspects/limit_single_instance.hpp>
 #include <boost/application/aspects/wait_for_termination_request.hpp>
+#include <boost/application/aspects/drain_controller.hpp>
+
+#if defined( BOOST_POSIX_API )
+#include <boost/application/aspects/hot_restart.hpp>
+#include <boost/application/aspects/pause_handler.hpp>
+#include <boost/application/aspects/resume_handler.hpp>
+#endif
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+#include <boost/application/detail/posix/signalfd_impl.hpp>
+#endif
 
 namespace boost { namespace application {
 
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+   /*!
+    * \brief Tag used to select the signalfd backend of signal_binder
+    *        (Linux only).
+    *
+    * \b Examples:
+    * \code
+    * application::signal_manager sm(app_context, application::use_signalfd);
+    *
+    * // poll sm.native_handle() on your event loop, and when it is
+    * // readable call:
+    * sm.poll();
+    * \endcode
+    */
+   struct use_signalfd_t {};
+   const use_signalfd_t use_signalfd = use_signalfd_t();
+
+   /*!
+    * Blocks the signals on calling thread. Call it on main, before any
+    * other thread is created (io_service_pool, work_queue, asio or user
+    * threads), so all threads inherit the mask and the signals are only
+    * taken through the signalfd of signal_binder.
+    *
+    * The signalfd backend, and bind_queued, fail with
+    * operation_not_permitted if other thread of process don't block the
+    * signal.
+    *
+    * \b Examples:
+    * \code
+    * int main() {
+    *    int signals[] = { SIGINT, SIGTERM, SIGABRT };
+    *    application::block_signals(signals, signals + 3);
+    *
+    *    // create the threads and the signal_manager (use_signalfd) ...
+    * }
+    * \endcode
+    */
+   inline void block_signals(const int* first, const int* last,
+      boost::system::error_code& ec)
+   {
+      ec.clear();
+
+      sigset_t set;
+      sigemptyset(&set);
+
+      for(; first != last; ++first)
+         sigaddset(&set, *first);
+
+      int r = pthread_sigmask(SIG_BLOCK, &set, 0);
+      if(r != 0)
+         ec = boost::system::error_code(r, boost::system::system_category());
+   }
+
+   inline void block_signals(const int* first, const int* last)
+   {
+      boost::system::error_code ec;
+      block_signals(first, last, ec);
+
+      if(ec)
+         BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+            "block_signals() failed", ec);
+   }
+
+   /*!
+    * \brief The information delivered with a queued signal
+    *        (see signal_binder::bind_queued).
+    *
+    */
+   struct signal_info
+   {
+      int signal_number;
+
+      // origin of signal, e.g.: SI_QUEUE for sigqueue(), SI_USER for kill()
+      int code;
+
+      // sender
+      pid_t pid;
+      uid_t uid;
+
+      // si_value given to sigqueue()
+      int value;
+      boost::uint64_t pointer;
+   };
+#endif
+
    // This is an attempt to make things more flexible,
    // this allow user to define your own sinal -> handler map
 
@@ -43,38 +153,107 @@ namespace boost { namespace application {
     *        User can extend of signal_manager to customize SIGANAL/Handlers
     *        of your application.
     *
+    * By default the signal_binder has its own io_service, that is run by a
+    * thread created on start().
+    *
+    * The user can give an io_service that is already run by the
+    * application, in this case the signal_binder don't create any thread,
+    * and the handlers are called by the threads that run the io_service.
+    * The io_service must outlive the signal_binder. A handler that is
+    * running on other thread when the signal_binder is destroyed is
+    * waited by the destructor.
+    *
+    * On Linux, the signalfd backend (use_signalfd) don't use asio at all,
+    * the user polls native_handle() on its own event loop and calls
+    * poll() when it is readable.
+    *
+    * On Linux, bind_queued can be used to receive each queued real-time
+    * signal (sigqueue) in order, with its siginfo. It works with any
+    * backend, on the asio ones a signalfd is read on the io_service.
+    *
     */
    class signal_binder
    {
       template<class> friend class common_application_impl_;
       template<class> friend class server_application_impl_;
+      template<class> friend class prefork_server_application_impl_;
 
    public:
       explicit signal_binder(context &cxt)
-         : signals_(io_service_)
+         : own_io_service_(new asio::io_service())
+         , io_service_(own_io_service_.get())
          , context_(cxt) {
-         signals_.async_wait(
-            boost::bind(&signal_binder::signal_handler, this,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::signal_number));
+         init();
       }
 
       explicit signal_binder(global_context_ptr cxt)
-         : signals_(io_service_)
+         : own_io_service_(new asio::io_service())
+         , io_service_(own_io_service_.get())
          , context_(*cxt.get()) {
-         signals_.async_wait(
-            boost::bind(&signal_binder::signal_handler, this,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::signal_number));
+         init();
+      }
+
+      /*!
+       * Creates a signal_binder that use the given io_service,
+       * no thread is created by signal_binder.
+       *
+       * \param io_service The io_service that is run by the application.
+       *
+       */
+      signal_binder(context &cxt, asio::io_service &io_service)
+         : io_service_(&io_service)
+         , context_(cxt) {
+         init();
+      }
+
+      signal_binder(global_context_ptr cxt, asio::io_service &io_service)
+         : io_service_(&io_service)
+         , context_(*cxt.get()) {
+         init();
+      }
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      /*!
+       * Creates a signal_binder that use the signalfd backend,
+       * no io_service or thread is used by signal_binder.
+       *
+       * The bound signals are blocked on calling thread, so bind them
+       * before create other threads of application.
+       *
+       */
+      signal_binder(context &cxt, use_signalfd_t)
+         : io_service_(0)
+         , signalfd_(new signalfd_impl())
+         , context_(cxt) {
+         init();
+      }
+
+      signal_binder(global_context_ptr cxt, use_signalfd_t)
+         : io_service_(0)
+         , signalfd_(new signalfd_impl())
+         , context_(*cxt.get()) {
+         init();
       }
+#endif
 
       virtual ~signal_binder() {
+         // handlers that are still queued on an external io_service
+         // must not touch this object, and one that is running on other
+         // thread is waited.
+         {
+            boost::lock_guard<boost::mutex> lock(self_->mutex);
+            self_->binder = 0;
+         }
+
          if(io_service_thread_) {
-            io_service_.stop();
+            io_service_->stop();
             if (io_service_thread_->joinable()) {
                io_service_thread_->join();
             }
          }
+
+         for(int i = 0; i < NSIG; ++i)
+            delete handlers_[i].load(boost::memory_order_relaxed);
       }
 
       /*!
@@ -145,9 +324,96 @@ namespace boost { namespace application {
        */
       void bind(int signal_number, const handler<>& h1, const handler<>& h2,
          boost::system::error_code& ec) {
-         signals_.add(signal_number, ec);
-         handler_map_[signal_number] = std::make_pair(h1, h2);
+         if(!valid(signal_number, ec))
+            return;
+
+         boost::lock_guard<boost::mutex> lock(bind_mutex_);
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+         if(signalfd_)
+            signalfd_->add(signal_number, ec);
+         else {
+            // was bound by bind_queued
+            if(is_queued(signal_number)) {
+               queue().remove(signal_number, ec);
+               if(ec) return;
+            }
+
+            signals_->add(signal_number, ec);
+         }
+#else
+         signals_->add(signal_number, ec);
+#endif
+         if(ec) return;
+
+         exchange(signal_number, new entry_type(h1, h2));
+      }
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      typedef csbl::function< void (const signal_info&) > queued_callback;
+
+      /*!
+       * Bind/tie a SIGNAL to a callback that receives the signal_info of
+       * each signal delivered. The signals are not coalesced, each real-time
+       * signal queued by sigqueue() is delivered, in order.
+       *
+       * The signal is blocked on calling thread, so bind it before create
+       * other threads of application.
+       *
+       * \param signal_number The signal constant, e.g.: SIGRTMIN + 1.
+       *
+       * \param cb The callback that will be called for each signal.
+       *
+       */
+      void bind_queued(int signal_number, const queued_callback& cb) {
+         boost::system::error_code ec;
+         bind_queued(signal_number, cb, ec);
+
+         if(ec)
+            BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "bind_queued() failed", ec);
+      }
+
+      /*!
+       * Bind/tie a SIGNAL to a callback that receives the signal_info of
+       * each signal delivered. 'ec' version.
+       *
+       * \param signal_number The signal constant, e.g.: SIGRTMIN + 1.
+       *
+       * \param cb The callback that will be called for each signal.
+       *
+       */
+      void bind_queued(int signal_number, const queued_callback& cb,
+         boost::system::error_code& ec) {
+         if(!valid(signal_number, ec))
+            return;
+
+         boost::lock_guard<boost::mutex> lock(bind_mutex_);
+
+         // a signal can't be on signal_set and on signalfd
+         if(!signalfd_ && is_bound(signal_number)) {
+            signals_->remove(signal_number, ec);
+            if(ec) return;
+         }
+
+         queue().add(signal_number, ec);
+         if(ec) return;
+
+         if(!signalfd_ && !queue_descriptor_) {
+            int fd = ::dup(queue_->native_handle());
+            if(fd == -1) {
+               ec = last_error_code();
+               return;
+            }
+
+            queue_descriptor_.reset(
+               new asio::posix::stream_descriptor(*io_service_, fd));
+            async_read_queue();
+         }
+
+         exchange(signal_number, new entry_type(cb));
       }
+#endif
 
       /*!
        * Unbind/untie a standard SIGNAL.
@@ -171,11 +437,21 @@ namespace boost { namespace application {
        *
        */
       void unbind(int signal_number, boost::system::error_code& ec) {
-         if(handler_map_.cend() != handler_map_.find(signal_number))
+         if(!valid(signal_number, ec))
+            return;
+
+         boost::lock_guard<boost::mutex> lock(bind_mutex_);
+
+         if(is_bound(signal_number))
          {
             // replace
-            signals_.remove(signal_number, ec);
-            handler_map_.erase(signal_number);
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+            if(signalfd_ || is_queued(signal_number))
+               queue().remove(signal_number, ec);
+            else
+#endif
+            signals_->remove(signal_number, ec);
+            exchange(signal_number, 0);
          }
       }
 
@@ -186,18 +462,84 @@ namespace boost { namespace application {
        *
        */
       bool is_bound(int signal_number) {
-         return (handler_map_.cend() != handler_map_.find(signal_number));
+         if(signal_number <= 0 || signal_number >= NSIG)
+            return false;
+
+         return handlers_[signal_number].load(boost::memory_order_acquire) != 0;
+      }
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      /*!
+       * The signalfd descriptor, to be polled by the user event loop.
+       *
+       * \return The signalfd descriptor, or -1 if the signalfd backend is
+       *         not used or if no signal is bound yet.
+       *
+       */
+      int native_handle() const {
+         if(signalfd_)
+            return signalfd_->native_handle();
+
+         return -1;
+      }
+
+      /*!
+       * Calls the handlers of all pending signals, without blocking.
+       * Used with signalfd backend, when native_handle() is readable.
+       *
+       * \return The number of signals handled.
+       *
+       */
+      std::size_t poll() {
+         boost::system::error_code ec;
+         std::size_t count = poll(ec);
+
+         if(ec)
+            BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "poll() failed", ec);
+
+         return count;
+      }
+
+      /*!
+       * Calls the handlers of all pending signals, without blocking.
+       * Used with signalfd backend, when native_handle() is readable.
+       * 'ec' version.
+       *
+       * \return The number of signals handled.
+       *
+       */
+      std::size_t poll(boost::system::error_code& ec) {
+         ec.clear();
+
+         if(!signalfd_)
+            return 0;
+
+         std::size_t count = 0;
+         signalfd_siginfo info;
+
+         while(signalfd_->read(info, ec)) {
+            spawn(info);
+            ++count;
+         }
+
+         return count;
       }
+#endif
 
     protected:
 
       void start() {
+         // the user runs its own io_service
+         if(!own_io_service_)
+            return;
+
          io_service_thread_.reset(new csbl::thread(
             boost::bind(&signal_binder::run_io_service, this)));
       }
 
       void run_io_service() {
-         io_service_.run();
+         io_service_->run();
       }
 
       void signal_handler(const boost::system::error_code& ec,
@@ -205,25 +547,33 @@ namespace boost { namespace application {
          spawn(ec, signal_number);
 
          // triggers again
-         signals_.async_wait(
-            boost::bind(&signal_binder::signal_handler, this,
-            boost::asio::placeholders::error,
-            boost::asio::placeholders::signal_number));
+         async_wait();
       }
 
    protected:
 
+      // O(1), don't allocate and don't lock, safe with a concurrent
+      // bind/unbind of the same signal.
       void spawn(const boost::system::error_code& ec, int signal_number) {
          if (ec)
             return;
 
-         if(handler_map_[signal_number].first.is_valid()) {
+         if(signal_number <= 0 || signal_number >= NSIG)
+            return;
+
+         // the entry is not deleted while we are using it
+         epoch_type::reader reader(epoch_);
+
+         entry_type* entry
+            = handlers_[signal_number].load(boost::memory_order_acquire);
+
+         if(entry && entry->first.is_valid()) {
             handler<>::callback* cb = 0;
 
-            if(handler_map_[signal_number].first.get(cb)) {
+            if(entry->first.get(cb)) {
                if((*cb)()) {
                   // user tell us to call second callback
-                  if(handler_map_[signal_number].second.get(cb))
+                  if(entry->second.get(cb))
                      (*cb)();
                }
 
@@ -232,17 +582,197 @@ namespace boost { namespace application {
          }
       }
 
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      // signal read from a signalfd, calls the queued callback,
+      // or the handlers if signal is not bound with bind_queued.
+      void spawn(const signalfd_siginfo& siginfo) {
+         int signal_number = siginfo.ssi_signo;
+
+         if(signal_number <= 0 || signal_number >= NSIG)
+            return;
+
+         {
+            epoch_type::reader reader(epoch_);
+
+            entry_type* entry
+               = handlers_[signal_number].load(boost::memory_order_acquire);
+
+            if(entry && entry->queued) {
+               signal_info info;
+
+               info.signal_number = signal_number;
+               info.code = siginfo.ssi_code;
+               info.pid = siginfo.ssi_pid;
+               info.uid = siginfo.ssi_uid;
+               info.value = siginfo.ssi_int;
+               info.pointer = siginfo.ssi_ptr;
+
+               entry->queued(info);
+               return;
+            }
+         }
+
+         spawn(boost::system::error_code(), signal_number);
+      }
+#endif
+
    private:
 
       // signal < handler / handler>
       // if first handler returns true, the second handler are called
-      csbl::unordered_map<int, std::pair< handler<>, handler<> > > handler_map_;
+      struct entry_type {
+         entry_type(const handler<>& h1, const handler<>& h2)
+            : first(h1), second(h2) {}
+
+         handler<> first;
+         handler<> second;
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+         explicit entry_type(const queued_callback& cb)
+            : queued(cb) {}
+
+         // bind_queued
+         queued_callback queued;
+#endif
+      };
+
+      typedef detail::epoch_domain<entry_type> epoch_type;
+
+      // points to this, held by the handlers queued on io_service. The
+      // handlers run with the mutex locked, and the destructor clears the
+      // pointer with it locked, so the signal_binder shall not be
+      // destroyed by one of its handlers.
+      struct self_type {
+         explicit self_type(signal_binder* b) : binder(b) {}
+
+         boost::mutex mutex;
+         signal_binder* binder;
+      };
+
+      bool valid(int signal_number, boost::system::error_code& ec) {
+         ec.clear();
+
+         if(signal_number <= 0 || signal_number >= NSIG) {
+            ec = boost::system::error_code(
+                 boost::system::errc::invalid_argument,
+                 boost::system::generic_category()
+                 );
+            return false;
+         }
+
+         return true;
+      }
+
+      // bind_mutex_ must be held
+      void exchange(int signal_number, entry_type* entry) {
+         entry_type* old = handlers_[signal_number].exchange(
+            entry, boost::memory_order_acq_rel);
 
-      asio::io_service io_service_;
-      asio::signal_set signals_;
+         if(old)
+            epoch_.retire(old);
+      }
+
+      void init() {
+         for(int i = 0; i < NSIG; ++i)
+            handlers_[i].store(0, boost::memory_order_relaxed);
+
+         self_.reset(new self_type(this));
+
+         if(io_service_) {
+            signals_.reset(new asio::signal_set(*io_service_));
+            async_wait();
+         }
+      }
+
+      void async_wait() {
+         signals_->async_wait(
+            boost::bind(&signal_binder::dispatch, self_,
+            boost::asio::placeholders::error,
+            boost::asio::placeholders::signal_number));
+      }
+
+      static void dispatch(csbl::shared_ptr<self_type> self,
+         const boost::system::error_code& ec, int signal_number) {
+         boost::lock_guard<boost::mutex> lock(self->mutex);
+
+         if(self->binder)
+            self->binder->signal_handler(ec, signal_number);
+      }
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      // the signalfd of queued signals: the backend one, or a private
+      // one that is read on io_service. bind_mutex_ must be held.
+      signalfd_impl& queue() {
+         if(signalfd_)
+            return *signalfd_;
+
+         if(!queue_)
+            queue_.reset(new signalfd_impl());
+
+         return *queue_;
+      }
+
+      bool is_queued(int signal_number) {
+         epoch_type::reader reader(epoch_);
+
+         entry_type* entry
+            = handlers_[signal_number].load(boost::memory_order_acquire);
+
+         return entry && entry->queued;
+      }
+
+      void async_read_queue() {
+         queue_descriptor_->async_read_some(
+            asio::buffer(queue_buffer_),
+            boost::bind(&signal_binder::dispatch_queue, self_,
+            boost::asio::placeholders::error,
+            boost::asio::placeholders::bytes_transferred));
+      }
+
+      static void dispatch_queue(csbl::shared_ptr<self_type> self,
+         const boost::system::error_code& ec, std::size_t bytes) {
+         boost::lock_guard<boost::mutex> lock(self->mutex);
+
+         if(!self->binder || ec)
+            return;
+
+         signal_binder& binder = *self->binder;
+
+         // signalfd reads only whole records
+         for(std::size_t i = 0; i < bytes / sizeof(signalfd_siginfo); ++i)
+            binder.spawn(binder.queue_buffer_[i]);
+
+         binder.async_read_queue();
+      }
+#endif
+
+      // handlers indexed by signal number, the entries are replaced
+      // atomically by bind/unbind and deleted when no spawn uses them
+      boost::atomic<entry_type*> handlers_[NSIG];
+      epoch_type epoch_;
+
+      // serialize bind/unbind
+      boost::mutex bind_mutex_;
+
+      // the io_service is owned by signal_binder when the user don't
+      // give one, and is 0 when signalfd is used.
+      csbl::shared_ptr<asio::io_service> own_io_service_;
+      asio::io_service* io_service_;
+      csbl::shared_ptr<asio::signal_set> signals_;
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      csbl::shared_ptr<signalfd_impl> signalfd_;
+
+      // queued signals when an io_service is used
+      csbl::shared_ptr<signalfd_impl> queue_;
+      csbl::shared_ptr<asio::posix::stream_descriptor> queue_descriptor_;
+      signalfd_siginfo queue_buffer_[32];
+#endif
 
       csbl::shared_ptr<csbl::thread> io_service_thread_;
 
+      csbl::shared_ptr<self_type> self_;
+
    protected:
 
       // for signal_manager access
@@ -279,6 +809,58 @@ namespace boost { namespace application {
                "signal_manager() failed", ec);
       }
 
+      signal_manager(application::context &context,
+         asio::io_service &io_service, boost::system::error_code& ec)
+         : signal_binder(context, io_service)
+      {
+         register_signals(ec);
+      }
+
+      signal_manager(application::context &context,
+         asio::io_service &io_service)
+         : signal_binder(context, io_service)
+      {
+         boost::system::error_code ec;
+
+         register_signals(ec);
+
+         if(ec)
+            BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "signal_manager() failed", ec);
+      }
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+      signal_manager(application::context &context,
+         use_signalfd_t use, boost::system::error_code& ec)
+         : signal_binder(context, use)
+      {
+         register_signals(ec);
+      }
+
+      signal_manager(application::context &context, use_signalfd_t use)
+         : signal_binder(context, use)
+      {
+         boost::system::error_code ec;
+
+         register_signals(ec);
+
+         if(ec)
+            BOOST_APPLICATION_THROW_LAST_SYSTEM_ERROR_USING_MY_EC(
+               "signal_manager() failed", ec);
+      }
+#endif
+
+#if defined( BOOST_POSIX_API )
+      virtual ~signal_manager()
+      {
+         // a running restart calls back this signal_manager
+         csbl::shared_ptr<hot_restart> restart = context_.find<hot_restart>();
+
+         if(restart)
+            restart->join();
+      }
+#endif
+
    protected:
 
       virtual csbl::shared_ptr<termination_handler>
@@ -293,9 +875,49 @@ namespace boost { namespace application {
                   new wait_for_termination_request_default_behaviour), guard);
          }
 
+         // the application modes keep a status that already exists
+         if(!context_.find<status>(guard))
+         {
+            context_.insert<status>(
+               csbl::make_shared<status>(status::running), guard);
+         }
+
          return context_.find<termination_handler>(guard);
       }
 
+      // resolve the aspects used by termination_signal_handler, so
+      // on termination no lookup is needed.
+      void resolve_shutdown_path()
+      {
+         strict_lock<application::aspect_map> guard(context_);
+
+         shutdown_path_.state = context_.find<status>(guard);
+         shutdown_path_.single_instance
+            = context_.find<limit_single_instance>(guard);
+         shutdown_path_.termination_request
+            = context_.find<wait_for_termination_request>(guard);
+         shutdown_path_.drain = context_.find<drain_controller>(guard);
+      }
+
+#if defined( BOOST_POSIX_API )
+      // the aspects bound to a configurable signal (hot_restart, pause and
+      // resume) must not silently replace a handler already bound.
+      void bind_unused(int signal_number, const handler<>& h1,
+         const handler<>& h2, boost::system::error_code& ec)
+      {
+         if(is_bound(signal_number))
+         {
+            ec = boost::system::error_code(
+                 boost::system::errc::device_or_resource_busy,
+                 boost::system::generic_category()
+                 );
+            return;
+         }
+
+         bind(signal_number, h1, h2, ec);
+      }
+#endif
+
       // parameter context version
 
       virtual void register_signals(boost::system::error_code& ec)
@@ -303,6 +925,8 @@ namespace boost { namespace application {
          csbl::shared_ptr<termination_handler> th
             = setup_termination_behaviour();
 
+         resolve_shutdown_path();
+
          if(th)
          {
             handler<>::callback cb
@@ -318,27 +942,239 @@ namespace boost { namespace application {
             bind(SIGABRT, th->get_handler(), cb, ec);
             if(ec) return;
          }
+
+#if defined( BOOST_POSIX_API )
+         csbl::shared_ptr<hot_restart> restart = context_.find<hot_restart>();
+
+         if(restart)
+         {
+            handler<>::callback cb
+               = boost::bind(
+               &signal_manager::hot_restart_signal_handler, this);
+
+            bind_unused(restart->trigger_signal(), cb, handler<>(), ec);
+            if(ec) return;
+         }
+
+         csbl::shared_ptr<pause_handler> ph = context_.find<pause_handler>();
+
+         if(ph)
+         {
+            handler<>::callback cb
+               = boost::bind(
+               &signal_manager::pause_signal_handler, this);
+
+            bind_unused(ph->signal_number(), *ph, cb, ec);
+            if(ec) return;
+         }
+
+         csbl::shared_ptr<resume_handler> rh = context_.find<resume_handler>();
+
+         if(rh)
+         {
+            handler<>::callback cb
+               = boost::bind(
+               &signal_manager::resume_signal_handler, this);
+
+            bind_unused(rh->signal_number(), *rh, cb, ec);
+            if(ec) return;
+         }
+#endif
       }
 
+      // the aspects were resolved by register_signals, they are only
+      // searched here if a derived class did not resolved them.
       virtual bool termination_signal_handler(void)
+      {
+         csbl::shared_ptr<status> state;
+         csbl::shared_ptr<limit_single_instance> single_instance;
+         csbl::shared_ptr<wait_for_termination_request> termination_request;
+
+         status* st = shutdown_path_.state.get();
+         if(!st) {
+            state = context_.find<status>();
+            st = state.get();
+         }
+
+         limit_single_instance* si = shutdown_path_.single_instance.get();
+         if(!si) {
+            // can be inserted after signal_manager creation
+            single_instance = context_.find<limit_single_instance>();
+            si = single_instance.get();
+         }
+
+         wait_for_termination_request* tr
+            = shutdown_path_.termination_request.get();
+         if(!tr) {
+            termination_request = context_.find<wait_for_termination_request>();
+            tr = termination_request.get();
+         }
+
+         csbl::shared_ptr<drain_controller> drain = shutdown_path_.drain;
+         if(!drain)
+            drain = context_.find<drain_controller>();
+
+         if(drain && !drain->drained())
+         {
+            // terminate when the requests in flight are done (or on the
+            // deadline), on the thread of drain_controller, so the
+            // signal thread is not blocked
+            bool started = drain->async_drain(
+               boost::bind(&signal_manager::terminate_after_drain,
+                  state ? state : shutdown_path_.state,
+                  single_instance ? single_instance : shutdown_path_.single_instance,
+                  termination_request ? termination_request
+                                      : shutdown_path_.termination_request));
+
+            // a second termination request during the drain, end it now,
+            // the drain thread terminates with the requests abandoned
+            if(!started)
+               drain->force();
+
+            return false;
+         }
+
+         terminate(st, si, tr);
+
+         // this is not used
+         return false;
+      }
+
+      static void terminate(status* st, limit_single_instance* si,
+         wait_for_termination_request* tr)
       {
          // we need set application_state to stop
-         context_.find<status>()->state(status::stopped);
+         st->state(status::stopped);
 
          // remove process lock
-         csbl::shared_ptr<limit_single_instance> si
-            = context_.find<limit_single_instance>();
-
          if(si)
             si->release(true);
 
          // and signalize wait_for_termination_request
-         context_.find<wait_for_termination_request>()->proceed();
+         tr->proceed();
+      }
+
+      static void terminate_after_drain(csbl::shared_ptr<status> st,
+         csbl::shared_ptr<limit_single_instance> si,
+         csbl::shared_ptr<wait_for_termination_request> tr)
+      {
+         terminate(st.get(), si.get(), tr.get());
+      }
+
+#if defined( BOOST_POSIX_API )
+      // hand over the listening sockets and the single instance lock to
+      // a new instance, if it is ready, drain and terminate, else go on.
+      virtual bool hot_restart_signal_handler(void)
+      {
+         csbl::shared_ptr<hot_restart> restart = context_.find<hot_restart>();
+
+         // only the signal thread starts a restart
+         if(!restart || restart->restarting())
+            return false;
+
+         csbl::shared_ptr<limit_single_instance> single_instance
+            = context_.find<limit_single_instance>();
+
+         // the new instance will lock it
+         if(single_instance)
+            single_instance->release(true);
+
+         // wait the new instance on the thread of hot_restart, so the
+         // signal thread is not blocked. The aspect and this signal_manager
+         // join the thread on destruction, so they outlive the handler.
+         restart->async_restart(boost::bind(&signal_manager::hot_restart_done,
+            this, restart.get(), single_instance, _1, _2));
+
+         return false;
+      }
+
+      virtual void hot_restart_done(hot_restart* restart,
+         csbl::shared_ptr<limit_single_instance> single_instance,
+         pid_t, const boost::system::error_code& ec)
+      {
+         if(ec)
+         {
+            // new instance failed, we go on
+            restart->failed(ec);
+
+            if(!single_instance)
+               return;
+
+            boost::system::error_code lock_ec;
+            if(single_instance->lock(lock_ec) && !lock_ec)
+            {
+               // another instance holds it
+               lock_ec = boost::system::error_code(
+                  boost::system::errc::device_or_resource_busy,
+                  boost::system::generic_category());
+            }
+
+            if(!lock_ec)
+               return;
+
+            // we can't go on without the lock, unless the user handles it
+            if(!restart->failed(lock_ec))
+               termination_signal_handler();
+
+            return;
+         }
+
+         // the lock is owned by new instance now, don't release it
+         // on termination
+         if(single_instance)
+         {
+            context_.erase<limit_single_instance>();
+            shutdown_path_.single_instance.reset();
+         }
+
+         restart->drain();
+
+         termination_signal_handler();
+      }
+
+      // called when the pause_handler accepts the pause, the hooks of
+      // pause_handler quiesce the workers (e.g. work_queue::pause).
+      virtual bool pause_signal_handler(void)
+      {
+         csbl::shared_ptr<status> st = context_.find<status>();
+
+         if(!st || !st->transition(status::running, status::paused))
+            return false;
+
+         csbl::shared_ptr<pause_handler> ph = context_.find<pause_handler>();
+         if(ph)
+            ph->call_hooks();
 
-         // this is not used
          return false;
       }
 
+      virtual bool resume_signal_handler(void)
+      {
+         csbl::shared_ptr<status> st = context_.find<status>();
+
+         if(!st || !st->transition(status::paused, status::running))
+            return false;
+
+         csbl::shared_ptr<resume_handler> rh = context_.find<resume_handler>();
+         if(rh)
+            rh->call_hooks();
+
+         return false;
+      }
+#endif
+
+   private:
+
+      // pre-resolved aspects used on termination
+      struct shutdown_path {
+         csbl::shared_ptr<status> state;
+         csbl::shared_ptr<limit_single_instance> single_instance;
+         csbl::shared_ptr<wait_for_termination_request> termination_request;
+         csbl::shared_ptr<drain_controller> drain;
+      };
+
+      shutdown_path shutdown_path_;
+
    };
 
 }} // boost::application
@@ -0,0 +1,416 @@
+// Copyright 2014 Renato Tegon Forti
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef BOOST_APPLICATION_STATIC_CONTEXT_HPP
+#define BOOST_APPLICATION_STATIC_CONTEXT_HPP
+
+/// \file boost/application/static_context.hpp
+/// \brief This file hold a context of application that has a set of
+/// aspects known at compile time.
+///
+/// The aspects listed as template parameters are resolved at compile time
+/// to a slot of a tuple, the other ones are handled by the aspect_map
+/// as usual.
+///
+/// \b Examples:
+/// \code
+/// application::static_context<
+///    application::status, application::run_mode, my_config> app_context;
+///
+/// myapp app(app_context);
+/// return application::launch<application::server>(app, app_context);
+///
+/// // on a hot path, borrowed access without refcount traffic
+/// app_context_type::slot_guard guard(app_context);
+/// my_config* cfg = app_context.find_ref<my_config>(guard);
+/// \endcode
+
+// application
+#include <boost/application/config.hpp>
+#include <boost/application/detail/csbl.hpp>
+#include <boost/application/context.hpp>
+#include <boost/application/detail/epoch.hpp>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/strict_lock.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_HDR_TUPLE)
+
+#include <tuple>
+#include <stdexcept>
+
+#ifdef BOOST_HAS_PRAGMA_ONCE
+# pragma once
+#endif
+
+namespace boost { namespace application {
+
+   namespace detail {
+
+      // index of T on Aspects, or -1 if T is not there
+
+      template <class T, class... Aspects>
+      struct static_aspect_index;
+
+      template <class T>
+      struct static_aspect_index<T>
+         : boost::integral_constant<int, -1> {};
+
+      template <class T, class... Aspects>
+      struct static_aspect_index<T, T, Aspects...>
+         : boost::integral_constant<int, 0> {};
+
+      template <class T, class U, class... Aspects>
+      struct static_aspect_index<T, U, Aspects...>
+         : boost::integral_constant<int,
+              (static_aspect_index<T, Aspects...>::value < 0)
+                 ? -1 : static_aspect_index<T, Aspects...>::value + 1> {};
+
+      // a value bound to a static slot, it is retired through the epoch
+      // domain of static_context when it is replaced.
+
+      struct static_slot_value_base
+      {
+         virtual ~static_slot_value_base() {}
+      };
+
+      template <class T>
+      struct static_slot_value : static_slot_value_base
+      {
+         explicit static_slot_value(const csbl::shared_ptr<T>& v)
+            : value(v) {}
+
+         csbl::shared_ptr<T> value;
+      };
+
+      typedef epoch_domain<static_slot_value_base> static_slot_epoch;
+
+      // a slot that hold a aspect of static_context.
+      //
+      // the current value is published through an atomic pointer, readers
+      // load it inside of a epoch, and a replaced value is deleted when no
+      // reader that could see it is left.
+
+      template <class T>
+      class static_aspect_slot : noncopyable
+      {
+      public:
+
+         static_aspect_slot()
+            : current_(0) {}
+
+         ~static_aspect_slot() {
+            delete current_.load(boost::memory_order_relaxed);
+         }
+
+         // the caller must be inside of a epoch of the domain, or hold
+         // the lock of the stripe of T
+         csbl::shared_ptr<T> get() const {
+            const static_slot_value<T>* current =
+               current_.load(boost::memory_order_seq_cst);
+
+            if(current)
+               return current->value;
+
+            return csbl::shared_ptr<T>();
+         }
+
+         // the value is kept by the epoch that the caller is inside of
+         T* get_ref() const {
+            const static_slot_value<T>* current =
+               current_.load(boost::memory_order_seq_cst);
+
+            if(current)
+               return current->value.get();
+
+            return 0;
+         }
+
+         // called with the stripe of the aspect locked, the retire of old
+         // values is serialized by retire_mutex, because slots on
+         // different stripes share the domain.
+         void changed(std::size_t id,
+            const csbl::shared_ptr<void>& value,
+            static_slot_epoch& epoch, boost::mutex& retire_mutex) {
+            if(id != detail::aspect_id<T>())
+               return;
+
+            static_slot_value<T>* current =
+               current_.load(boost::memory_order_relaxed);
+
+            if(current && current->value == value)
+               return;
+
+            static_slot_value<T>* next = value
+               ? new static_slot_value<T>(csbl::static_pointer_cast<T>(value))
+               : 0;
+
+            static_slot_value<T>* old =
+               current_.exchange(next, boost::memory_order_seq_cst);
+
+            if(old) {
+               boost::lock_guard<boost::mutex> lock(retire_mutex);
+               epoch.retire(old);
+            }
+         }
+
+      private:
+
+         boost::atomic<static_slot_value<T>*> current_;
+      };
+
+   } // detail
+
+   /*!
+    * \brief A context of application that hold some aspects in
+    *        static slots.
+    *
+    * The aspects types given as template parameters are stored on a tuple,
+    * and find<T>() of one of that types is resolved at compile time to the
+    * tuple slot, without hash or lock, the slot is read inside of a epoch
+    * and only the returned shared_ptr is copied.
+    *
+    * On a hot path use a slot_guard and find_ref<T>(guard): the guard
+    * enters the epoch once, and each find_ref is a load of the slot that
+    * returns a plain pointer, without touch the shared_ptr refcount.
+    *
+    * Other types are handled by the aspect_map, like on basic_context.
+    *
+    * The static_context is a basic_context, so it can be used anywhere a
+    * context& is used (launch, application modes, signal_manager).
+    * All aspects are kept on the aspect_map too, the slots are
+    * updated each time a aspect of one of that types is inserted,
+    * exchanged or erased, no matter if the static_context or a
+    * context& is used to do it.
+    *
+    * A value replaced on a static slot is deleted as soon as no reader
+    * that loaded it is left (epoch based reclamation), so the slots can be
+    * exchanged any number of times.
+    *
+    * <STRONG> Thread Safe: </STRONG> Yes <BR>
+    * <STRONG> Exception Safe: </STRONG>  Yes
+    *
+    */
+   template <class... Aspects>
+   class static_context
+      : public basic_context, detail::aspect_map_observer
+   {
+      template <class T>
+      struct is_static
+         : boost::integral_constant<bool,
+              (detail::static_aspect_index<T, Aspects...>::value >= 0)> {};
+
+   public:
+
+      /*!
+       * \brief A guard that gives borrowed access to the aspects that
+       *        have a static slot.
+       *
+       * While the guard is alive, the values of the static slots are not
+       * deleted, even if they are exchanged or erased, so find_ref can
+       * return a plain pointer. The guard only enters the epoch of the
+       * slots, it don't take any lock, and don't block writers.
+       *
+       * Unlike aspect_map::read_guard, a find_ref sees the value that is
+       * current when it is called.
+       */
+      class slot_guard : boost::noncopyable {
+      public:
+         explicit slot_guard(static_context& context)
+            : context_(context), reader_(context.epoch_) {}
+
+      private:
+         friend class static_context;
+
+         static_context& context_;
+         detail::static_slot_epoch::reader reader_;
+      };
+
+      static_context() {
+         observe(this);
+      }
+
+      ~static_context() {
+         observe(0);
+      }
+
+      using basic_context::find;
+      using basic_context::find_ref;
+#if !defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) && !defined(BOOST_NO_CXX11_HDR_TUPLE)
+      using basic_context::find_all;
+#endif
+
+      /*!
+       * Lookup a aspect that has a static slot.
+       *
+       * \return The pointer /c shared_ptr aspect or nullptr /c shared_ptr
+       *         if aspect don't exists.
+       * \throw Nothing.
+       */
+      template <class T>
+      typename boost::enable_if<is_static<T>, csbl::shared_ptr<T> >::type
+      find() {
+         detail::static_slot_epoch::reader reader(epoch_);
+         return slot<T>().get();
+      }
+
+      /*!
+       * Lookup a aspect that don't have a static slot, the aspect_map is used.
+       *
+       * \return The pointer /c shared_ptr aspect or nullptr /c shared_ptr
+       *         if aspect don't exists.
+       * \throw Nothing.
+       */
+      template <class T>
+      typename boost::disable_if<is_static<T>, csbl::shared_ptr<T> >::type
+      find() {
+         return basic_context::find<T>();
+      }
+
+      /*!
+       * Lookup a aspect that has a static slot.
+       * External locking Version, can be used as part of an atomic transaction.
+       *
+       * \return The pointer /c shared_ptr aspect or nullptr /c shared_ptr
+       *         if aspect don't exists.
+       * \throw std::logic_error if guard hold Wrong Object;
+       *        Does not owns correct lock.
+       */
+      template <class T>
+      typename boost::enable_if<is_static<T>, csbl::shared_ptr<T> >::type
+      find(strict_lock<aspect_map>& guard) {
+         if (!guard.owns_lock(this))
+            throw std::logic_error("Locking Error: Wrong Object Locked");
+
+         // the writers are locked out, no value can be retired
+         return slot<T>().get();
+      }
+
+      template <class T>
+      typename boost::disable_if<is_static<T>, csbl::shared_ptr<T> >::type
+      find(strict_lock<aspect_map>& guard) {
+         return basic_context::find<T>(guard);
+      }
+
+      /*!
+       * Lookup a aspect that has a static slot, and return a plain
+       * pointer to it, borrowed from the epoch entered by guard.
+       *
+       * \return A pointer to the aspect, that is valid while the guard is
+       *         alive, or 0 if aspect don't exists.
+       * \throw std::logic_error if guard belongs to another context.
+       */
+      template <class T>
+      typename boost::enable_if<is_static<T>, T*>::type
+      find_ref(const slot_guard& guard) {
+         if(&guard.context_ != this)
+            throw std::logic_error("Locking Error: Wrong Object Guarded");
+
+         return slot<T>().get_ref();
+      }
+
+      /*!
+       * Lookup several aspects at once, inside of one epoch. The aspects
+       * that has a static slot are read from it, the other ones from the
+       * aspect_map.
+       *
+       * \return A tuple with a <tt> shared_ptr </tt> of each aspect, in the
+       *         order of the template parameters, with a disengaged
+       *         <tt> shared_ptr </tt> for the aspects that don't exist.
+       * \throw Nothing.
+       */
+      template <class... Ts>
+      std::tuple< csbl::shared_ptr<Ts>... > find_all() {
+         detail::static_slot_epoch::reader reader(epoch_);
+         return std::tuple< csbl::shared_ptr<Ts>... >(lookup<Ts>()...);
+      }
+
+      /*!
+       * Lookup several aspects that have a static slot, and return a
+       * tuple with a plain pointer to each one (see find_ref).
+       *
+       * \return A tuple with a pointer to each aspect, in the order of the
+       *         template parameters, that are valid while the guard is
+       *         alive, or 0 for the aspects that don't exist.
+       * \throw std::logic_error if guard belongs to another context.
+       */
+      template <class... Ts>
+      std::tuple< Ts*... > find_all(const slot_guard& guard) {
+         if(&guard.context_ != this)
+            throw std::logic_error("Locking Error: Wrong Object Guarded");
+
+         return std::tuple< Ts*... >(slot<Ts>().get_ref()...);
+      }
+
+      /*!
+       * Call f with a reference to a aspect that has a static slot,
+       * without touch the shared_ptr refcount.
+       *
+       * \return true if f was called, false if aspect don't exists.
+       * \throw Any exception throw by f.
+       */
+      template <class T, class F>
+      typename boost::enable_if<is_static<T>, bool>::type
+      with(F f) {
+         slot_guard guard(*this);
+         T* asp = find_ref<T>(guard);
+
+         if(!asp)
+            return false;
+
+         f(*asp);
+         return true;
+      }
+
+      template <class T, class F>
+      typename boost::disable_if<is_static<T>, bool>::type
+      with(F f) {
+         return basic_context::with<T>(f);
+      }
+
+   private:
+
+      // the caller is inside of the epoch
+      template <class T>
+      typename boost::enable_if<is_static<T>, csbl::shared_ptr<T> >::type
+      lookup() {
+         return slot<T>().get();
+      }
+
+      template <class T>
+      typename boost::disable_if<is_static<T>, csbl::shared_ptr<T> >::type
+      lookup() {
+         return basic_context::find<T>();
+      }
+
+      template <class T>
+      detail::static_aspect_slot<T>& slot() {
+         return std::get<detail::static_aspect_index<T, Aspects...>::value>(slots_);
+      }
+
+      void changed(std::size_t id,
+         const csbl::shared_ptr<void>& value) {
+         int expand[] = { 0,
+            (slot<Aspects>().changed(id, value, epoch_, retire_mutex_), 0)... };
+         (void) expand;
+      }
+
+      detail::static_slot_epoch epoch_;
+      boost::mutex retire_mutex_;
+
+      std::tuple< detail::static_aspect_slot<Aspects>... > slots_;
+   };
+
+}} // boost::application
+
+#endif
+
+#endif // BOOST_APPLICATION_STATIC_CONTEXT_HPP
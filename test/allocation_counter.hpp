@@ -0,0 +1,46 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+// Replaces the global operator new and delete to count the heap
+// allocations done while counting is true.
+// Include it from the single translation unit of a test. The deletes are
+// kept out of line so that the compiler does not pair the free() with the
+// new expressions of the callers.
+
+#ifndef BOOST_APPLICATION_TEST_ALLOCATION_COUNTER_HPP
+#define BOOST_APPLICATION_TEST_ALLOCATION_COUNTER_HPP
+
+#include <cstdlib>
+#include <new>
+#include <boost/config.hpp>
+#include <boost/atomic.hpp>
+
+boost::atomic<bool> counting(false);
+boost::atomic<long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+   if(counting)
+      allocations++;
+
+   if(void* p = std::malloc(size ? size : 1))
+      return p;
+
+   throw std::bad_alloc();
+}
+
+BOOST_NOINLINE void operator delete(void* p) BOOST_NOEXCEPT
+{
+   std::free(p);
+}
+
+BOOST_NOINLINE void operator delete(void* p, std::size_t) BOOST_NOEXCEPT
+{
+   std::free(p);
+}
+
+#endif // BOOST_APPLICATION_TEST_ALLOCATION_COUNTER_HPP
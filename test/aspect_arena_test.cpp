@@ -0,0 +1,171 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <boost/application.hpp>
+
+#include "allocation_counter.hpp"
+
+#define BOOST_TEST_MODULE AspectArena
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+long heap_allocations_of(void (*f)())
+{
+   allocations = 0;
+   counting = true;
+   f();
+   counting = false;
+
+   return allocations;
+}
+
+atomic<int> alive(0);
+
+template <int N>
+struct request_aspect
+{
+   request_aspect(int v, const char* name)
+      : value(v), name(name)
+   {
+      alive++;
+   }
+
+   ~request_aspect()
+   {
+      alive--;
+   }
+
+   int value;
+   const char* name;
+};
+
+application::aspect_arena the_arena(256);
+
+// a request, with a context on the_arena
+void request()
+{
+   {
+      application::context cxt(the_arena);
+
+      cxt.emplace< request_aspect<0> >(0, "zero");
+      cxt.emplace< request_aspect<1> >(1, "one");
+      cxt.emplace< request_aspect<2> >(2, "two");
+      cxt.emplace<application::status>(application::status::running);
+
+      BOOST_CHECK(cxt.find< request_aspect<1> >()->value == 1);
+   }
+
+   the_arena.reset();
+}
+
+BOOST_AUTO_TEST_CASE(aspect_arena_allocate)
+{
+   application::aspect_arena arena(64);
+
+   void* a = arena.allocate(10);
+   void* b = arena.allocate(8, 8);
+   void* c = arena.allocate(200);
+
+   BOOST_CHECK(a && b && c);
+   BOOST_CHECK(std::size_t(b) % 8 == 0);
+   BOOST_CHECK(std::size_t(c) % application::detail::max_alignment == 0);
+   BOOST_CHECK(arena.allocated() == 218);
+   BOOST_CHECK(arena.blocks() == 2);
+
+   // the blocks are replaced by one
+   arena.reset();
+
+   BOOST_CHECK(arena.allocated() == 0);
+   BOOST_CHECK(arena.blocks() == 1);
+
+   arena.allocate(10);
+   arena.allocate(200);
+
+   BOOST_CHECK(arena.blocks() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(aspect_arena_buffer)
+{
+   char buffer[128];
+   application::aspect_arena arena(buffer, sizeof(buffer));
+
+   char* p = static_cast<char*>(arena.allocate(32));
+
+   BOOST_CHECK(p >= buffer && p < buffer + sizeof(buffer));
+   BOOST_CHECK(arena.blocks() == 0);
+
+   arena.allocate(512);
+   BOOST_CHECK(arena.blocks() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_emplace)
+{
+   application::context cxt;
+
+   shared_ptr< request_aspect<0> > asp =
+      cxt.emplace< request_aspect<0> >(10, "ten");
+
+   BOOST_CHECK(asp->value == 10);
+   BOOST_CHECK(cxt.find< request_aspect<0> >() == asp);
+
+   // already present, the one on context is returned
+   BOOST_CHECK(cxt.emplace< request_aspect<0> >(20, "twenty") == asp);
+   BOOST_CHECK(cxt.find< request_aspect<0> >()->value == 10);
+
+   strict_lock<application::aspect_map> guard(cxt);
+
+   BOOST_CHECK(cxt.emplace< request_aspect<1> >(guard, 30, "thirty")->value == 30);
+   BOOST_CHECK(cxt.find< request_aspect<1> >(guard)->value == 30);
+}
+
+BOOST_AUTO_TEST_CASE(context_on_arena)
+{
+   application::aspect_arena arena;
+
+   {
+      application::context cxt(arena);
+
+      cxt.emplace< request_aspect<0> >(1, "one");
+
+      BOOST_CHECK(alive == 1);
+      BOOST_CHECK(arena.allocated() > 0);
+      BOOST_CHECK(arena.blocks() == 1);
+
+      // aspects on heap and on arena are mixed
+      cxt.exchange< request_aspect<1> >(
+         make_shared< request_aspect<1> >(2, "two"));
+      cxt.erase< request_aspect<1> >();
+
+      BOOST_CHECK(alive == 1);
+      BOOST_CHECK(cxt.size() == 1);
+   }
+
+   // the aspects are destroyed with context
+   BOOST_CHECK(alive == 0);
+
+   arena.reset();
+   BOOST_CHECK(arena.allocated() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(request_without_heap)
+{
+   // the first requests grow the arena
+   request();
+   request();
+
+   BOOST_CHECK(alive == 0);
+
+   long allocations = heap_allocations_of(&request);
+   std::cout << "heap allocations per request: " << allocations << std::endl;
+
+   BOOST_CHECK(allocations == 0);
+   BOOST_CHECK(alive == 0);
+}
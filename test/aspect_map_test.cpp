@@ -330,5 +330,439 @@ BOOST_AUTO_TEST_CASE(aspect_map)
 
 }
 
+//
+// readers don't take the lock
+//
+
+struct find_aspect
+{
+   application::aspect_map& my_aspect_map_;
+   shared_ptr<my_msg_aspect_test> result_;
+
+   find_aspect(application::aspect_map& my_aspect_map)
+      : my_aspect_map_(my_aspect_map)
+   {
+   }
+
+   void operator()()
+   {
+      result_ = my_aspect_map_.find<my_msg_aspect_test>();
+   }
+};
 
+BOOST_AUTO_TEST_CASE(aspect_map_lock_free_find)
+{
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_msg_aspect_test>(boost::make_shared<my_msg_aspect_test>("HI"));
 
+   find_aspect reader(my_aspect_map);
+
+   {
+      // a writer transaction is running
+      strict_lock<application::aspect_map> guard(my_aspect_map);
+
+      my_aspect_map.exchange<my_msg_aspect_test>(boost::make_shared<my_msg_aspect_test>("HI:HI"), guard);
+
+      boost::thread th(boost::ref(reader));
+
+      // the reader must not wait for the guard, and see the last published value
+      BOOST_CHECK(th.try_join_for(boost::chrono::seconds(5)));
+      BOOST_CHECK(reader.result_);
+      BOOST_CHECK(reader.result_->say_hi() == "HI:HI");
+   }
+
+   // the snapshot held by a reader is not affected by later writes
+   shared_ptr<my_msg_aspect_test> old = my_aspect_map.find<my_msg_aspect_test>();
+   my_aspect_map.erase<my_msg_aspect_test>();
+
+   BOOST_CHECK(old->say_hi() == "HI:HI");
+   BOOST_CHECK(!my_aspect_map.find<my_msg_aspect_test>());
+   BOOST_CHECK(my_aspect_map.count<my_msg_aspect_test>() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_dense_id)
+{
+   std::size_t msg_id = application::detail::aspect_id<my_msg_aspect_test>();
+   std::size_t sum_id = application::detail::aspect_id<my_sum_aspect_test>();
+
+   // generated once for each type
+   BOOST_CHECK(msg_id != sum_id);
+   BOOST_CHECK(msg_id == application::detail::aspect_id<my_msg_aspect_test>());
+   BOOST_CHECK(msg_id == application::detail::aspect_id<const my_msg_aspect_test>());
+
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(1, 1));
+   my_aspect_map.insert<my_msg_aspect_test>(boost::make_shared<my_msg_aspect_test>("HI"));
+
+   BOOST_CHECK(my_aspect_map.size() == 2);
+
+   my_aspect_map.erase<my_sum_aspect_test>();
+
+   BOOST_CHECK(my_aspect_map.size() == 1);
+   BOOST_CHECK(my_aspect_map.count<my_sum_aspect_test>() == 0);
+   BOOST_CHECK(my_aspect_map.count<my_msg_aspect_test>() == 1);
+}
+
+//
+// readers and writers at same time
+//
+
+struct exchange_and_find
+{
+   application::aspect_map& my_aspect_map_;
+   bool ok_;
+
+   exchange_and_find(application::aspect_map& my_aspect_map)
+      : my_aspect_map_(my_aspect_map), ok_(true)
+   {
+   }
+
+   void reader()
+   {
+      for(int i = 0; i < 20000; i++)
+      {
+         shared_ptr<my_sum_aspect_test> res = my_aspect_map_.find<my_sum_aspect_test>();
+
+         if(!res || res->get() < 2)
+            ok_ = false;
+      }
+   }
+
+   void writer()
+   {
+      for(int i = 0; i < 2000; i++)
+      {
+         my_aspect_map_.exchange<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(1, 1 + i));
+         my_aspect_map_.insert<my_msg_aspect_test>(boost::make_shared<my_msg_aspect_test>("HI"));
+         my_aspect_map_.erase<my_msg_aspect_test>();
+      }
+   }
+};
+
+BOOST_AUTO_TEST_CASE(aspect_map_concurrent_exchange)
+{
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(1, 1));
+
+   exchange_and_find test(my_aspect_map);
+
+   boost::thread_group group;
+   group.create_thread(boost::bind(&exchange_and_find::writer, &test));
+   group.create_thread(boost::bind(&exchange_and_find::reader, &test));
+   group.create_thread(boost::bind(&exchange_and_find::reader, &test));
+   group.join_all();
+
+   BOOST_CHECK(test.ok_);
+   BOOST_CHECK(my_aspect_map.find<my_sum_aspect_test>()->get() == 2001);
+}
+
+//
+// borrowed access
+//
+
+struct add_to
+{
+   int& total_;
+
+   add_to(int& total) : total_(total) {}
+
+   void operator()(my_sum_aspect_test& asp) {
+      total_ += asp.get();
+   }
+};
+
+BOOST_AUTO_TEST_CASE(aspect_map_find_ref)
+{
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(2, 3));
+
+   {
+      application::aspect_map::read_guard guard(my_aspect_map);
+
+      my_sum_aspect_test* sum = my_aspect_map.find_ref<my_sum_aspect_test>(guard);
+      BOOST_REQUIRE(sum != 0);
+      BOOST_CHECK(sum->get() == 5);
+      BOOST_CHECK(my_aspect_map.find_ref<my_msg_aspect_test>(guard) == 0);
+
+      // the borrowed aspect stay valid while guard is alive
+      my_aspect_map.erase<my_sum_aspect_test>();
+      my_aspect_map.insert<my_msg_aspect_test>(boost::make_shared<my_msg_aspect_test>("HI"));
+
+      BOOST_CHECK(sum->get() == 5);
+      BOOST_CHECK(my_aspect_map.find_ref<my_sum_aspect_test>(guard) == sum);
+      BOOST_CHECK(my_aspect_map.find_ref<my_msg_aspect_test>(guard) == 0);
+
+      application::aspect_map other_aspect_map;
+      BOOST_CHECK_THROW(other_aspect_map.find_ref<my_sum_aspect_test>(guard), std::logic_error);
+   }
+
+   application::aspect_map::read_guard guard(my_aspect_map);
+   BOOST_CHECK(my_aspect_map.find_ref<my_sum_aspect_test>(guard) == 0);
+   BOOST_CHECK(my_aspect_map.find_ref<my_msg_aspect_test>(guard) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_with)
+{
+   application::aspect_map my_aspect_map;
+
+   int total = 0;
+   BOOST_CHECK(!my_aspect_map.with<my_sum_aspect_test>(add_to(total)));
+   BOOST_CHECK(total == 0);
+
+   my_aspect_map.insert<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(2, 3));
+
+   BOOST_CHECK(my_aspect_map.with<my_sum_aspect_test>(add_to(total)));
+   BOOST_CHECK(my_aspect_map.with<my_sum_aspect_test>(add_to(total)));
+   BOOST_CHECK(total == 10);
+}
+
+//
+// striped locking
+//
+
+template <int N>
+struct striped_aspect_test
+{
+   striped_aspect_test(int v) : value(v) {}
+   int value;
+};
+
+// exchanges the aspects N0 .. N0 + 7, more than one for each stripe
+template <int N0>
+void exchange_striped(application::aspect_map& my_aspect_map)
+{
+   for(int i = 1; i <= 1000; i++)
+   {
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 0> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 1> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 2> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 3> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 4> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 5> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 6> >(i));
+      my_aspect_map.exchange(make_shared< striped_aspect_test<N0 + 7> >(i));
+   }
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_striped_writers)
+{
+   application::aspect_map my_aspect_map;
+
+   boost::thread_group group;
+   group.create_thread(boost::bind(&exchange_striped<0>, boost::ref(my_aspect_map)));
+   group.create_thread(boost::bind(&exchange_striped<8>, boost::ref(my_aspect_map)));
+   group.create_thread(boost::bind(&exchange_striped<16>, boost::ref(my_aspect_map)));
+   group.create_thread(boost::bind(&exchange_striped<24>, boost::ref(my_aspect_map)));
+   group.join_all();
+
+   BOOST_CHECK(my_aspect_map.size() == 32);
+   BOOST_CHECK(my_aspect_map.find< striped_aspect_test<0> >()->value == 1000);
+   BOOST_CHECK(my_aspect_map.find< striped_aspect_test<17> >()->value == 1000);
+   BOOST_CHECK(my_aspect_map.find< striped_aspect_test<31> >()->value == 1000);
+
+   my_aspect_map.clear();
+   BOOST_CHECK(my_aspect_map.size() == 0);
+   BOOST_CHECK(!my_aspect_map.find< striped_aspect_test<31> >());
+}
+
+void exchange_sum(application::aspect_map& my_aspect_map)
+{
+   my_aspect_map.exchange<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(2, 2));
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_transaction_excludes_writers)
+{
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(1, 1));
+
+   boost::thread writer;
+
+   {
+      strict_lock<application::aspect_map> guard(my_aspect_map);
+
+      writer = boost::thread(boost::bind(&exchange_sum, boost::ref(my_aspect_map)));
+
+      // the writer waits for the transaction
+      BOOST_CHECK(!writer.try_join_for(boost::chrono::milliseconds(100)));
+      BOOST_CHECK(my_aspect_map.find<my_sum_aspect_test>(guard)->get() == 2);
+   }
+
+   writer.join();
+   BOOST_CHECK(my_aspect_map.find<my_sum_aspect_test>()->get() == 4);
+}
+
+//
+// batch lookup
+//
+
+BOOST_AUTO_TEST_CASE(aspect_map_find_all)
+{
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_sum_aspect_test>(boost::make_shared<my_sum_aspect_test>(2, 3));
+   my_aspect_map.insert< striped_aspect_test<40> >(make_shared< striped_aspect_test<40> >(40));
+
+   shared_ptr<my_sum_aspect_test> sum;
+   shared_ptr<my_msg_aspect_test> msg;
+   shared_ptr< striped_aspect_test<40> > striped;
+
+   std::tie(sum, msg, striped) =
+      my_aspect_map.find_all<my_sum_aspect_test, my_msg_aspect_test,
+                             striped_aspect_test<40> >();
+
+   BOOST_REQUIRE(sum);
+   BOOST_CHECK(sum->get() == 5);
+   BOOST_CHECK(!msg);
+   BOOST_CHECK(striped->value == 40);
+
+   {
+      strict_lock<application::aspect_map> guard(my_aspect_map);
+
+      my_aspect_map.insert<my_msg_aspect_test>(
+         boost::make_shared<my_msg_aspect_test>("HI"), guard);
+
+      std::tie(sum, msg) =
+         my_aspect_map.find_all<my_sum_aspect_test, my_msg_aspect_test>(guard);
+
+      BOOST_CHECK(sum->get() == 5);
+      BOOST_CHECK(msg->say_hi() == "HI");
+   }
+
+   application::aspect_map::read_guard guard(my_aspect_map);
+
+   std::tuple<my_msg_aspect_test*, striped_aspect_test<41>*> refs =
+      my_aspect_map.find_all<my_msg_aspect_test, striped_aspect_test<41> >(guard);
+
+   BOOST_CHECK(std::get<0>(refs)->say_hi() == "HI");
+   BOOST_CHECK(std::get<1>(refs) == 0);
+
+   application::aspect_map other_aspect_map;
+   BOOST_CHECK_THROW(other_aspect_map.find_all<my_msg_aspect_test>(guard), std::logic_error);
+}
+
+//
+// watch
+//
+
+struct record_msg
+{
+   record_msg(std::vector<std::string>& seen) : seen_(seen) {}
+
+   void operator()(const shared_ptr<my_msg_aspect_test>& asp) const
+   {
+      seen_.push_back(asp ? asp->say_hi() : "erased");
+   }
+
+   std::vector<std::string>& seen_;
+};
+
+BOOST_AUTO_TEST_CASE(aspect_map_version)
+{
+   application::aspect_map my_aspect_map;
+
+   const atomic<application::aspect_map::version_type>& version =
+      my_aspect_map.version_counter<my_msg_aspect_test>();
+
+   BOOST_CHECK(version == 0);
+
+   my_aspect_map.insert<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("HI"));
+   BOOST_CHECK(version == 1);
+
+   // already present, nothing changed
+   my_aspect_map.insert<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("BYE"));
+   BOOST_CHECK(version == 1);
+
+   my_aspect_map.exchange<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("HELLO"));
+   BOOST_CHECK(version == 2);
+
+   my_aspect_map.reduce<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("HI"),
+      &my_msg_aspect_test_reduction_function);
+   BOOST_CHECK(version == 3);
+
+   my_aspect_map.erase<my_msg_aspect_test>();
+   BOOST_CHECK(my_aspect_map.version<my_msg_aspect_test>() == 4);
+
+   // other aspects don't bump it
+   my_aspect_map.insert<my_sum_aspect_test>(make_shared<my_sum_aspect_test>(1, 1));
+   BOOST_CHECK(version == 4);
+
+   my_aspect_map.insert<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("HI"));
+   my_aspect_map.clear();
+   BOOST_CHECK(version == 6);
+   BOOST_CHECK(my_aspect_map.version<my_sum_aspect_test>() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_watch)
+{
+   application::aspect_map my_aspect_map;
+   std::vector<std::string> seen;
+
+   application::aspect_map::watch_handle handle =
+      my_aspect_map.watch<my_msg_aspect_test>(record_msg(seen));
+
+   my_aspect_map.insert<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("HI"));
+   my_aspect_map.insert<my_sum_aspect_test>(make_shared<my_sum_aspect_test>(1, 1));
+
+   {
+      strict_lock<application::aspect_map> guard(my_aspect_map);
+      my_aspect_map.exchange<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("BYE"), guard);
+   }
+
+   my_aspect_map.erase<my_msg_aspect_test>();
+
+   BOOST_REQUIRE(seen.size() == 3);
+   BOOST_CHECK(seen[0] == "HI");
+   BOOST_CHECK(seen[1] == "BYE");
+   BOOST_CHECK(seen[2] == "erased");
+
+   BOOST_CHECK(my_aspect_map.unwatch(handle));
+   BOOST_CHECK(!my_aspect_map.unwatch(handle));
+
+   my_aspect_map.insert<my_msg_aspect_test>(make_shared<my_msg_aspect_test>("HI"));
+   BOOST_CHECK(seen.size() == 3);
+}
+
+void watch_config(application::aspect_map& my_aspect_map, atomic<bool>& done,
+                  atomic<int>& refetches, int& last)
+{
+   const atomic<application::aspect_map::version_type>& version =
+      my_aspect_map.version_counter<my_sum_aspect_test>();
+
+   application::aspect_map::version_type seen = version.load();
+   shared_ptr<my_sum_aspect_test> config = my_aspect_map.find<my_sum_aspect_test>();
+
+   while(!done || version.load(boost::memory_order_acquire) != seen) {
+      if(version.load(boost::memory_order_acquire) != seen) {
+         seen = version.load(boost::memory_order_acquire);
+         config = my_aspect_map.find<my_sum_aspect_test>();
+         refetches++;
+      }
+   }
+
+   last = config->get();
+}
+
+BOOST_AUTO_TEST_CASE(aspect_map_version_hot_loop)
+{
+   application::aspect_map my_aspect_map;
+   my_aspect_map.insert<my_sum_aspect_test>(make_shared<my_sum_aspect_test>(0, 0));
+
+   // the counter exists before the reader starts
+   my_aspect_map.version_counter<my_sum_aspect_test>();
+
+   atomic<bool> done(false);
+   atomic<int> refetches(0);
+   int last = -1;
+
+   boost::thread reader(boost::bind(&watch_config, boost::ref(my_aspect_map),
+      boost::ref(done), boost::ref(refetches), boost::ref(last)));
+
+   for(int i = 1; i <= 100; i++)
+      my_aspect_map.exchange<my_sum_aspect_test>(make_shared<my_sum_aspect_test>(i, 0));
+
+   done = true;
+   reader.join();
+
+   // the reader sees the last config, and only refetches on changes
+   BOOST_CHECK(last == 100);
+   BOOST_CHECK(refetches <= 100);
+}
@@ -0,0 +1,206 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <boost/application.hpp>
+
+#include "allocation_counter.hpp"
+
+#define BOOST_TEST_MODULE ContextChain
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+template <int N>
+struct chain_aspect
+{
+   chain_aspect(int v) : value(v) {}
+   int value;
+};
+
+template <int N>
+struct read_value
+{
+   read_value(int& value) : value_(value) {}
+
+   void operator()(chain_aspect<N>& asp) const
+   {
+      value_ = asp.value;
+   }
+
+   int& value_;
+};
+
+BOOST_AUTO_TEST_CASE(child_lookups_fall_through)
+{
+   application::context parent;
+   parent.insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+   parent.insert< chain_aspect<1> >(make_shared< chain_aspect<1> >(1));
+
+   application::context child(&parent);
+   BOOST_CHECK(child.parent() == &parent);
+
+   BOOST_CHECK(child.find< chain_aspect<0> >()->value == 0);
+   BOOST_CHECK(child.count< chain_aspect<1> >() == 1);
+   BOOST_CHECK(child.count< chain_aspect<2> >() == 0);
+   BOOST_CHECK(child.size() == 0);
+
+   {
+      strict_lock<application::aspect_map> guard(child);
+      BOOST_CHECK(child.find< chain_aspect<1> >(guard)->value == 1);
+   }
+
+   {
+      application::aspect_map::read_guard guard(child);
+      BOOST_CHECK(child.find_ref< chain_aspect<0> >(guard)->value == 0);
+      BOOST_CHECK(!child.find_ref< chain_aspect<2> >(guard));
+   }
+
+   BOOST_CHECK(std::get<1>(
+      child.find_all< chain_aspect<2>, chain_aspect<1> >())->value == 1);
+
+   int value = -1;
+   BOOST_CHECK(child.with< chain_aspect<1> >(read_value<1>(value)));
+   BOOST_CHECK(value == 1);
+}
+
+BOOST_AUTO_TEST_CASE(child_writes_stay_local)
+{
+   application::context parent;
+   parent.insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+
+   application::context child(&parent);
+
+   // a new aspect
+   child.insert< chain_aspect<2> >(make_shared< chain_aspect<2> >(2));
+   BOOST_CHECK(child.find< chain_aspect<2> >()->value == 2);
+   BOOST_CHECK(!parent.find< chain_aspect<2> >());
+
+   // shadow the parent
+   child.insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(10));
+   BOOST_CHECK(child.find< chain_aspect<0> >()->value == 10);
+   BOOST_CHECK(parent.find< chain_aspect<0> >()->value == 0);
+
+   {
+      application::aspect_map::read_guard guard(child);
+      BOOST_CHECK(child.find_ref< chain_aspect<0> >(guard)->value == 10);
+   }
+
+   // erase only the one of child
+   child.erase< chain_aspect<0> >();
+   BOOST_CHECK(child.find< chain_aspect<0> >()->value == 0);
+   BOOST_CHECK(parent.count< chain_aspect<0> >() == 1);
+
+   child.clear();
+   BOOST_CHECK(child.size() == 0);
+   BOOST_CHECK(parent.size() == 1);
+   BOOST_CHECK(child.count< chain_aspect<0> >() == 1);
+}
+
+BOOST_AUTO_TEST_CASE(grandchild)
+{
+   application::context root;
+   root.insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+
+   application::context middle(&root);
+   middle.insert< chain_aspect<1> >(make_shared< chain_aspect<1> >(1));
+
+   application::context leaf(&middle);
+
+   BOOST_CHECK(leaf.find< chain_aspect<0> >()->value == 0);
+   BOOST_CHECK(leaf.find< chain_aspect<1> >()->value == 1);
+
+   application::aspect_map::read_guard guard(leaf);
+
+   // the parents are pinned by guard
+   root.exchange< chain_aspect<0> >(make_shared< chain_aspect<0> >(100));
+
+   BOOST_CHECK(leaf.find_ref< chain_aspect<0> >(guard)->value == 0);
+   BOOST_CHECK(leaf.find< chain_aspect<0> >()->value == 100);
+}
+
+BOOST_AUTO_TEST_CASE(child_of_global_context)
+{
+   application::global_context_ptr global =
+      application::global_context::create();
+
+   global->insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+
+   application::context child(application::global_context::get());
+   global.reset();
+
+   application::global_context::destroy();
+
+   // the child keeps the parent
+   BOOST_CHECK(child.find< chain_aspect<0> >()->value == 0);
+}
+
+BOOST_AUTO_TEST_CASE(child_creation_does_not_allocate)
+{
+   application::context parent;
+   parent.insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+
+   long sum = 0;
+
+   allocations = 0;
+   counting = true;
+
+   for(int i = 0; i < 1000; ++i) {
+      application::context child(&parent);
+      sum += child.find< chain_aspect<0> >()->value;
+   }
+
+   counting = false;
+
+   BOOST_CHECK(sum == 0);
+   BOOST_CHECK(allocations == 0);
+}
+
+BOOST_AUTO_TEST_CASE(read_guard_on_chain_does_not_allocate)
+{
+   application::context root;
+   root.insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+
+   application::context middle(&root);
+   application::context leaf(&middle);
+
+   long sum = 0;
+
+   allocations = 0;
+   counting = true;
+
+   for(int i = 0; i < 1000; ++i) {
+      application::aspect_map::read_guard guard(leaf);
+      sum += leaf.find_ref< chain_aspect<0> >(guard)->value;
+   }
+
+   counting = false;
+
+   BOOST_CHECK(sum == 0);
+   BOOST_CHECK(allocations == 0);
+}
+
+BOOST_AUTO_TEST_CASE(read_guard_on_deep_chain)
+{
+   // deeper than the levels inline on read_guard
+   std::vector< shared_ptr<application::context> > chain;
+   chain.push_back(make_shared<application::context>());
+   chain.back()->insert< chain_aspect<0> >(make_shared< chain_aspect<0> >(0));
+
+   for(int i = 0; i < 2 * BOOST_APPLICATION_READ_GUARD_DEPTH; ++i)
+      chain.push_back(make_shared<application::context>(chain.back().get()));
+
+   application::context& leaf = *chain.back();
+   application::aspect_map::read_guard guard(leaf);
+
+   chain.front()->exchange< chain_aspect<0> >(make_shared< chain_aspect<0> >(1));
+
+   BOOST_CHECK(leaf.find_ref< chain_aspect<0> >(guard)->value == 0);
+   BOOST_CHECK(leaf.find< chain_aspect<0> >()->value == 1);
+}
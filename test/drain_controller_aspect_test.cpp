@@ -0,0 +1,213 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <boost/application.hpp>
+#define BOOST_TEST_MODULE DrainControllerAspect
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+BOOST_AUTO_TEST_CASE(drain_controller_requests)
+{
+   application::drain_controller drain;
+
+   BOOST_CHECK(drain.in_flight() == 0);
+   BOOST_CHECK(!drain.draining());
+
+   {
+      application::drain_controller::request first(drain);
+      application::drain_controller::request second(drain);
+
+      BOOST_CHECK(first && second.accepted());
+      BOOST_CHECK(drain.in_flight() == 2);
+   }
+
+   BOOST_CHECK(drain.in_flight() == 0);
+
+   // nothing in flight
+   BOOST_CHECK(drain.drain());
+   BOOST_CHECK(drain.drained());
+   BOOST_CHECK(!drain.timed_out());
+
+   // refused
+   application::drain_controller::request late(drain);
+   BOOST_CHECK(!late);
+   BOOST_CHECK(drain.in_flight() == 0);
+}
+
+void requests(application::drain_controller& drain, int count)
+{
+   for(int i = 0; i < count; ++i)
+      application::drain_controller::request request(drain);
+}
+
+BOOST_AUTO_TEST_CASE(drain_controller_shards)
+{
+   application::drain_controller drain(chrono::seconds(30), 4);
+
+   thread_group group;
+   for(int t = 0; t < 8; ++t)
+      group.create_thread(boost::bind(&requests, boost::ref(drain), 100000));
+
+   group.join_all();
+
+   BOOST_CHECK(drain.in_flight() == 0);
+}
+
+void hold(application::drain_controller& drain, chrono::milliseconds ms,
+          barrier& entered)
+{
+   application::drain_controller::request request(drain);
+   entered.wait();
+
+   this_thread::sleep_for(ms);
+}
+
+BOOST_AUTO_TEST_CASE(drain_controller_waits_in_flight)
+{
+   application::drain_controller drain;
+   barrier entered(2);
+
+   thread holder(boost::bind(&hold, boost::ref(drain),
+      chrono::milliseconds(100), boost::ref(entered)));
+
+   entered.wait();
+
+   BOOST_CHECK(drain.drain());
+   BOOST_CHECK(drain.in_flight() == 0);
+   BOOST_CHECK(drain.drain_duration() >= chrono::milliseconds(50));
+   BOOST_CHECK(drain.abandoned() == 0);
+
+   holder.join();
+}
+
+BOOST_AUTO_TEST_CASE(drain_controller_deadline)
+{
+   application::drain_controller drain(chrono::milliseconds(50));
+   barrier entered(2);
+
+   thread holder(boost::bind(&hold, boost::ref(drain),
+      chrono::milliseconds(500), boost::ref(entered)));
+
+   entered.wait();
+
+   BOOST_CHECK(!drain.drain());
+   BOOST_CHECK(drain.timed_out());
+   BOOST_CHECK(drain.abandoned() == 1);
+   BOOST_CHECK(drain.drain_duration() < chrono::milliseconds(400));
+
+   holder.join();
+}
+
+bool terminate_handler()
+{
+   return true;
+}
+
+BOOST_AUTO_TEST_CASE(drain_controller_signal_manager)
+{
+   asio::io_service io_service;
+   application::context cxt;
+
+   shared_ptr<application::drain_controller> drain =
+      make_shared<application::drain_controller>();
+
+   cxt.insert<application::drain_controller>(drain);
+
+   cxt.insert<application::termination_handler>(
+      make_shared<application::termination_handler_default_behaviour>(
+         application::handler<>::callback(&terminate_handler)));
+
+   application::signal_manager sm(cxt, io_service);
+
+   barrier entered(2);
+   thread holder(boost::bind(&hold, boost::ref(*drain),
+      chrono::milliseconds(100), boost::ref(entered)));
+
+   entered.wait();
+
+   raise(SIGTERM);
+
+   // the signal handler returns, the drain goes on its thread
+   while(!drain->draining() && io_service.run_one())
+      ;
+
+   BOOST_CHECK(cxt.find<application::status>()->state()
+      == application::status::running);
+
+   // released when the request in flight is done
+   cxt.find<application::wait_for_termination_request>()->wait();
+
+   BOOST_CHECK(drain->drained());
+   BOOST_CHECK(drain->in_flight() == 0);
+   BOOST_CHECK(drain->drain_duration() >= chrono::milliseconds(50));
+   BOOST_CHECK(cxt.find<application::status>()->state()
+      == application::status::stopped);
+
+   holder.join();
+}
+
+void hold_until(application::drain_controller& drain, barrier& entered,
+                barrier& released)
+{
+   application::drain_controller::request request(drain);
+   entered.wait();
+
+   released.wait();
+}
+
+BOOST_AUTO_TEST_CASE(drain_controller_second_signal_forces)
+{
+   asio::io_service io_service;
+   application::context cxt;
+
+   shared_ptr<application::drain_controller> drain =
+      make_shared<application::drain_controller>(chrono::seconds(30));
+
+   cxt.insert<application::drain_controller>(drain);
+
+   cxt.insert<application::termination_handler>(
+      make_shared<application::termination_handler_default_behaviour>(
+         application::handler<>::callback(&terminate_handler)));
+
+   application::signal_manager sm(cxt, io_service);
+
+   barrier entered(2), released(2);
+   thread holder(boost::bind(&hold_until, boost::ref(*drain),
+      boost::ref(entered), boost::ref(released)));
+
+   entered.wait();
+
+   raise(SIGTERM);
+
+   while(!drain->draining() && io_service.run_one())
+      ;
+
+   BOOST_CHECK(!drain->drained());
+
+   // the request is still in flight, the second signal ends the drain
+   raise(SIGTERM);
+
+   while(!drain->forced() && io_service.run_one())
+      ;
+
+   cxt.find<application::wait_for_termination_request>()->wait();
+
+   BOOST_CHECK(drain->drained());
+   BOOST_CHECK(drain->forced());
+   BOOST_CHECK(!drain->timed_out());
+   BOOST_CHECK(drain->abandoned() == 1);
+   BOOST_CHECK(drain->drain_duration() < chrono::seconds(10));
+   BOOST_CHECK(cxt.find<application::status>()->state()
+      == application::status::stopped);
+
+   released.wait();
+   holder.join();
+}
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <boost/application.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/barrier.hpp>
 
 using namespace boost;
 
@@ -73,14 +74,131 @@ BOOST_AUTO_TEST_CASE(throw_before_create_global_context)
    BOOST_CHECK_THROW(application::global_context::get(), boost::system::system_error);
 }
 
+struct global_aspect_test
+{
+   int value;
+};
+
+BOOST_AUTO_TEST_CASE(read_guard_global_context)
+{
+   BOOST_CHECK_THROW(application::global_context::read_guard(), boost::system::system_error);
+
+   application::global_context_ptr ctx =
+           application::global_context::create();
+
+   global_aspect_test asp = { 42 };
+   ctx->insert<global_aspect_test>(boost::make_shared<global_aspect_test>(asp));
+   ctx.reset();
+
+   {
+      application::global_context::read_guard guard;
+
+      global_aspect_test* borrowed = guard.find_ref<global_aspect_test>();
+      BOOST_REQUIRE(borrowed != 0);
+
+      // the guard keeps the context and its aspects alive
+      application::global_context::destroy();
+      BOOST_CHECK(borrowed->value == 42);
+      BOOST_CHECK(guard.context().count<global_aspect_test>() == 1);
+   }
+
+   BOOST_CHECK_THROW(application::global_context::get(), boost::system::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(instance_global_context)
+{
+   BOOST_CHECK_THROW(application::global_context::instance(), boost::system::system_error);
+
+   application::global_context_ptr ctx =
+           application::global_context::create();
+
+   BOOST_CHECK(application::global_context::instance() == ctx.get());
+   BOOST_CHECK(application::global_context::instance() == ctx.get());
+
+   ctx.reset();
+   application::global_context::destroy();
+
+   boost::system::error_code ec;
+   BOOST_CHECK(application::global_context::instance(ec) == 0);
+   BOOST_CHECK(ec);
+
+   // the cache is invalidated by create
+   ctx = application::global_context::create();
+   BOOST_CHECK(application::global_context::instance(ec) == ctx.get());
+   BOOST_CHECK(!ec);
+
+   application::global_context::destroy();
+}
+
+void instance_on_thread(application::global_context* expected, bool& ok)
+{
+   ok = (application::global_context::instance() == expected);
+}
+
+BOOST_AUTO_TEST_CASE(instance_global_context_on_threads)
+{
+   application::global_context_ptr ctx =
+           application::global_context::create();
+
+   bool ok = false;
+   boost::thread t(boost::bind(&instance_on_thread, ctx.get(), boost::ref(ok)));
+   t.join();
+
+   BOOST_CHECK(ok);
+
+   application::global_context::destroy();
+}
+
+struct global_counted_aspect
+{
+   static boost::atomic<int> alive;
+
+   global_counted_aspect() { ++alive; }
+   ~global_counted_aspect() { --alive; }
+};
 
+boost::atomic<int> global_counted_aspect::alive(0);
 
+// calls instance(), and again after the main thread destroyed and
+// recreated the global context
+void instance_across_destroy(boost::barrier& step,
+   application::global_context*& first, application::global_context*& second)
+{
+   first = application::global_context::instance();
+   step.wait();
 
+   // destroy() and create() by main thread
+   step.wait();
+   second = application::global_context::instance();
+}
 
+BOOST_AUTO_TEST_CASE(instance_global_context_destroy_then_recreate)
+{
+   application::global_context::create()->insert<global_counted_aspect>(
+      make_shared<global_counted_aspect>());
 
+   boost::barrier step(2);
+   application::global_context* first = 0;
+   application::global_context* second = 0;
 
+   boost::thread t(boost::bind(&instance_across_destroy,
+      boost::ref(step), boost::ref(first), boost::ref(second)));
 
+   step.wait();
+   BOOST_CHECK(first != 0);
 
+   // the caches of threads don't keep the context, nor its aspects, alive
+   application::global_context::instance();
+   application::global_context::destroy();
+   BOOST_CHECK(global_counted_aspect::alive == 0);
 
+   application::global_context_ptr ctx = application::global_context::create();
+   step.wait();
+   t.join();
 
+   BOOST_CHECK(second == ctx.get());
+   BOOST_CHECK(application::global_context::instance() == ctx.get());
 
+   ctx.reset();
+   application::global_context::destroy();
+}
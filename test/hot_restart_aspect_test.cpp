@@ -0,0 +1,366 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <boost/application.hpp>
+#include <boost/application/aspects/hot_restart.hpp>
+#define BOOST_TEST_MODULE HotRestartAspect
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+
+using namespace boost;
+
+// The new instance is this test executable, started by restart(). It
+// runs before the test module: take the listening socket, report ready,
+// then serve one connection.
+struct new_instance
+{
+   new_instance()
+   {
+      if(!getenv("BOOST_APPLICATION_HOT_RESTART_FD"))
+         return;
+
+      system::error_code ec;
+      application::hot_restart restart(ec);
+
+      if(ec || !restart.inherited() || restart.fds().size() != 1)
+         _exit(1);
+
+      int type = 0;
+      socklen_t len = sizeof(type);
+      if(getsockopt(restart.fds()[0], SOL_SOCKET, SO_TYPE, &type, &len) != 0
+         || type != SOCK_STREAM)
+         _exit(2);
+
+      if(restart.state() == "not ready")
+         _exit(3);
+
+      if(restart.state() == "slow")
+         usleep(500 * 1000);
+
+      // like a daemon, the new instance is a grandchild of the previous
+      // one, "fork hang <file>" writes its pid to file and never is ready
+      if(restart.state().compare(0, 4, "fork") == 0) {
+         pid_t pid = fork();
+         if(pid != 0)
+            _exit(pid < 0 ? 7 : 0);
+
+         restart.report_pid(ec);
+         if(ec)
+            _exit(8);
+
+         if(restart.state().compare(0, 10, "fork hang ") == 0) {
+            std::ofstream(restart.state().substr(10).c_str()) << getpid();
+            for(;;)
+               pause();
+         }
+      }
+
+      restart.ready(ec);
+      if(ec)
+         _exit(4);
+
+      // serve with the state received
+      int client = accept(restart.fds()[0], 0, 0);
+      if(client == -1)
+         _exit(5);
+
+      ssize_t r = write(client, restart.state().data(), restart.state().size());
+      close(client);
+
+      _exit(r == (ssize_t)restart.state().size() ? 0 : 6);
+   }
+} new_instance_;
+
+std::string state(const std::string& value)
+{
+   return value;
+}
+
+// connect to listener and read what the instance writes
+std::string request(asio::io_service& io_service,
+                    const asio::ip::tcp::endpoint& endpoint)
+{
+   asio::ip::tcp::socket socket(io_service);
+   socket.connect(endpoint);
+
+   std::string reply;
+   char buffer[64];
+   system::error_code ec;
+
+   for(;;) {
+      std::size_t n = socket.read_some(asio::buffer(buffer), ec);
+      if(ec) break;
+      reply.append(buffer, n);
+   }
+
+   return reply;
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_not_inherited)
+{
+   application::hot_restart restart;
+
+   BOOST_CHECK(!restart.inherited());
+   BOOST_CHECK(restart.fds().empty());
+   BOOST_CHECK(restart.channel() == -1);
+   BOOST_CHECK(restart.trigger_signal() == SIGUSR2);
+
+   restart.ready(); // nothing to do
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_handover)
+{
+   asio::io_service io_service;
+   asio::ip::tcp::acceptor listener(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   asio::ip::tcp::endpoint endpoint = listener.local_endpoint();
+
+   application::hot_restart restart;
+   restart.handover_fds(std::vector<int>(1, listener.native_handle()));
+   restart.state_handler(boost::bind(&state, std::string("state 42")));
+
+   pid_t pid = restart.restart();
+   BOOST_REQUIRE(pid > 0);
+
+   // the old instance drains, the new one serves on the same socket
+   listener.close();
+
+   BOOST_CHECK(request(io_service, endpoint) == "state 42");
+
+   int status = -1;
+   waitpid(pid, &status, 0);
+   BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_new_instance_fails)
+{
+   asio::io_service io_service;
+   asio::ip::tcp::acceptor listener(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   application::hot_restart restart;
+   restart.handover_fds(std::vector<int>(1, listener.native_handle()));
+   restart.state_handler(boost::bind(&state, std::string("not ready")));
+
+   system::error_code ec;
+   BOOST_CHECK(restart.restart(ec) == 0);
+   BOOST_CHECK(ec);
+
+   // exec fails
+   restart.command(std::vector<std::string>(1, "/nonexistent/binary"));
+   BOOST_CHECK(restart.restart(ec) == 0);
+   BOOST_CHECK(ec);
+
+   // the listener is still ours
+   BOOST_CHECK(listener.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_daemonized_instance)
+{
+   // the grandchildren are reparented to this process
+   BOOST_REQUIRE(prctl(PR_SET_CHILD_SUBREAPER, 1) == 0);
+
+   asio::io_service io_service;
+   asio::ip::tcp::acceptor listener(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   asio::ip::tcp::endpoint endpoint = listener.local_endpoint();
+
+   application::hot_restart restart;
+   restart.handover_fds(std::vector<int>(1, listener.native_handle()));
+
+   // fails after the daemon reported its pid, the daemon is killed
+   std::string file = "hot_restart_daemon.pid";
+   restart.state_handler(boost::bind(&state, "fork hang " + file));
+   restart.ready_timeout(500);
+
+   system::error_code ec;
+   BOOST_CHECK(restart.restart(ec) == 0);
+   BOOST_CHECK(ec);
+
+   pid_t daemon = 0;
+   std::ifstream(file.c_str()) >> daemon;
+   std::remove(file.c_str());
+   BOOST_REQUIRE(daemon > 0);
+
+   int status = -1;
+   BOOST_CHECK(waitpid(daemon, &status, 0) == daemon);
+   BOOST_CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+
+   // ready, the pid returned is the daemon
+   restart.state_handler(boost::bind(&state, std::string("fork")));
+   restart.ready_timeout(30000);
+
+   pid_t pid = restart.restart(ec);
+   BOOST_REQUIRE(!ec && pid > 0);
+
+   listener.close();
+   BOOST_CHECK(request(io_service, endpoint) == "fork");
+
+   status = -1;
+   BOOST_CHECK(waitpid(pid, &status, 0) == pid);
+   BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+   prctl(PR_SET_CHILD_SUBREAPER, 0);
+}
+
+bool drained = false;
+
+void drain()
+{
+   drained = true;
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_signal_manager)
+{
+   asio::io_service io_service;
+   asio::ip::tcp::acceptor listener(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   asio::ip::tcp::endpoint endpoint = listener.local_endpoint();
+
+   application::context cxt;
+
+   shared_ptr<application::hot_restart> restart =
+      make_shared<application::hot_restart>();
+
+   restart->handover_fds(std::vector<int>(1, listener.native_handle()));
+   restart->state_handler(boost::bind(&state, std::string("signal")));
+   restart->drain_handler(&drain);
+
+   cxt.insert<application::hot_restart>(restart);
+
+   application::signal_manager sm(cxt, io_service);
+
+   shared_ptr<application::status> st = cxt.find<application::status>();
+
+   // the handover runs on the thread of hot_restart
+   thread signals(boost::bind(&asio::io_service::run, &io_service));
+
+   raise(SIGUSR2);
+
+   // proceed is called when the new instance is ready and this one drained
+   cxt.find<application::wait_for_termination_request>()->wait();
+
+   BOOST_CHECK(drained);
+   BOOST_CHECK(st->state() == application::status::stopped);
+
+   io_service.stop();
+   signals.join();
+
+   listener.close();
+   BOOST_CHECK(request(io_service, endpoint) == "signal");
+}
+
+atomic<bool> other_signal(false);
+
+bool other_signal_handler()
+{
+   other_signal = true;
+   return false;
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_signal_thread_not_blocked)
+{
+   asio::io_service io_service;
+   asio::ip::tcp::acceptor listener(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   asio::ip::tcp::endpoint endpoint = listener.local_endpoint();
+
+   application::context cxt;
+
+   shared_ptr<application::hot_restart> restart =
+      make_shared<application::hot_restart>();
+
+   restart->handover_fds(std::vector<int>(1, listener.native_handle()));
+   restart->state_handler(boost::bind(&state, std::string("slow")));
+
+   cxt.insert<application::hot_restart>(restart);
+
+   application::signal_manager sm(cxt, io_service);
+
+   sm.bind(SIGRTMIN + 7, application::handler<>(&other_signal_handler));
+
+   thread signals(boost::bind(&asio::io_service::run, &io_service));
+
+   raise(SIGUSR2);
+
+   while(!restart->restarting())
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+   // serviced while the new instance gets ready
+   raise(SIGRTMIN + 7);
+
+   while(!other_signal)
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+   BOOST_CHECK(restart->restarting());
+
+   cxt.find<application::wait_for_termination_request>()->wait();
+
+   io_service.stop();
+   signals.join();
+
+   listener.close();
+   BOOST_CHECK(request(io_service, endpoint) == "slow");
+}
+
+system::error_code failure;
+atomic<bool> reported(false);
+
+void failed(const system::error_code& ec)
+{
+   failure = ec;
+   reported = true;
+}
+
+BOOST_AUTO_TEST_CASE(hot_restart_signal_manager_failure)
+{
+   asio::io_service io_service;
+   asio::ip::tcp::acceptor listener(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   application::context cxt;
+
+   shared_ptr<application::hot_restart> restart =
+      make_shared<application::hot_restart>();
+
+   restart->handover_fds(std::vector<int>(1, listener.native_handle()));
+   restart->state_handler(boost::bind(&state, std::string("not ready")));
+   restart->failure_handler(&failed);
+
+   cxt.insert<application::hot_restart>(restart);
+
+   application::signal_manager sm(cxt, io_service);
+
+   thread signals(boost::bind(&asio::io_service::run, &io_service));
+
+   raise(SIGUSR2);
+
+   while(!reported)
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+   restart->join();
+
+   io_service.stop();
+   signals.join();
+
+   // reported, and we go on
+   BOOST_CHECK(failure);
+   BOOST_CHECK(cxt.find<application::status>()->state()
+      == application::status::running);
+   BOOST_CHECK(listener.is_open());
+}
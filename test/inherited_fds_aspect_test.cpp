@@ -0,0 +1,93 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <boost/application.hpp>
+#include <boost/application/aspects/inherited_fds.hpp>
+#include <boost/application/detail/posix/close_fds_impl.hpp>
+#define BOOST_TEST_MODULE InheritedFdsAspect
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+
+using namespace boost;
+
+bool is_open(int fd)
+{
+   return fcntl(fd, F_GETFD) != -1;
+}
+
+typedef bool (*close_fds_type)(int, const std::vector<int>&);
+
+void check_close_fds(close_fds_type close_fds)
+{
+   std::vector<int> fds;
+   for(int i = 0; i < 8; ++i)
+      fds.push_back(dup(0));
+
+   // keep 2 of them, one in the middle and the last
+   std::vector<int> keep;
+   keep.push_back(fds[3]);
+   keep.push_back(fds[7]);
+
+   if(!close_fds(fds[0], keep)) {
+      std::cout << "skipped, not available" << std::endl;
+
+      for(std::size_t i = 0; i < fds.size(); ++i)
+         close(fds[i]);
+
+      return;
+   }
+
+   for(std::size_t i = 0; i < fds.size(); ++i) {
+      if(i == 3 || i == 7)
+         BOOST_CHECK(is_open(fds[i]));
+      else
+         BOOST_CHECK(!is_open(fds[i]));
+   }
+
+   BOOST_CHECK(is_open(0));
+
+   close(fds[3]);
+   close(fds[7]);
+}
+
+BOOST_AUTO_TEST_CASE(close_fds_range)
+{
+   check_close_fds(&application::detail::close_fds_range);
+}
+
+BOOST_AUTO_TEST_CASE(close_fds_proc)
+{
+   check_close_fds(&application::detail::close_fds_proc);
+}
+
+BOOST_AUTO_TEST_CASE(close_fds_loop)
+{
+   check_close_fds(&application::detail::close_fds_loop);
+}
+
+BOOST_AUTO_TEST_CASE(inherited_fds_aspect)
+{
+   application::context cxt;
+
+   cxt.insert<application::inherited_fds>(
+      make_shared<application::inherited_fds>(5));
+
+   shared_ptr<application::inherited_fds> inherited =
+      cxt.find<application::inherited_fds>();
+
+   inherited->add(7);
+   inherited->add(5);
+
+   BOOST_CHECK(inherited->fds().size() == 2);
+   BOOST_CHECK(inherited->contains(7));
+   BOOST_CHECK(!inherited->contains(6));
+}
@@ -0,0 +1,149 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <boost/application.hpp>
+#define BOOST_TEST_MODULE IoServicePoolAspect
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+struct where
+{
+   thread::id id;
+   int cpu;
+};
+
+void record(where& w)
+{
+   w.id = this_thread::get_id();
+#if BOOST_OS_LINUX
+   w.cpu = sched_getcpu();
+#else
+   w.cpu = -1;
+#endif
+}
+
+// run a handler on each io_service, and wait for them
+std::vector<where> run_on_each(application::io_service_pool& pool)
+{
+   std::vector<where> places(pool.size());
+
+   for(std::size_t i = 0; i < pool.size(); ++i) {
+      asio::io_service::work work(pool.get_io_service(i));
+
+      packaged_task<void> task(boost::bind(&record, boost::ref(places[i])));
+      unique_future<void> done = task.get_future();
+
+      pool.get_io_service(i).post(boost::bind(&packaged_task<void>::operator(), &task));
+      done.wait();
+   }
+
+   return places;
+}
+
+BOOST_AUTO_TEST_CASE(io_service_pool_size)
+{
+   application::io_service_pool pool;
+   BOOST_CHECK(pool.size() == (thread::hardware_concurrency() ? thread::hardware_concurrency() : 1));
+
+   application::io_service_pool four(4);
+   BOOST_CHECK(four.size() == 4);
+
+   // round robin
+   BOOST_CHECK(&four.get_io_service() == &four.get_io_service(0));
+   BOOST_CHECK(&four.get_io_service() == &four.get_io_service(1));
+   BOOST_CHECK(four.cpu(0) == -1);
+}
+
+BOOST_AUTO_TEST_CASE(io_service_pool_threads)
+{
+   application::io_service_pool pool(4);
+
+   pool.start();
+   BOOST_CHECK(pool.running());
+
+   std::vector<where> places = run_on_each(pool);
+
+   for(std::size_t i = 0; i < places.size(); ++i) {
+      BOOST_CHECK(places[i].id != this_thread::get_id());
+
+      for(std::size_t j = i + 1; j < places.size(); ++j)
+         BOOST_CHECK(places[i].id != places[j].id);
+
+#if BOOST_OS_LINUX
+      // a thread pinned runs only there
+      BOOST_CHECK(pool.cpu(i) >= 0);
+      BOOST_CHECK(places[i].cpu == pool.cpu(i));
+#endif
+   }
+
+   // same thread every time
+   BOOST_CHECK(run_on_each(pool)[2].id == places[2].id);
+
+   system::error_code ec;
+   pool.start(ec);
+   BOOST_CHECK(ec);
+
+   pool.stop();
+   BOOST_CHECK(!pool.running());
+}
+
+BOOST_AUTO_TEST_CASE(io_service_pool_not_pinned)
+{
+   application::io_service_pool pool(2);
+   pool.pin_to_cpu(false);
+   pool.numa_aware(true);
+
+   pool.start();
+
+   BOOST_CHECK(pool.cpu(0) == -1);
+   BOOST_CHECK(pool.cpu(1) == -1);
+
+   // restart
+   pool.stop();
+   pool.start();
+
+   BOOST_CHECK(run_on_each(pool).size() == 2);
+}
+
+void terminate(application::context& cxt)
+{
+   this_thread::sleep_for(chrono::milliseconds(50));
+
+   cxt.find<application::status>()->state(application::status::stopped);
+   cxt.find<application::wait_for_termination_request>()->proceed();
+}
+
+BOOST_AUTO_TEST_CASE(io_service_pool_run)
+{
+   application::context cxt;
+
+   cxt.insert<application::status>(
+      make_shared<application::status>(application::status::running));
+
+   cxt.insert<application::wait_for_termination_request>(
+      shared_ptr<application::wait_for_termination_request>(
+         new application::wait_for_termination_request_default_behaviour));
+
+   shared_ptr<application::io_service_pool> pool =
+      make_shared<application::io_service_pool>(2);
+
+   cxt.insert<application::io_service_pool>(pool);
+
+   // a termination request from a handler of pool
+   pool->get_io_service(1).post(boost::bind(&terminate, boost::ref(cxt)));
+
+   BOOST_CHECK(pool->run(cxt) == 0);
+   BOOST_CHECK(!pool->running());
+
+   // already stopped, don't wait
+   BOOST_CHECK(pool->run(cxt) == 0);
+}
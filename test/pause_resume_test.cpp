@@ -0,0 +1,227 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <boost/application.hpp>
+#define BOOST_TEST_MODULE PauseResume
+#include <boost/test/unit_test.hpp>
+
+#include <time.h>
+
+using namespace boost;
+
+// cpu time of process
+chrono::milliseconds cpu_time()
+{
+   timespec ts;
+   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+   return chrono::milliseconds(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+chrono::milliseconds cpu_time_for(chrono::milliseconds interval)
+{
+   chrono::milliseconds start = cpu_time();
+   this_thread::sleep_for(interval);
+
+   return cpu_time() - start;
+}
+
+void spin(chrono::milliseconds duration)
+{
+   chrono::steady_clock::time_point until = chrono::steady_clock::now() + duration;
+
+   while(chrono::steady_clock::now() < until)
+      ;
+}
+
+atomic<bool> loading(true);
+atomic<long> queue_tasks(0);
+atomic<long> pool_handlers(0);
+
+// busy tasks, that add themselves again
+void queue_load(application::work_queue& queue)
+{
+   spin(chrono::milliseconds(1));
+   queue_tasks++;
+
+   if(loading)
+      queue.add_task(boost::bind(&queue_load, boost::ref(queue)));
+}
+
+void pool_load(asio::io_service& io_service)
+{
+   spin(chrono::milliseconds(1));
+   pool_handlers++;
+
+   if(loading)
+      io_service.post(boost::bind(&pool_load, boost::ref(io_service)));
+}
+
+bool accept_handler()
+{
+   return true;
+}
+
+bool refuse_handler()
+{
+   return false;
+}
+
+void run_until(asio::io_service& io_service, application::status& st,
+               application::status::application_state state)
+{
+   while(st.state() != state && io_service.run_one())
+      ;
+}
+
+BOOST_AUTO_TEST_CASE(pause_resume_quiesce_workers)
+{
+   asio::io_service io_service;
+   application::context cxt;
+
+   shared_ptr<application::pause_handler> ph =
+      make_shared<application::pause_handler_default_behaviour>(
+         application::handler<>::callback(&accept_handler));
+
+   cxt.insert<application::pause_handler>(ph);
+
+   shared_ptr<application::resume_handler> rh =
+      make_shared<application::resume_handler_default_behaviour>(
+         application::handler<>::callback(&accept_handler));
+
+   cxt.insert<application::resume_handler>(rh);
+
+   shared_ptr<application::work_queue> queue =
+      make_shared<application::work_queue>(2);
+
+   shared_ptr<application::io_service_pool> pool =
+      make_shared<application::io_service_pool>(2);
+
+   cxt.insert<application::work_queue>(queue);
+   cxt.insert<application::io_service_pool>(pool);
+
+   // the workers park at their safe points while paused
+   ph->add_hook(boost::bind(&application::work_queue::pause, queue));
+   ph->add_hook(boost::bind(&application::io_service_pool::pause, pool));
+   rh->add_hook(boost::bind(&application::work_queue::resume, queue));
+   rh->add_hook(boost::bind(&application::io_service_pool::resume, pool));
+
+   application::signal_manager sm(cxt, io_service);
+
+   shared_ptr<application::status> st = cxt.find<application::status>();
+
+   pool->start();
+
+   for(std::size_t i = 0; i < queue->size(); ++i)
+      queue->add_task(boost::bind(&queue_load, boost::ref(*queue)));
+
+   for(std::size_t i = 0; i < pool->size(); ++i)
+      pool->get_io_service(i).post(
+         boost::bind(&pool_load, boost::ref(pool->get_io_service(i))));
+
+   // busy
+   BOOST_CHECK(cpu_time_for(chrono::milliseconds(300))
+      > chrono::milliseconds(150));
+
+   raise(ph->signal_number());
+   run_until(io_service, *st, application::status::paused);
+
+   BOOST_CHECK(st->state() == application::status::paused);
+   BOOST_CHECK(queue->paused());
+   BOOST_CHECK(pool->paused());
+
+   // the running tasks end at their safe points
+   this_thread::sleep_for(chrono::milliseconds(50));
+
+   long tasks = queue_tasks;
+   long handlers = pool_handlers;
+
+   chrono::milliseconds paused_cpu = cpu_time_for(chrono::milliseconds(300));
+   std::cout << "cpu time while paused: " << paused_cpu << std::endl;
+
+   BOOST_CHECK(paused_cpu < chrono::milliseconds(30));
+   BOOST_CHECK(queue_tasks == tasks);
+   BOOST_CHECK(pool_handlers == handlers);
+
+   raise(rh->signal_number());
+   run_until(io_service, *st, application::status::running);
+
+   BOOST_CHECK(st->state() == application::status::running);
+   BOOST_CHECK(!queue->paused());
+
+   this_thread::sleep_for(chrono::milliseconds(100));
+
+   BOOST_CHECK(queue_tasks > tasks);
+   BOOST_CHECK(pool_handlers > handlers);
+   BOOST_CHECK(st->paused_duration() >= chrono::milliseconds(300));
+
+   loading = false;
+   queue->stop();
+   pool->stop();
+}
+
+BOOST_AUTO_TEST_CASE(pause_refused)
+{
+   asio::io_service io_service;
+   application::context cxt;
+
+   cxt.insert<application::pause_handler>(
+      make_shared<application::pause_handler_default_behaviour>(
+         application::handler<>::callback(&refuse_handler)));
+
+   application::signal_manager sm(cxt, io_service);
+
+   shared_ptr<application::status> st = cxt.find<application::status>();
+
+   raise(cxt.find<application::pause_handler>()->signal_number());
+   io_service.run_one();
+
+   BOOST_CHECK(st->state() == application::status::running);
+}
+
+BOOST_AUTO_TEST_CASE(pause_resume_with_hot_restart)
+{
+   asio::io_service io_service;
+   application::context cxt;
+
+   cxt.insert<application::hot_restart>(
+      make_shared<application::hot_restart>());
+
+   cxt.insert<application::pause_handler>(
+      make_shared<application::pause_handler_default_behaviour>(
+         application::handler<>::callback(&accept_handler)));
+
+   shared_ptr<application::resume_handler> rh =
+      make_shared<application::resume_handler_default_behaviour>(
+         application::handler<>::callback(&accept_handler));
+
+   cxt.insert<application::resume_handler>(rh);
+
+   // the default signals don't collide
+   {
+      system::error_code ec;
+      application::signal_manager sm(cxt, io_service, ec);
+
+      BOOST_CHECK(!ec);
+      BOOST_CHECK(sm.is_bound(cxt.find<application::hot_restart>()->trigger_signal()));
+      BOOST_CHECK(sm.is_bound(cxt.find<application::pause_handler>()->signal_number()));
+      BOOST_CHECK(sm.is_bound(rh->signal_number()));
+   }
+
+   // resume on the hot_restart signal is refused
+   rh->signal_number(cxt.find<application::hot_restart>()->trigger_signal());
+
+   {
+      system::error_code ec;
+      application::signal_manager sm(cxt, io_service, ec);
+
+      BOOST_CHECK(ec == system::errc::device_or_resource_busy);
+   }
+}
@@ -0,0 +1,245 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <boost/application.hpp>
+#include <boost/application/prefork_server_application.hpp>
+#define BOOST_TEST_MODULE PreforkServerApplication
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+// the workers report to the test on this pipe
+int report[2];
+
+void report_line(const std::string& line)
+{
+   std::string data = line + "\n";
+   ssize_t r = write(report[1], data.data(), data.size());
+   (void) r;
+}
+
+// the threads of the process that forked this one, 0 if unknown
+int parent_threads()
+{
+   std::ifstream status(("/proc/" + lexical_cast<std::string>(getppid())
+      + "/status").c_str());
+
+   std::string line;
+   while(std::getline(status, line)) {
+      if(line.compare(0, 8, "Threads:") == 0)
+         return lexical_cast<int>(line.substr(line.find_first_not_of(" \t", 8)));
+   }
+
+   return 0;
+}
+
+class myapp
+{
+public:
+   myapp(application::context& context)
+      : context_(context) { }
+
+   int operator()()
+   {
+      std::ostringstream line;
+      line << "start " << context_.find<application::worker_pool>()->worker_index()
+           << " " << context_.find<application::process_id>()->pid()
+           << " " << getppid() << " " << parent_threads();
+
+      report_line(line.str());
+
+      // terminated by signal_manager of worker
+      context_.find<application::wait_for_termination_request>()->wait();
+
+      report_line("stop");
+      return 0;
+   }
+
+private:
+   application::context& context_;
+};
+
+bool terminate_handler()
+{
+   return true;
+}
+
+std::string read_line()
+{
+   std::string line;
+   char c;
+
+   while(read(report[0], &c, 1) == 1 && c != '\n')
+      line += c;
+
+   return line;
+}
+
+struct worker_info
+{
+   int index;
+   pid_t pid;
+   pid_t parent;
+   int parent_threads;
+};
+
+worker_info parse(const std::string& line)
+{
+   std::istringstream in(line);
+   std::string word;
+   worker_info info = { -1, 0, 0, 0 };
+
+   in >> word >> info.index >> info.pid >> info.parent >> info.parent_threads;
+   return info;
+}
+
+std::vector<std::string> lines;
+
+void drive_master()
+{
+   worker_info first = parse(read_line());
+   worker_info second = parse(read_line());
+
+   lines.push_back(first.pid != second.pid ? "two workers" : "");
+
+   // crash one worker, it is restarted on same slot
+   kill(first.pid, SIGKILL);
+
+   worker_info restarted = parse(read_line());
+   lines.push_back(restarted.index == first.index && restarted.pid != first.pid
+                   ? "restarted" : "");
+
+   // forked by the fork server, that has a single thread, not by master
+   lines.push_back(restarted.parent != getpid()
+                   && restarted.parent == first.parent
+                   && restarted.parent_threads == 1 ? "fork server" : "");
+
+   // fan-out to workers
+   kill(getpid(), SIGTERM);
+
+   lines.push_back(read_line());
+   lines.push_back(read_line());
+}
+
+BOOST_AUTO_TEST_CASE(prefork_server_application)
+{
+   BOOST_REQUIRE(pipe(report) == 0);
+
+   application::context app_context;
+   myapp app(app_context);
+
+   shared_ptr<application::worker_pool> pool =
+      make_shared<application::worker_pool>(2);
+
+   pool->daemonize(false);
+   pool->backoff(50, 1000);
+
+   app_context.insert<application::worker_pool>(pool);
+
+   app_context.insert<application::termination_handler>(
+      make_shared<application::termination_handler_default_behaviour>(
+         application::handler<>::callback(&terminate_handler)));
+
+   thread driver(&drive_master);
+
+   boost::system::error_code ec;
+   int ret = application::launch<application::prefork_server>(app, app_context, ec);
+
+   driver.join();
+
+   BOOST_CHECK(!ec);
+   BOOST_CHECK(ret == 0);
+
+   BOOST_REQUIRE(lines.size() == 5);
+   BOOST_CHECK(lines[0] == "two workers");
+   BOOST_CHECK(lines[1] == "restarted");
+   BOOST_CHECK(lines[2] == "fork server");
+   BOOST_CHECK(lines[3] == "stop");
+   BOOST_CHECK(lines[4] == "stop");
+
+   // all workers were reaped
+   BOOST_CHECK(waitpid(-1, 0, WNOHANG) == -1 && errno == ECHILD);
+}
+
+shared_ptr<application::worker_pool> stubborn_pool;
+
+// the workers ignore the termination request
+bool stubborn_terminate_handler()
+{
+   return !stubborn_pool->is_worker();
+}
+
+void drive_stubborn_master()
+{
+   lines.push_back(read_line());
+
+   kill(getpid(), SIGTERM);
+}
+
+BOOST_AUTO_TEST_CASE(prefork_server_grace_period)
+{
+   lines.clear();
+
+   application::context app_context;
+   myapp app(app_context);
+
+   stubborn_pool = make_shared<application::worker_pool>(1);
+
+   stubborn_pool->daemonize(false);
+   stubborn_pool->grace_period(200);
+
+   app_context.insert<application::worker_pool>(stubborn_pool);
+
+   app_context.insert<application::termination_handler>(
+      make_shared<application::termination_handler_default_behaviour>(
+         application::handler<>::callback(&stubborn_terminate_handler)));
+
+   thread driver(&drive_stubborn_master);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+   boost::system::error_code ec;
+   int ret = application::launch<application::prefork_server>(app, app_context, ec);
+
+   driver.join();
+
+   BOOST_CHECK(!ec);
+   BOOST_CHECK(ret == 0);
+   BOOST_CHECK(chrono::steady_clock::now() - start < chrono::seconds(10));
+
+   BOOST_REQUIRE(lines.size() == 1);
+   BOOST_CHECK(parse(lines[0]).pid > 0);
+
+   // the worker was killed and reaped
+   BOOST_CHECK(waitpid(-1, 0, WNOHANG) == -1 && errno == ECHILD);
+}
+
+BOOST_AUTO_TEST_CASE(worker_pool_aspect)
+{
+   application::worker_pool pool;
+
+   BOOST_CHECK(pool.workers() >= 1);
+   BOOST_CHECK(!pool.is_worker());
+   BOOST_CHECK(pool.worker_index() == -1);
+   BOOST_CHECK(pool.grace_period() == 30000);
+
+   // one accept queue for each worker
+   asio::io_service io_service;
+   asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), 0);
+
+   shared_ptr<asio::ip::tcp::acceptor> first = pool.listen(io_service, endpoint);
+   endpoint.port(first->local_endpoint().port());
+
+   shared_ptr<asio::ip::tcp::acceptor> second = pool.listen(io_service, endpoint);
+   BOOST_CHECK(second->local_endpoint() == first->local_endpoint());
+}
@@ -0,0 +1,132 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <boost/application.hpp>
+#include <boost/application/aspects/selfpipe.hpp>
+#define BOOST_TEST_MODULE SelfpipeAspect
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+
+using namespace boost;
+
+bool readable(int fd)
+{
+   struct pollfd pfd;
+   pfd.fd = fd;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+
+   return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+BOOST_AUTO_TEST_CASE(selfpipe_poke_drain)
+{
+   application::selfpipe selfpipe;
+
+   BOOST_CHECK(!readable(selfpipe.read_fd()));
+
+   selfpipe.poke();
+   BOOST_CHECK(readable(selfpipe.read_fd()));
+
+   // still readable, the pokes are not consumed by poll
+   BOOST_CHECK(readable(selfpipe.read_fd()));
+
+   selfpipe.drain();
+   BOOST_CHECK(!readable(selfpipe.read_fd()));
+}
+
+BOOST_AUTO_TEST_CASE(selfpipe_many_pokes)
+{
+   application::selfpipe selfpipe;
+
+   // more than a pipe buffer, poke never blocks
+   for(int i = 0; i < 1000000; ++i)
+      selfpipe.poke();
+
+   BOOST_CHECK(readable(selfpipe.read_fd()));
+
+   selfpipe.drain();
+   BOOST_CHECK(!readable(selfpipe.read_fd()));
+
+   selfpipe.poke();
+   BOOST_CHECK(readable(selfpipe.read_fd()));
+}
+
+void wait_on(application::wait_for_termination_request_default_behaviour& waiter,
+             atomic<int>& done)
+{
+   waiter.wait();
+   done++;
+}
+
+BOOST_AUTO_TEST_CASE(wait_for_termination_request_many_waiters)
+{
+   application::wait_for_termination_request_default_behaviour waiter;
+   atomic<int> done(0);
+
+   thread_group threads;
+   for(int i = 0; i < 8; ++i)
+      threads.create_thread(boost::bind(&wait_on, boost::ref(waiter), boost::ref(done)));
+
+   this_thread::sleep_for(chrono::milliseconds(50));
+   BOOST_CHECK(done == 0);
+
+   waiter.proceed();
+   threads.join_all();
+
+   BOOST_CHECK(done == 8);
+
+   // the ones that wait after proceed return at once
+   waiter.wait();
+}
+
+BOOST_AUTO_TEST_CASE(wait_for_termination_request_high_fd)
+{
+   struct rlimit limit;
+   getrlimit(RLIMIT_NOFILE, &limit);
+
+   if(limit.rlim_cur < FD_SETSIZE + 16) {
+      if(limit.rlim_max < FD_SETSIZE + 16) {
+         std::cout << "skipped, RLIMIT_NOFILE is too low" << std::endl;
+         return;
+      }
+
+      limit.rlim_cur = FD_SETSIZE + 16;
+      setrlimit(RLIMIT_NOFILE, &limit);
+   }
+
+   // push the next descriptors above FD_SETSIZE
+   std::vector<int> fds;
+   int fd;
+   while((fd = dup(0)) != -1 && fd < FD_SETSIZE)
+      fds.push_back(fd);
+
+   if(fd != -1)
+      fds.push_back(fd);
+
+   {
+      application::wait_for_termination_request_default_behaviour waiter;
+      atomic<int> done(0);
+
+      thread t(boost::bind(&wait_on, boost::ref(waiter), boost::ref(done)));
+
+      waiter.proceed();
+      t.join();
+
+      BOOST_CHECK(done == 1);
+   }
+
+   for(std::size_t i = 0; i < fds.size(); ++i)
+      close(fds[i]);
+}
@@ -9,8 +9,12 @@
 
 #include <iostream>
 #include <boost/application.hpp>
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+#include <poll.h>
+#endif
 #define  BOOST_TEST_MODULE SignalBinder
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/barrier.hpp>
 
 using namespace boost;
 
@@ -39,10 +43,23 @@ public:
 	my_signal_binder(application::context &app_context)
 	   : application::signal_binder(app_context){}
 
+   my_signal_binder(application::context &app_context, asio::io_service &io_service)
+      : application::signal_binder(app_context, io_service){}
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+   my_signal_binder(application::context &app_context, application::use_signalfd_t use)
+      : application::signal_binder(app_context, use){}
+#endif
+
    void start()
    {
       signal_binder::start();
    }
+
+   void spawn(int signal_number)
+   {
+      signal_binder::spawn(boost::system::error_code(), signal_number);
+   }
 };
 
 BOOST_AUTO_TEST_CASE(signal_binder)
@@ -83,6 +100,397 @@ BOOST_AUTO_TEST_CASE(signal_binder)
 
 }
 
+struct thread_handler_test
+{
+   int count_;
+   boost::thread::id thread_id_;
+
+   thread_handler_test() : count_(0) { }
+
+   bool signal_handler()
+   {
+      count_++;
+      thread_id_ = boost::this_thread::get_id();
+      return false;
+   }
+};
+
+BOOST_AUTO_TEST_CASE(signal_binder_external_io_service)
+{
+   application::context app_context;
+   asio::io_service io_service;
+
+   my_signal_binder app_signal_binder(app_context, io_service);
+   thread_handler_test app_handler_test;
+
+   // no thread is created
+   app_signal_binder.start();
+
+   application::handler<>::callback cb = boost::bind(
+               &thread_handler_test::signal_handler, &app_handler_test);
+
+   boost::system::error_code ec;
+   app_signal_binder.bind(SIGUSR2, cb, ec);
+   BOOST_CHECK(!ec);
+
+   raise(SIGUSR2);
+
+   // the handler is called by the thread that runs the io_service
+   while(!app_handler_test.count_ && io_service.run_one())
+      ;
+
+   BOOST_CHECK(app_handler_test.count_ == 1);
+   BOOST_CHECK(app_handler_test.thread_id_ == boost::this_thread::get_id());
+
+   app_signal_binder.unbind(SIGUSR2, ec);
+   BOOST_CHECK(!ec);
+}
+
+BOOST_AUTO_TEST_CASE(signal_binder_external_io_service_outlive)
+{
+   application::context app_context;
+   asio::io_service io_service;
+
+   {
+      my_signal_binder app_signal_binder(app_context, io_service);
+   }
+
+   // the aborted wait of destroyed binder is safe to run
+   io_service.poll();
+}
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+
+BOOST_AUTO_TEST_CASE(signal_binder_signalfd)
+{
+   application::context app_context;
+
+   my_signal_binder app_signal_binder(app_context, application::use_signalfd);
+   thread_handler_test app_handler_test;
+
+   BOOST_CHECK(app_signal_binder.native_handle() == -1);
+
+   application::handler<>::callback cb = boost::bind(
+               &thread_handler_test::signal_handler, &app_handler_test);
+
+   boost::system::error_code ec;
+   app_signal_binder.bind(SIGUSR2, cb, ec);
+   BOOST_CHECK(!ec);
+   BOOST_CHECK(app_signal_binder.native_handle() != -1);
+
+   // nothing pending
+   BOOST_CHECK(app_signal_binder.poll(ec) == 0);
+   BOOST_CHECK(!ec);
+
+   raise(SIGUSR2);
+   raise(SIGUSR2);
+
+   // user event loop
+   pollfd pfd = { app_signal_binder.native_handle(), POLLIN, 0 };
+   BOOST_CHECK(::poll(&pfd, 1, 5000) == 1);
+
+   // standard signals are not queued
+   BOOST_CHECK(app_signal_binder.poll(ec) == 1);
+   BOOST_CHECK(!ec);
+   BOOST_CHECK(app_handler_test.count_ == 1);
+   BOOST_CHECK(app_handler_test.thread_id_ == boost::this_thread::get_id());
+
+   app_signal_binder.unbind(SIGUSR2, ec);
+   BOOST_CHECK(!ec);
+   BOOST_CHECK(!app_signal_binder.is_bound(SIGUSR2));
+}
+
+#endif
+
+BOOST_AUTO_TEST_CASE(signal_binder_invalid_signal)
+{
+   application::context app_context;
+   my_signal_binder app_signal_binder(app_context);
+   handler_test app_handler_test;
+
+   application::handler<>::callback cb = boost::bind(
+               &handler_test::signal_handler1, &app_handler_test);
+
+   boost::system::error_code ec;
+   app_signal_binder.bind(NSIG, cb, ec);
+   BOOST_CHECK(ec);
+
+   app_signal_binder.bind(-1, cb, ec);
+   BOOST_CHECK(ec);
+
+   BOOST_CHECK(!app_signal_binder.is_bound(NSIG));
+
+   // ignored
+   app_signal_binder.spawn(NSIG);
+   BOOST_CHECK(!app_handler_test.called_);
+}
+
+struct rebind_test
+{
+   boost::atomic<int> first_;
+   boost::atomic<int> second_;
+
+   rebind_test() : first_(0), second_(0) { }
+
+   bool first()
+   {
+      first_++;
+      return true;
+   }
+
+   bool second()
+   {
+      second_++;
+      return false;
+   }
+
+   void rebind(my_signal_binder& sb)
+   {
+      application::handler<>::callback cb1 = boost::bind(&rebind_test::first, this);
+      application::handler<>::callback cb2 = boost::bind(&rebind_test::second, this);
+
+      for(int i = 0; i < 2000; i++)
+      {
+         sb.bind(SIGUSR2, cb1, cb2);
+         sb.bind(SIGUSR2, cb2);
+         sb.unbind(SIGUSR2);
+      }
+
+      sb.bind(SIGUSR2, cb1, cb2);
+   }
+};
+
+BOOST_AUTO_TEST_CASE(signal_binder_concurrent_rebind)
+{
+   application::context app_context;
+   my_signal_binder app_signal_binder(app_context);
+   rebind_test app_rebind_test;
+
+   boost::thread th(boost::bind(&rebind_test::rebind,
+      &app_rebind_test, boost::ref(app_signal_binder)));
+
+   // dispatch while the handlers are replaced
+   for(int i = 0; i < 200000; i++)
+      app_signal_binder.spawn(SIGUSR2);
+
+   th.join();
+
+   int first = app_rebind_test.first_;
+   int second = app_rebind_test.second_;
+
+   app_signal_binder.spawn(SIGUSR2);
+
+   BOOST_CHECK(app_rebind_test.first_ == first + 1);
+   BOOST_CHECK(app_rebind_test.second_ == second + 1);
+}
+
+#if defined( BOOST_APPLICATION_HAS_SIGNALFD )
+
+struct queued_test
+{
+   int received_;
+   bool in_order_;
+   bool sender_ok_;
+
+   queued_test() : received_(0), in_order_(true), sender_ok_(true) { }
+
+   void on_signal(const application::signal_info& info)
+   {
+      if(info.value != received_)
+         in_order_ = false;
+
+      if(info.pid != getpid() || info.uid != getuid() || info.code != SI_QUEUE)
+         sender_ok_ = false;
+
+      received_++;
+   }
+
+   // the queue of pending signals is limited (RLIMIT_SIGPENDING),
+   // retry while the receiver drains it
+   static void send(int signal_number, int count)
+   {
+      for(int i = 0; i < count; i++)
+      {
+         union sigval value;
+         value.sival_int = i;
+
+         while(sigqueue(getpid(), signal_number, value) == -1 && errno == EAGAIN)
+            boost::this_thread::yield();
+      }
+   }
+};
+
+BOOST_AUTO_TEST_CASE(signal_binder_queued_signalfd)
+{
+   const int count = 100000;
+
+   application::context app_context;
+
+   my_signal_binder app_signal_binder(app_context, application::use_signalfd);
+   queued_test app_queued_test;
+
+   boost::system::error_code ec;
+   app_signal_binder.bind_queued(SIGRTMIN + 1,
+      boost::bind(&queued_test::on_signal, &app_queued_test, _1), ec);
+   BOOST_REQUIRE(!ec);
+
+   // the sender inherits the signal mask, created after bind
+   boost::thread sender(boost::bind(&queued_test::send, SIGRTMIN + 1, count));
+
+   pollfd pfd = { app_signal_binder.native_handle(), POLLIN, 0 };
+
+   while(app_queued_test.received_ < count)
+   {
+      if(::poll(&pfd, 1, 5000) != 1)
+         break;
+
+      app_signal_binder.poll(ec);
+      BOOST_REQUIRE(!ec);
+   }
+
+   sender.join();
+
+   // none lost, in order
+   BOOST_CHECK(app_queued_test.received_ == count);
+   BOOST_CHECK(app_queued_test.in_order_);
+   BOOST_CHECK(app_queued_test.sender_ok_);
+
+   app_signal_binder.unbind(SIGRTMIN + 1, ec);
+   BOOST_CHECK(!ec);
+   BOOST_CHECK(!app_signal_binder.is_bound(SIGRTMIN + 1));
+}
+
+bool ignore_signal()
+{
+   return false;
+}
+
+void wait_on_barrier(boost::barrier& step)
+{
+   step.wait();
+   step.wait();
+}
+
+BOOST_AUTO_TEST_CASE(signal_binder_signalfd_other_threads)
+{
+   const int signal_number = SIGRTMIN + 5;
+
+   application::context app_context;
+   boost::system::error_code ec;
+
+   // a thread that don't block the signal would take it
+   {
+      boost::barrier step(2);
+      boost::thread other(boost::bind(&wait_on_barrier, boost::ref(step)));
+      step.wait();
+
+      my_signal_binder app_signal_binder(app_context, application::use_signalfd);
+      app_signal_binder.bind(signal_number,
+         application::handler<>::callback(&ignore_signal), ec);
+
+      BOOST_CHECK(ec == boost::system::errc::operation_not_permitted);
+      BOOST_CHECK(!app_signal_binder.is_bound(signal_number));
+
+      step.wait();
+      other.join();
+   }
+
+   // blocked on main before the thread is created
+   {
+      application::block_signals(&signal_number, &signal_number + 1);
+
+      boost::barrier step(2);
+      boost::thread other(boost::bind(&wait_on_barrier, boost::ref(step)));
+      step.wait();
+
+      my_signal_binder app_signal_binder(app_context, application::use_signalfd);
+      app_signal_binder.bind(signal_number,
+         application::handler<>::callback(&ignore_signal), ec);
+
+      BOOST_CHECK(!ec);
+      BOOST_CHECK(app_signal_binder.is_bound(signal_number));
+
+      step.wait();
+      other.join();
+   }
+}
+
+BOOST_AUTO_TEST_CASE(signal_binder_queued_io_service)
+{
+   const int count = 10000;
+
+   application::context app_context;
+   asio::io_service io_service;
+
+   my_signal_binder app_signal_binder(app_context, io_service);
+   queued_test app_queued_test;
+
+   app_signal_binder.bind_queued(SIGRTMIN + 2,
+      boost::bind(&queued_test::on_signal, &app_queued_test, _1));
+
+   boost::thread sender(boost::bind(&queued_test::send, SIGRTMIN + 2, count));
+
+   while(app_queued_test.received_ < count && io_service.run_one())
+      ;
+
+   sender.join();
+
+   BOOST_CHECK(app_queued_test.received_ == count);
+   BOOST_CHECK(app_queued_test.in_order_);
+   BOOST_CHECK(app_queued_test.sender_ok_);
+
+   // rebind as a standard signal
+   handler_test app_handler_test;
+   application::handler<>::callback cb = boost::bind(
+               &handler_test::signal_handler1, &app_handler_test);
+
+   app_signal_binder.bind(SIGRTMIN + 2, cb);
+   raise(SIGRTMIN + 2);
+
+   while(!app_handler_test.called_ && io_service.run_one())
+      ;
+
+   BOOST_CHECK(app_handler_test.called_);
+}
+
+#endif
+
+bool terminate_handler()
+{
+   return true;
+}
+
+class my_signal_manager : public application::signal_manager
+{
+public:
+   my_signal_manager(application::context &app_context, asio::io_service &io_service)
+      : application::signal_manager(app_context, io_service){}
+};
+
+BOOST_AUTO_TEST_CASE(signal_manager_termination)
+{
+   application::context app_context;
+   asio::io_service io_service;
+
+   app_context.insert<application::termination_handler>(
+      boost::make_shared<application::termination_handler_default_behaviour>(
+         application::handler<>::callback(&terminate_handler)));
+
+   my_signal_manager app_signal_manager(app_context, io_service);
 
+   // status and wait_for_termination_request are bound on creation
+   shared_ptr<application::status> st = app_context.find<application::status>();
+   BOOST_REQUIRE(st);
+   BOOST_CHECK(st->state() == application::status::running);
+   BOOST_REQUIRE(app_context.find<application::wait_for_termination_request>());
 
+   raise(SIGTERM);
 
+   while(st->state() != application::status::stopped && io_service.run_one())
+      ;
+
+   BOOST_CHECK(st->state() == application::status::stopped);
+
+   // proceed was called
+   app_context.find<application::wait_for_termination_request>()->wait();
+}
@@ -0,0 +1,163 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <boost/application.hpp>
+#include <boost/application/aspects/socket_activation.hpp>
+#include <boost/lexical_cast.hpp>
+#define BOOST_TEST_MODULE SocketActivationAspect
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace boost;
+
+// simulate the environment of systemd: 2 listening sockets on
+// descriptors 3 and 4, and LISTEN_FDS/LISTEN_PID
+struct activation_environment
+{
+   activation_environment()
+   {
+      for(int fd = 3; fd < 5; ++fd) {
+         int s = ::socket(AF_INET, SOCK_STREAM, 0);
+
+         struct sockaddr_in address;
+         std::memset(&address, 0, sizeof(address));
+         address.sin_family = AF_INET;
+         address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+         address.sin_port = 0;
+
+         BOOST_REQUIRE(::bind(s, (struct sockaddr*)&address, sizeof(address)) == 0);
+         BOOST_REQUIRE(::listen(s, 16) == 0);
+
+         socklen_t len = sizeof(address);
+         getsockname(s, (struct sockaddr*)&address, &len);
+         ports.push_back(ntohs(address.sin_port));
+
+         if(s != fd) {
+            BOOST_REQUIRE(fcntl(fd, F_GETFD) == -1); // not in use
+            dup2(s, fd);
+            close(s);
+         }
+      }
+
+      setenv("LISTEN_PID", lexical_cast<std::string>(getpid()).c_str(), 1);
+      setenv("LISTEN_FDS", "2", 1);
+
+      // after the sockets, it uses descriptors
+      io_service.reset(new asio::io_service());
+   }
+
+   ~activation_environment()
+   {
+      io_service.reset();
+
+      close(3);
+      close(4);
+
+      unsetenv("LISTEN_PID");
+      unsetenv("LISTEN_FDS");
+   }
+
+   scoped_ptr<asio::io_service> io_service;
+   std::vector<unsigned short> ports;
+};
+
+BOOST_AUTO_TEST_CASE(socket_activation_environment)
+{
+   activation_environment environment;
+
+   application::socket_activation activation;
+
+   BOOST_REQUIRE(activation.size() == 2);
+   BOOST_CHECK(activation.fds()[0] == 3);
+   BOOST_CHECK(activation.fds()[1] == 4);
+
+   // removed from environment, and not inherited by exec
+   BOOST_CHECK(getenv("LISTEN_FDS") == 0);
+   BOOST_CHECK(getenv("LISTEN_PID") == 0);
+   BOOST_CHECK(fcntl(3, F_GETFD) & FD_CLOEXEC);
+
+   // ready acceptors
+   for(std::size_t i = 0; i < activation.size(); ++i) {
+      shared_ptr<asio::ip::tcp::acceptor> acceptor =
+         activation.acceptor(*environment.io_service, i);
+
+      BOOST_CHECK(acceptor->local_endpoint().port() == environment.ports[i]);
+
+      asio::ip::tcp::socket client(*environment.io_service);
+      client.connect(acceptor->local_endpoint());
+
+      asio::ip::tcp::socket server(*environment.io_service);
+      acceptor->accept(server);
+
+      BOOST_CHECK(server.remote_endpoint() == client.local_endpoint());
+   }
+
+   // the acceptors own a duplicate, the sockets are kept
+   BOOST_CHECK(fcntl(3, F_GETFD) != -1);
+   BOOST_CHECK(fcntl(4, F_GETFD) != -1);
+
+   BOOST_CHECK_THROW(activation.acceptor(*environment.io_service, 2),
+                     boost::system::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(socket_activation_other_pid)
+{
+   activation_environment environment;
+
+   setenv("LISTEN_PID", lexical_cast<std::string>(getpid() + 1).c_str(), 1);
+
+   application::socket_activation activation;
+   BOOST_CHECK(activation.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(socket_activation_no_environment)
+{
+   application::socket_activation activation;
+   BOOST_CHECK(activation.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(socket_activation_invalid_environment)
+{
+   setenv("LISTEN_PID", lexical_cast<std::string>(getpid()).c_str(), 1);
+   setenv("LISTEN_FDS", "two", 1);
+
+   system::error_code ec;
+   application::socket_activation activation(ec);
+
+   BOOST_CHECK(ec);
+   BOOST_CHECK(activation.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(socket_activation_explicit_list)
+{
+   asio::io_service io_service;
+
+   asio::ip::tcp::acceptor listening(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+
+   std::vector<int> fds(1, listening.native_handle());
+   fds.push_back(0); // not a socket
+
+   application::socket_activation activation(fds);
+
+   shared_ptr<asio::ip::tcp::acceptor> acceptor =
+      activation.acceptor(io_service, 0);
+
+   BOOST_CHECK(acceptor->local_endpoint() == listening.local_endpoint());
+
+   system::error_code ec;
+   BOOST_CHECK(!activation.acceptor(io_service, 1, ec));
+   BOOST_CHECK(ec);
+}
@@ -0,0 +1,195 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <boost/application.hpp>
+#define BOOST_TEST_MODULE StaticContext
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+struct my_config
+{
+   my_config(int v) : value(v) {}
+   int value;
+};
+
+struct my_other_aspect
+{
+};
+
+struct my_counted_aspect
+{
+   static boost::atomic<int> alive;
+
+   my_counted_aspect() { ++alive; }
+   ~my_counted_aspect() { --alive; }
+};
+
+boost::atomic<int> my_counted_aspect::alive(0);
+
+typedef application::static_context<
+   application::status, application::run_mode, my_config> my_context;
+
+typedef application::static_context<my_counted_aspect> my_counted_context;
+
+class myapp
+{
+public:
+
+   myapp(my_context& context)
+      : context_(context) { }
+
+   int operator()()
+   {
+      // aspects added by application mode are visible on static slots
+      if(!context_.find<application::status>())
+         return 1;
+
+      if(context_.find<application::run_mode>()->mode() != application::common::mode())
+         return 2;
+
+      return context_.find<my_config>()->value;
+   }
+
+private:
+   my_context& context_;
+};
+
+BOOST_AUTO_TEST_CASE(static_context_slots)
+{
+   my_context app_context;
+
+   BOOST_CHECK(!app_context.find<my_config>());
+
+   app_context.insert<my_config>(boost::make_shared<my_config>(1));
+
+   const shared_ptr<my_config>& cfg = app_context.find<my_config>();
+   BOOST_CHECK(cfg->value == 1);
+
+   // the old value stay valid
+   app_context.exchange<my_config>(boost::make_shared<my_config>(2));
+
+   BOOST_CHECK(cfg->value == 1);
+   BOOST_CHECK(app_context.find<my_config>()->value == 2);
+
+   // changes done by context& are visible too
+   application::context& base = app_context;
+
+   base.erase<my_config>();
+   BOOST_CHECK(!app_context.find<my_config>());
+
+   base.insert<my_config>(boost::make_shared<my_config>(3));
+   BOOST_CHECK(app_context.find<my_config>()->value == 3);
+
+   // dynamic aspects
+   BOOST_CHECK(!app_context.find<my_other_aspect>());
+   app_context.insert<my_other_aspect>(boost::make_shared<my_other_aspect>());
+   BOOST_CHECK(app_context.find<my_other_aspect>());
+
+   app_context.clear();
+   BOOST_CHECK(!app_context.find<my_config>());
+}
+
+BOOST_AUTO_TEST_CASE(static_context_launch)
+{
+   my_context app_context;
+   myapp app(app_context);
+
+   app_context.insert<my_config>(boost::make_shared<my_config>(0));
+
+   BOOST_CHECK(application::launch<application::common>(app, app_context) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(static_context_exchange_releases_old_values)
+{
+   {
+      my_counted_context app_context;
+
+      for(int i = 0; i < 1000; ++i) {
+         app_context.exchange<my_counted_aspect>(
+            boost::make_shared<my_counted_aspect>());
+
+         BOOST_CHECK(app_context.find<my_counted_aspect>());
+      }
+
+      // only the current value, and the ones still pinned by a snapshot
+      // that was not reclaimed yet, are alive
+      BOOST_CHECK(my_counted_aspect::alive.load() <= 3);
+
+      shared_ptr<my_counted_aspect> last =
+         app_context.find<my_counted_aspect>();
+
+      app_context.erase<my_counted_aspect>();
+      BOOST_CHECK(!app_context.find<my_counted_aspect>());
+      BOOST_CHECK(my_counted_aspect::alive.load() >= 1);
+   }
+
+   BOOST_CHECK_EQUAL(my_counted_aspect::alive.load(), 0);
+}
+
+void set_value(my_config& cfg)
+{
+   cfg.value = 7;
+}
+
+BOOST_AUTO_TEST_CASE(static_context_borrowed_access)
+{
+   my_context app_context;
+   app_context.insert<my_config>(boost::make_shared<my_config>(1));
+   app_context.insert<my_other_aspect>(boost::make_shared<my_other_aspect>());
+
+   {
+      my_context::slot_guard guard(app_context);
+
+      my_config* cfg = app_context.find_ref<my_config>(guard);
+      BOOST_REQUIRE(cfg);
+      BOOST_CHECK(cfg->value == 1);
+      BOOST_CHECK(!app_context.find_ref<application::status>(guard));
+
+      // the borrowed value stay valid while the guard is alive
+      app_context.exchange<my_config>(boost::make_shared<my_config>(2));
+
+      BOOST_CHECK(cfg->value == 1);
+      BOOST_CHECK(app_context.find_ref<my_config>(guard)->value == 2);
+
+      application::status* st;
+      std::tie(st, cfg) =
+         app_context.find_all<application::status, my_config>(guard);
+
+      BOOST_CHECK(!st && cfg->value == 2);
+
+      my_context other;
+      BOOST_CHECK_THROW(other.find_ref<my_config>(guard), std::logic_error);
+   }
+
+   // the static path of the other lookups
+   {
+      strict_lock<application::aspect_map> lock(app_context);
+      BOOST_CHECK(app_context.find<my_config>(lock)->value == 2);
+      BOOST_CHECK(app_context.find<my_other_aspect>(lock));
+   }
+
+   shared_ptr<my_config> cfg;
+   shared_ptr<my_other_aspect> other;
+
+   std::tie(cfg, other) = app_context.find_all<my_config, my_other_aspect>();
+   BOOST_CHECK(cfg->value == 2 && other);
+
+   BOOST_CHECK(app_context.with<my_config>(&set_value));
+   BOOST_CHECK(app_context.find<my_config>()->value == 7);
+
+   BOOST_CHECK(!app_context.with<application::run_mode>(
+      boost::bind(&application::run_mode::mode, _1)));
+
+   // the dynamic borrowed access is still there
+   application::aspect_map::read_guard read(app_context);
+   BOOST_CHECK(app_context.find_ref<my_config>(read)->value == 7);
+   BOOST_CHECK(app_context.find_ref<my_other_aspect>(read));
+}
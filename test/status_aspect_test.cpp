@@ -0,0 +1,145 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <boost/application.hpp>
+#define BOOST_TEST_MODULE StatusAspect
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+BOOST_AUTO_TEST_CASE(status_transition)
+{
+   application::status st(application::status::running);
+
+   BOOST_CHECK(st == application::status::running);
+
+   // CAS, only from the expected state
+   BOOST_CHECK(!st.transition(application::status::paused,
+                              application::status::running));
+
+   BOOST_CHECK(st.transition(application::status::running,
+                             application::status::paused));
+
+   BOOST_CHECK(st.state() == application::status::paused);
+
+   BOOST_CHECK(st.transition(application::status::paused,
+                             application::status::running));
+
+   st.state(application::status::stopped);
+   BOOST_CHECK(st != application::status::running);
+}
+
+atomic<int> paused_count(0);
+
+void try_pause(application::status& st)
+{
+   for(int i = 0; i < 1000; ++i) {
+      if(st.transition(application::status::running,
+                       application::status::paused)) {
+         paused_count++;
+         st.transition(application::status::paused,
+                       application::status::running);
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE(status_concurrent_transition)
+{
+   application::status st(application::status::running);
+
+   thread_group group;
+   for(int t = 0; t < 4; ++t)
+      group.create_thread(boost::bind(&try_pause, boost::ref(st)));
+
+   group.join_all();
+
+   // each pause is matched by a resume
+   BOOST_CHECK(paused_count > 0);
+   BOOST_CHECK(st == application::status::running);
+}
+
+BOOST_AUTO_TEST_CASE(status_timestamps)
+{
+   application::status st(application::status::running);
+
+   BOOST_CHECK(st.since(application::status::paused)
+      == application::status::clock_type::time_point());
+
+   st.state(application::status::paused);
+   this_thread::sleep_for(chrono::milliseconds(50));
+
+   BOOST_CHECK(st.paused_duration() >= chrono::milliseconds(50));
+
+   st.state(application::status::running);
+
+   application::status::clock_type::duration paused = st.paused_duration();
+
+   BOOST_CHECK(paused >= chrono::milliseconds(50));
+   BOOST_CHECK(st.since(application::status::running)
+      >= st.since(application::status::paused));
+
+   this_thread::sleep_for(chrono::milliseconds(20));
+
+   // not paused, it does not grow
+   BOOST_CHECK(st.paused_duration() == paused);
+   BOOST_CHECK(st.uptime() >= paused + chrono::milliseconds(20));
+   BOOST_CHECK(st.elapsed() >= chrono::milliseconds(20));
+}
+
+void stop_later(application::status& st)
+{
+   this_thread::sleep_for(chrono::milliseconds(50));
+   st.state(application::status::stopped);
+}
+
+BOOST_AUTO_TEST_CASE(status_wait)
+{
+   application::status st(application::status::running);
+
+   BOOST_CHECK(!st.wait_for(application::status::stopped,
+                            chrono::milliseconds(10)));
+
+   thread stopper(boost::bind(&stop_later, boost::ref(st)));
+
+   st.wait(application::status::stopped);
+   BOOST_CHECK(st == application::status::stopped);
+
+   BOOST_CHECK(st.wait_for(application::status::stopped,
+                           chrono::milliseconds(10)));
+
+   stopper.join();
+}
+
+std::vector<std::pair<int, int> > transitions;
+
+void record(application::status::application_state from,
+            application::status::application_state to)
+{
+   transitions.push_back(std::make_pair(from, to));
+}
+
+BOOST_AUTO_TEST_CASE(status_hooks)
+{
+   application::status st(application::status::running);
+   st.on_transition(&record);
+
+   st.transition(application::status::running, application::status::paused);
+   st.transition(application::status::running, application::status::stopped);
+   st.state(application::status::stopped);
+   st.state(application::status::stopped);
+
+   // failed and no-op transitions are not reported
+   BOOST_CHECK(transitions.size() == 2);
+   BOOST_CHECK(transitions[0].first == application::status::running);
+   BOOST_CHECK(transitions[0].second == application::status::paused);
+   BOOST_CHECK(transitions[1].first == application::status::paused);
+   BOOST_CHECK(transitions[1].second == application::status::stopped);
+}
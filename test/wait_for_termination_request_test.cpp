@@ -0,0 +1,98 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+#define USE_POSIX_WAIT_FOR_TERMINATION_REQUEST_FUTEX_BASED
+
+#define BOOST_TEST_MODULE wait_for_termination_request_test
+
+#include <iostream>
+#include <boost/application.hpp>
+#include <boost/chrono.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <sys/resource.h>
+
+using namespace boost;
+
+typedef application::wait_for_termination_request_default_behaviour waiter_type;
+
+// user + system CPU time used by this process, in microseconds
+long long process_cpu_time()
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+
+   return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL
+        + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void wait_on(waiter_type& waiter, atomic<int>& done)
+{
+   waiter.wait();
+   done++;
+}
+
+BOOST_AUTO_TEST_CASE(proceed_before_wait)
+{
+   waiter_type waiter;
+
+   waiter.proceed();
+   waiter.wait();
+}
+
+BOOST_AUTO_TEST_CASE(idle_cpu_use)
+{
+   waiter_type waiter;
+   atomic<int> done(0);
+
+   thread t(boost::bind(&wait_on, boost::ref(waiter), boost::ref(done)));
+
+   // let the thread block
+   this_thread::sleep_for(chrono::milliseconds(50));
+
+   long long before = process_cpu_time();
+   this_thread::sleep_for(chrono::milliseconds(500));
+   long long idle = process_cpu_time() - before;
+
+   std::cout << "CPU used by a waiting process in 500 ms: "
+             << idle << " us" << std::endl;
+
+   // a busy waiter uses all the interval
+   BOOST_CHECK(idle < 50000);
+   BOOST_CHECK(done == 0);
+
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   waiter.proceed();
+   t.join();
+
+   chrono::microseconds latency = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start);
+
+   std::cout << "wake-up latency: " << latency.count() << " us" << std::endl;
+
+   BOOST_CHECK(done == 1);
+   BOOST_CHECK(latency < chrono::seconds(1));
+}
+
+BOOST_AUTO_TEST_CASE(proceed_wakes_all_waiters)
+{
+   waiter_type waiter;
+   atomic<int> done(0);
+
+   thread_group threads;
+   for(int i = 0; i < 4; ++i)
+      threads.create_thread(boost::bind(&wait_on, boost::ref(waiter), boost::ref(done)));
+
+   this_thread::sleep_for(chrono::milliseconds(50));
+   BOOST_CHECK(done == 0);
+
+   waiter.proceed();
+   threads.join_all();
+
+   BOOST_CHECK(done == 4);
+}
@@ -0,0 +1,245 @@
+// Copyright 2014 Renato Tegon Forti
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt
+// or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+// For more information, see http://www.boost.org
+
+#define BOOST_APPLICATION_FEATURE_NS_SELECT_BOOST
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <boost/application.hpp>
+#define BOOST_TEST_MODULE WorkQueueAspect
+#include <boost/test/unit_test.hpp>
+
+using namespace boost;
+
+BOOST_AUTO_TEST_CASE(work_stealing_deque)
+{
+   application::detail::work_stealing_deque<int> deque(2);
+   std::vector<int> values(100);
+
+   BOOST_CHECK(deque.pop() == 0);
+   BOOST_CHECK(deque.steal() == 0);
+
+   // grows
+   for(int i = 0; i < 100; ++i)
+      deque.push(&values[i]);
+
+   BOOST_CHECK(!deque.empty());
+
+   // owner LIFO, thieves FIFO
+   BOOST_CHECK(deque.pop() == &values[99]);
+   BOOST_CHECK(deque.steal() == &values[0]);
+
+   int count = 2;
+   while(deque.pop())
+      count++;
+
+   BOOST_CHECK(count == 100);
+   BOOST_CHECK(deque.empty());
+}
+
+atomic<int> counter(0);
+
+void increment()
+{
+   counter++;
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_add_task)
+{
+   application::work_queue queue(4);
+   BOOST_CHECK(queue.size() == 4);
+
+   counter = 0;
+
+   for(int i = 0; i < 10000; ++i)
+      BOOST_CHECK(queue.add_task(&increment));
+
+   queue.drain();
+   BOOST_CHECK(counter == 10000);
+
+   // one worker takes all tasks of shared queue
+   application::work_queue one(1);
+
+   for(int i = 0; i < 1000; ++i)
+      one.add_task(&increment);
+
+   one.drain();
+   BOOST_CHECK(counter == 11000);
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_add_tasks)
+{
+   application::work_queue queue(4);
+   counter = 0;
+
+   std::vector<application::work_queue::task_type> tasks(1000, &increment);
+
+   application::task_latch done;
+   BOOST_CHECK(queue.add_tasks(tasks.begin(), tasks.end(), done));
+
+   queue.wait(done);
+   BOOST_CHECK(counter == 1000);
+   BOOST_CHECK(done.try_wait());
+
+   // without latch
+   BOOST_CHECK(queue.add_tasks(tasks.begin(), tasks.end()));
+   queue.drain();
+   BOOST_CHECK(counter == 2000);
+}
+
+// a task that splits itself in subtasks, and waits for them
+void sum(application::work_queue& queue, int first, int last, atomic<long>& total)
+{
+   if(last - first <= 16) {
+      for(int i = first; i < last; ++i)
+         total += i;
+
+      return;
+   }
+
+   int middle = first + (last - first) / 2;
+
+   application::task_latch done;
+   queue.add_task(boost::bind(&sum, boost::ref(queue), first, middle, boost::ref(total)), done);
+   queue.add_task(boost::bind(&sum, boost::ref(queue), middle, last, boost::ref(total)), done);
+
+   // runs other tasks while waiting, no deadlock with few workers
+   queue.wait(done);
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_nested)
+{
+   application::work_queue queue(2);
+   atomic<long> total(0);
+
+   application::task_latch done;
+   queue.add_task(boost::bind(&sum, boost::ref(queue), 0, 100000, boost::ref(total)), done);
+
+   queue.wait(done);
+   BOOST_CHECK(total == 100000L * 99999L / 2);
+}
+
+mutex ids_mutex;
+std::set<thread::id> ids;
+
+void record_thread()
+{
+   this_thread::sleep_for(chrono::milliseconds(1));
+
+   lock_guard<mutex> lock(ids_mutex);
+   ids.insert(this_thread::get_id());
+}
+
+void spawn_local(application::work_queue& queue)
+{
+   // all on the deque of this worker
+   application::task_latch done;
+
+   for(int i = 0; i < 200; ++i)
+      queue.add_task(&record_thread, done);
+
+   queue.wait(done);
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_stealing)
+{
+   application::work_queue queue(4);
+   ids.clear();
+
+   queue.add_task(boost::bind(&spawn_local, boost::ref(queue)));
+   queue.drain();
+
+   // other workers stole from the deque
+   BOOST_CHECK(ids.size() > 1);
+}
+
+void slow_increment()
+{
+   this_thread::sleep_for(chrono::milliseconds(1));
+   counter++;
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_stop_drains)
+{
+   application::work_queue queue(2);
+   counter = 0;
+
+   for(int i = 0; i < 100; ++i)
+      queue.add_task(&slow_increment);
+
+   queue.stop();
+
+   // all added tasks are done, new ones are refused
+   BOOST_CHECK(counter == 100);
+   BOOST_CHECK(queue.stopping());
+   BOOST_CHECK(!queue.add_task(&increment));
+
+   application::task_latch done;
+   BOOST_CHECK(!queue.add_task(&increment, done));
+   BOOST_CHECK(done.try_wait());
+   BOOST_CHECK(counter == 100);
+}
+
+// single tasks added while other threads wait on drain()
+void add_and_drain(application::work_queue& queue, int times)
+{
+   for(int i = 0; i < times; ++i) {
+      queue.add_task(&increment);
+      queue.drain();
+   }
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_drain_no_lost_wakeup)
+{
+   application::work_queue queue(1);
+   counter = 0;
+
+   std::vector<shared_ptr<thread> > producers;
+
+   for(int i = 0; i < 4; ++i)
+      producers.push_back(make_shared<thread>(
+         boost::bind(&add_and_drain, boost::ref(queue), 2000)));
+
+   // a wake up taken by a drain() waiter would leave the task, and
+   // every producer, waiting forever
+   for(std::size_t i = 0; i < producers.size(); ++i)
+      BOOST_REQUIRE(producers[i]->try_join_for(chrono::seconds(30)));
+
+   BOOST_CHECK(counter == 8000);
+}
+
+void terminate(application::context& cxt)
+{
+   cxt.find<application::status>()->state(application::status::stopped);
+   cxt.find<application::wait_for_termination_request>()->proceed();
+}
+
+BOOST_AUTO_TEST_CASE(work_queue_run)
+{
+   application::context cxt;
+
+   cxt.insert<application::status>(
+      make_shared<application::status>(application::status::running));
+
+   cxt.insert<application::wait_for_termination_request>(
+      shared_ptr<application::wait_for_termination_request>(
+         new application::wait_for_termination_request_default_behaviour));
+
+   shared_ptr<application::work_queue> queue =
+      make_shared<application::work_queue>(2);
+
+   counter = 0;
+
+   for(int i = 0; i < 50; ++i)
+      queue->add_task(&slow_increment);
+
+   queue->add_task(boost::bind(&terminate, boost::ref(cxt)));
+
+   BOOST_CHECK(queue->run(cxt) == 0);
+   BOOST_CHECK(counter == 50);
+}